@@ -0,0 +1,125 @@
+#include "block_codec.h"
+
+#include <cstdint>
+#include <cstring> // For std::memcpy
+
+// --- Anonymous Namespace for INTERNAL (File-Local) Helper Functions ---
+namespace {
+
+    constexpr size_t MIN_MATCH = 4;
+    constexpr size_t MAX_OFFSET = 65535;
+    constexpr unsigned HASH_BITS = 14;
+
+    inline std::uint32_t read32(const unsigned char* p) noexcept {
+        std::uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline unsigned hash4(std::uint32_t sequence) noexcept {
+        return (sequence * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    // Writes the 255-run encoding of a length that did not fit into its nibble
+    void append_length(std::string& out, size_t length) {
+        while (length >= 255) {
+            out += static_cast<char>(255);
+            length -= 255;
+        }
+        out += static_cast<char>(length);
+    }
+
+    void append_sequence(std::string& out, const unsigned char* literals, size_t literal_count,
+                         size_t offset, size_t match_length) {
+        const size_t match_code = match_length ? match_length - MIN_MATCH : 0;
+        const unsigned literal_nibble = literal_count >= 15 ? 15u : static_cast<unsigned>(literal_count);
+        const unsigned match_nibble = match_code >= 15 ? 15u : static_cast<unsigned>(match_code);
+        out += static_cast<char>((literal_nibble << 4) | match_nibble);
+        if (literal_nibble == 15) append_length(out, literal_count - 15);
+        out.append(reinterpret_cast<const char*>(literals), literal_count);
+        if (match_length == 0) return; // Final, literal-only sequence
+        out += static_cast<char>(offset & 0xFF);
+        out += static_cast<char>(offset >> 8);
+        if (match_nibble == 15) append_length(out, match_code - 15);
+    }
+
+    // Reads a 255-run length extension; returns false if it runs past the input
+    bool read_length(const unsigned char*& in, const unsigned char* end, size_t& length) noexcept {
+        unsigned char byte;
+        do {
+            if (in >= end) return false;
+            byte = *in++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+} // End anonymous namespace
+
+size_t lz_compress_bound(size_t length) noexcept {
+    return length + length / 255 + 16;
+}
+
+void lz_compress_block(const unsigned char* data, size_t length, std::string& out) {
+    out.reserve(out.size() + lz_compress_bound(length));
+    std::uint32_t table[1u << HASH_BITS] = {0}; // Position + 1 of the last occurrence of each hash
+
+    size_t anchor = 0; // Start of pending literals
+    size_t pos = 0;
+    while (length >= MIN_MATCH && pos + MIN_MATCH <= length) {
+        const std::uint32_t sequence = read32(data + pos);
+        const unsigned slot = hash4(sequence);
+        const size_t candidate_plus_one = table[slot];
+        table[slot] = static_cast<std::uint32_t>(pos + 1);
+
+        if (candidate_plus_one == 0 || pos - (candidate_plus_one - 1) > MAX_OFFSET ||
+            read32(data + candidate_plus_one - 1) != sequence) {
+            ++pos;
+            continue;
+        }
+
+        const size_t candidate = candidate_plus_one - 1;
+        size_t match_length = MIN_MATCH;
+        while (pos + match_length < length && data[candidate + match_length] == data[pos + match_length]) {
+            ++match_length;
+        }
+        append_sequence(out, data + anchor, pos - anchor, pos - candidate, match_length);
+        pos += match_length;
+        anchor = pos;
+    }
+    append_sequence(out, data + anchor, length - anchor, 0, 0);
+}
+
+bool lz_decompress_block(const unsigned char* data, size_t length, unsigned char* out, size_t raw_size) noexcept {
+    const unsigned char* in = data;
+    const unsigned char* in_end = data + length;
+    size_t written = 0;
+    bool terminated = false; // The compressor always ends a block with a literal-only sequence
+    while (in < in_end) {
+        const unsigned token = *in++;
+        size_t literal_count = token >> 4;
+        if (literal_count == 15 && !read_length(in, in_end, literal_count)) return false;
+        if (literal_count > static_cast<size_t>(in_end - in) || literal_count > raw_size - written) return false;
+        std::memcpy(out + written, in, literal_count);
+        in += literal_count;
+        written += literal_count;
+        if (in == in_end) { // Final sequence
+            terminated = true;
+            break;
+        }
+
+        if (in_end - in < 2) return false;
+        const size_t offset = static_cast<size_t>(in[0]) | (static_cast<size_t>(in[1]) << 8);
+        in += 2;
+        size_t match_length = token & 0x0F;
+        if (match_length == 15 && !read_length(in, in_end, match_length)) return false;
+        match_length += MIN_MATCH;
+        if (offset == 0 || offset > written || match_length > raw_size - written) return false;
+        const unsigned char* match = out + written - offset;
+        for (size_t i = 0; i < match_length; ++i) { // Byte copy: the match may overlap its output
+            out[written + i] = match[i];
+        }
+        written += match_length;
+    }
+    return terminated && written == raw_size;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <cstddef> // For size_t
+
+// Small byte-oriented LZ77 codec (LZ4-style sequences) for archived history segments.
+// Each block is self-contained; callers keep the raw size alongside the compressed bytes.
+//
+// Sequence layout: token (high nibble literal count, low nibble match length - 4; 15 means
+// "more length bytes follow"), literal bytes, 2-byte little-endian match offset, extra length
+// bytes. The final sequence carries literals only.
+
+// Upper bound of the compressed size of 'length' input bytes
+size_t lz_compress_bound(size_t length) noexcept;
+
+// Appends the compressed form of [data, data + length) to 'out'
+void lz_compress_block(const unsigned char* data, size_t length, std::string& out);
+
+// Decompresses one block into exactly 'raw_size' bytes at 'out'. Returns false for corrupt or
+// truncated input, including a block that stops before its final literal-only sequence.
+bool lz_decompress_block(const unsigned char* data, size_t length, unsigned char* out, size_t raw_size) noexcept;
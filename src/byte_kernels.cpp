@@ -0,0 +1,336 @@
+#include "byte_kernels.h"
+
+#include <algorithm> // For std::min
+#include <cstring>   // For std::memchr, std::memcmp, std::memcpy, std::memset
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+    #define CIPHER_KERNELS_X86 1
+    #include <immintrin.h> // For SSE2/AVX2 intrinsics
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    #define CIPHER_KERNELS_NEON 1
+    #include <arm_neon.h>
+#endif
+
+// --- Anonymous Namespace for INTERNAL (File-Local) Helper Functions ---
+namespace {
+
+    // All kernels compare (a[i] + shift) mod 256 against b[i]; shift 0 is a plain compare
+    size_t count_matching_scalar(const unsigned char* a, const unsigned char* b, size_t begin, size_t end,
+                                 unsigned char shift, long long& first_diff_offset) {
+        size_t matching = 0;
+        for (size_t i = begin; i < end; ++i) {
+            if (static_cast<unsigned char>(a[i] + shift) == b[i]) {
+                matching++;
+            } else if (first_diff_offset == -1) {
+                first_diff_offset = static_cast<long long>(i);
+            }
+        }
+        return matching;
+    }
+
+    unsigned char normalize_shift(int pegs) {
+        return static_cast<unsigned char>(((pegs % 256) + 256) % 256);
+    }
+
+    void append_span(std::vector<ByteSpan>& spans, size_t max_spans, size_t begin, size_t end) {
+        if (!spans.empty() && spans.back().end == begin) {
+            spans.back().end = end;
+        } else if (spans.size() < max_spans) {
+            spans.push_back({begin, end});
+        }
+    }
+
+    size_t find_spans_scalar(const unsigned char* plain, const unsigned char* cipher, size_t begin, size_t end,
+                             unsigned char shift, std::vector<ByteSpan>& spans, size_t max_spans) {
+        size_t mismatches = 0;
+        for (size_t i = begin; i < end; ++i) {
+            if (static_cast<unsigned char>(plain[i] + shift) != cipher[i]) {
+                mismatches++;
+                append_span(spans, max_spans, i, i + 1);
+            }
+        }
+        return mismatches;
+    }
+
+    // memchr() for the first byte, then a full compare; memchr is vectorized by the C library
+    size_t find_sequence_scalar(const unsigned char* data, size_t begin, size_t length,
+                                const unsigned char* needle, size_t needle_length) {
+        const size_t last_start = length - needle_length;
+        size_t pos = begin;
+        while (pos <= last_start) {
+            const void* hit = std::memchr(data + pos, needle[0], last_start - pos + 1);
+            if (hit == nullptr) break;
+            pos = static_cast<size_t>(static_cast<const unsigned char*>(hit) - data);
+            if (std::memcmp(data + pos, needle, needle_length) == 0) return pos;
+            ++pos;
+        }
+        return length;
+    }
+
+#if defined(CIPHER_KERNELS_X86)
+    // Turns a mismatch bitmask covering bytes [base, base + width) into spans, one run at a time
+    void append_mask_spans(std::vector<ByteSpan>& spans, size_t max_spans, size_t base, unsigned long long diff) {
+        while (diff != 0) {
+            const int start = __builtin_ctzll(diff);
+            const unsigned long long rest = ~(diff >> start);
+            const int run = (rest == 0) ? 64 - start : __builtin_ctzll(rest);
+            append_span(spans, max_spans, base + start, base + start + run);
+            diff = (run + start >= 64) ? 0 : diff & ~(((1ull << run) - 1) << start);
+        }
+    }
+
+    // One bit per byte position, set where the bytes are equal
+    inline unsigned sse2_equal_mask(const unsigned char* a, const unsigned char* b, __m128i vshift) {
+        __m128i va = _mm_add_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a)), vshift);
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+        return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)));
+    }
+
+    size_t count_matching_sse2(const unsigned char* a, const unsigned char* b, size_t length,
+                               unsigned char shift, long long& first_diff_offset) {
+        const __m128i vshift = _mm_set1_epi8(static_cast<char>(shift));
+        size_t matching = 0;
+        size_t i = 0;
+        for (; i + 16 <= length; i += 16) {
+            unsigned mask = sse2_equal_mask(a + i, b + i, vshift);
+            matching += static_cast<size_t>(__builtin_popcount(mask));
+            if (mask != 0xFFFFu && first_diff_offset == -1) {
+                first_diff_offset = static_cast<long long>(i + __builtin_ctz(~mask));
+            }
+        }
+        return matching + count_matching_scalar(a, b, i, length, shift, first_diff_offset);
+    }
+
+    __attribute__((target("avx2")))
+    size_t count_matching_avx2(const unsigned char* a, const unsigned char* b, size_t length,
+                               unsigned char shift, long long& first_diff_offset) {
+        const __m256i vshift = _mm256_set1_epi8(static_cast<char>(shift));
+        size_t matching = 0;
+        size_t i = 0;
+        // 64 bytes per iteration: two 32-byte compares folded into one 64-bit mask
+        for (; i + 64 <= length; i += 64) {
+            __m256i a0 = _mm256_add_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)), vshift);
+            __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            __m256i a1 = _mm256_add_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 32)), vshift);
+            __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 32));
+            unsigned long long lo = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a0, b0)));
+            unsigned long long hi = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a1, b1)));
+            unsigned long long mask = lo | (hi << 32);
+            matching += static_cast<size_t>(__builtin_popcountll(mask));
+            if (mask != ~0ull && first_diff_offset == -1) {
+                first_diff_offset = static_cast<long long>(i + __builtin_ctzll(~mask));
+            }
+        }
+        for (; i + 32 <= length; i += 32) {
+            __m256i va = _mm256_add_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)), vshift);
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)));
+            matching += static_cast<size_t>(__builtin_popcount(mask));
+            if (mask != 0xFFFFFFFFu && first_diff_offset == -1) {
+                first_diff_offset = static_cast<long long>(i + __builtin_ctz(~mask));
+            }
+        }
+        return matching + count_matching_scalar(a, b, i, length, shift, first_diff_offset);
+    }
+
+    size_t find_spans_sse2(const unsigned char* plain, const unsigned char* cipher, size_t length,
+                           unsigned char shift, std::vector<ByteSpan>& spans, size_t max_spans) {
+        const __m128i vshift = _mm_set1_epi8(static_cast<char>(shift));
+        size_t mismatches = 0;
+        size_t i = 0;
+        for (; i + 16 <= length; i += 16) {
+            unsigned diff = ~sse2_equal_mask(plain + i, cipher + i, vshift) & 0xFFFFu;
+            if (diff == 0) continue; // Fast path: the whole block matches
+            mismatches += static_cast<size_t>(__builtin_popcount(diff));
+            append_mask_spans(spans, max_spans, i, diff);
+        }
+        return mismatches + find_spans_scalar(plain, cipher, i, length, shift, spans, max_spans);
+    }
+
+    __attribute__((target("avx2")))
+    size_t find_spans_avx2(const unsigned char* plain, const unsigned char* cipher, size_t length,
+                           unsigned char shift, std::vector<ByteSpan>& spans, size_t max_spans) {
+        const __m256i vshift = _mm256_set1_epi8(static_cast<char>(shift));
+        size_t mismatches = 0;
+        size_t i = 0;
+        for (; i + 32 <= length; i += 32) {
+            __m256i va = _mm256_add_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(plain + i)), vshift);
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cipher + i));
+            unsigned diff = ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)));
+            if (diff == 0) continue;
+            mismatches += static_cast<size_t>(__builtin_popcount(diff));
+            append_mask_spans(spans, max_spans, i, diff);
+        }
+        return mismatches + find_spans_scalar(plain, cipher, i, length, shift, spans, max_spans);
+    }
+
+    // Checks each position whose first and last bytes both matched; 'mask' has one bit per position
+    inline bool check_sequence_candidates(const unsigned char* block, unsigned long long mask,
+                                          const unsigned char* needle, size_t needle_length, size_t& found) {
+        while (mask != 0) {
+            const int bit = __builtin_ctzll(mask);
+            if (std::memcmp(block + bit + 1, needle + 1, needle_length - 2) == 0) {
+                found = static_cast<size_t>(bit);
+                return true;
+            }
+            mask &= mask - 1;
+        }
+        return false;
+    }
+
+    size_t find_sequence_sse2(const unsigned char* data, size_t length, const unsigned char* needle, size_t needle_length) {
+        const __m128i first = _mm_set1_epi8(static_cast<char>(needle[0]));
+        const __m128i last = _mm_set1_epi8(static_cast<char>(needle[needle_length - 1]));
+        size_t i = 0;
+        for (; i + needle_length - 1 + 16 <= length; i += 16) {
+            __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + needle_length - 1));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last))));
+            size_t found = 0;
+            if (mask != 0 && check_sequence_candidates(data + i, mask, needle, needle_length, found)) {
+                return i + found;
+            }
+        }
+        return find_sequence_scalar(data, i, length, needle, needle_length);
+    }
+
+    __attribute__((target("avx2")))
+    size_t find_sequence_avx2(const unsigned char* data, size_t length, const unsigned char* needle, size_t needle_length) {
+        const __m256i first = _mm256_set1_epi8(static_cast<char>(needle[0]));
+        const __m256i last = _mm256_set1_epi8(static_cast<char>(needle[needle_length - 1]));
+        size_t i = 0;
+        for (; i + needle_length - 1 + 32 <= length; i += 32) {
+            __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + needle_length - 1));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last))));
+            size_t found = 0;
+            if (mask != 0 && check_sequence_candidates(data + i, mask, needle, needle_length, found)) {
+                return i + found;
+            }
+        }
+        return find_sequence_scalar(data, i, length, needle, needle_length);
+    }
+
+    bool cpu_has_avx2() {
+        static const bool has_avx2 = __builtin_cpu_supports("avx2");
+        return has_avx2;
+    }
+#elif defined(CIPHER_KERNELS_NEON)
+    size_t count_matching_neon(const unsigned char* a, const unsigned char* b, size_t length,
+                               unsigned char shift, long long& first_diff_offset) {
+        const uint8x16_t vshift = vdupq_n_u8(shift);
+        size_t matching = 0;
+        size_t i = 0;
+        for (; i + 16 <= length; i += 16) {
+            uint8x16_t eq = vceqq_u8(vaddq_u8(vld1q_u8(a + i), vshift), vld1q_u8(b + i));
+            matching += vaddvq_u8(vshrq_n_u8(eq, 7));
+            if (first_diff_offset == -1 && vminvq_u8(eq) != 0xFF) {
+                count_matching_scalar(a, b, i, i + 16, shift, first_diff_offset);
+            }
+        }
+        return matching + count_matching_scalar(a, b, i, length, shift, first_diff_offset);
+    }
+
+    size_t find_spans_neon(const unsigned char* plain, const unsigned char* cipher, size_t length,
+                           unsigned char shift, std::vector<ByteSpan>& spans, size_t max_spans) {
+        const uint8x16_t vshift = vdupq_n_u8(shift);
+        size_t mismatches = 0;
+        size_t i = 0;
+        for (; i + 16 <= length; i += 16) {
+            uint8x16_t eq = vceqq_u8(vaddq_u8(vld1q_u8(plain + i), vshift), vld1q_u8(cipher + i));
+            if (vminvq_u8(eq) == 0xFF) continue; // Fast path: the whole block matches
+            mismatches += find_spans_scalar(plain, cipher, i, i + 16, shift, spans, max_spans);
+        }
+        return mismatches + find_spans_scalar(plain, cipher, i, length, shift, spans, max_spans);
+    }
+#endif
+
+} // End anonymous namespace
+
+// --- Public Function Implementations ---
+
+size_t count_matching_bytes(const unsigned char* a, const unsigned char* b, size_t length, long long& first_diff_offset) {
+    return count_matching_shifted(a, b, length, 0, first_diff_offset);
+}
+
+size_t count_matching_shifted(const unsigned char* plain, const unsigned char* cipher, size_t length, int pegs,
+                              long long& first_diff_offset) {
+    const unsigned char shift = normalize_shift(pegs);
+    first_diff_offset = -1;
+#if defined(CIPHER_KERNELS_X86)
+    if (cpu_has_avx2()) {
+        return count_matching_avx2(plain, cipher, length, shift, first_diff_offset);
+    }
+    return count_matching_sse2(plain, cipher, length, shift, first_diff_offset);
+#elif defined(CIPHER_KERNELS_NEON)
+    return count_matching_neon(plain, cipher, length, shift, first_diff_offset);
+#else
+    return count_matching_scalar(plain, cipher, 0, length, shift, first_diff_offset);
+#endif
+}
+
+size_t find_mismatch_spans(const unsigned char* plain, const unsigned char* cipher, size_t length, int pegs,
+                           std::vector<ByteSpan>& spans, size_t max_spans) {
+    const unsigned char shift = normalize_shift(pegs);
+#if defined(CIPHER_KERNELS_X86)
+    if (cpu_has_avx2()) {
+        return find_spans_avx2(plain, cipher, length, shift, spans, max_spans);
+    }
+    return find_spans_sse2(plain, cipher, length, shift, spans, max_spans);
+#elif defined(CIPHER_KERNELS_NEON)
+    return find_spans_neon(plain, cipher, length, shift, spans, max_spans);
+#else
+    return find_spans_scalar(plain, cipher, 0, length, shift, spans, max_spans);
+#endif
+}
+
+size_t find_byte_sequence(const unsigned char* data, size_t length, const unsigned char* needle, size_t needle_length) {
+    if (needle_length == 0) return 0;
+    if (needle_length > length) return length;
+    if (needle_length == 1) {
+        const void* hit = std::memchr(data, needle[0], length);
+        return hit ? static_cast<size_t>(static_cast<const unsigned char*>(hit) - data) : length;
+    }
+#if defined(CIPHER_KERNELS_X86)
+    if (cpu_has_avx2()) {
+        return find_sequence_avx2(data, length, needle, needle_length);
+    }
+    return find_sequence_sse2(data, length, needle, needle_length);
+#else
+    return find_sequence_scalar(data, 0, length, needle, needle_length);
+#endif
+}
+
+void accumulate_byte_histogram(const unsigned char* data, size_t length, unsigned long long counts[256]) {
+    // 32-bit sub-counters are flushed well before they could overflow
+    constexpr size_t FLUSH_INTERVAL = size_t(1) << 30;
+    unsigned int sub[4][256];
+
+    size_t offset = 0;
+    while (offset < length) {
+        const size_t chunk = std::min(FLUSH_INTERVAL, length - offset);
+        const unsigned char* p = data + offset;
+        std::memset(sub, 0, sizeof(sub));
+        size_t i = 0;
+        for (; i + 16 <= chunk; i += 16) {
+            unsigned long long w0, w1;
+            std::memcpy(&w0, p + i, 8);
+            std::memcpy(&w1, p + i + 8, 8);
+            for (int shift = 0; shift < 64; shift += 16) {
+                sub[0][(w0 >> shift) & 0xFF]++;
+                sub[1][(w0 >> (shift + 8)) & 0xFF]++;
+                sub[2][(w1 >> shift) & 0xFF]++;
+                sub[3][(w1 >> (shift + 8)) & 0xFF]++;
+            }
+        }
+        for (; i < chunk; ++i) {
+            sub[0][p[i]]++;
+        }
+        for (int b = 0; b < 256; ++b) {
+            counts[b] += static_cast<unsigned long long>(sub[0][b]) + sub[1][b] + sub[2][b] + sub[3][b];
+        }
+        offset += chunk;
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef> // For size_t
+#include <vector>
+
+// --- Vectorized Byte Kernels ---
+// Hot loops shared by the comparison and verification paths. Each kernel picks the widest
+// instruction set available at runtime (AVX2, SSE2 or NEON) and falls back to scalar code.
+
+// Half-open range [begin, end) of byte positions
+struct ByteSpan {
+    size_t begin = 0;
+    size_t end = 0;
+};
+
+// Counts positions where a[i] == b[i] for i in [0, length).
+// 'first_diff_offset' receives the index of the first mismatch, or -1 if every byte matched.
+size_t count_matching_bytes(const unsigned char* a, const unsigned char* b, size_t length, long long& first_diff_offset);
+
+// Fused shift-and-compare: counts positions where (plain[i] + pegs) mod 256 == cipher[i].
+// The shifted plaintext only ever exists in registers, so no ciphertext copy is materialized.
+size_t count_matching_shifted(const unsigned char* plain, const unsigned char* cipher, size_t length, int pegs,
+                              long long& first_diff_offset);
+
+// Appends the runs of positions where (plain[i] + pegs) mod 256 != cipher[i] to 'spans', merging
+// runs that touch. Recording stops once 'spans' holds 'max_spans' entries, but the returned
+// count of mismatching bytes always covers the whole input.
+size_t find_mismatch_spans(const unsigned char* plain, const unsigned char* cipher, size_t length, int pegs,
+                           std::vector<ByteSpan>& spans, size_t max_spans);
+
+// Adds the byte frequencies of data[0, length) to 'counts'. Uses four interleaved sub-histograms
+// so consecutive equal bytes do not serialize on the same counter.
+void accumulate_byte_histogram(const unsigned char* data, size_t length, unsigned long long counts[256]);
+
+// Offset of the first occurrence of needle[0, needle_length) in data[0, length), or 'length' if
+// there is none. Candidates are found by comparing the needle's first and last bytes a whole
+// vector at a time; only positions where both match are checked in full.
+size_t find_byte_sequence(const unsigned char* data, size_t length, const unsigned char* needle, size_t needle_length);
@@ -1,25 +1,36 @@
 #include "cipher_utils.h"
+#include "byte_kernels.h"
+#include "file_view.h"
+#include "history_log.h"
+#include "op_metrics.h"
+#include "vault.h"
 
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <vector>
-#include <chrono>
 #include <iomanip>
 #include <sstream>
 #include <algorithm>
+#include <memory> // For std::unique_ptr
+#include <optional>
 #include <cstdio> // For std::rename, std::remove
-
-// OpenSSL for SHA256 hashing
-#include <openssl/evp.h>
-#include <openssl/err.h>
+#include <cstdlib> // For std::atoi
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
 
 // Platform-specific includes for directory operations
 #if defined(_WIN32) || defined(_WIN64)
     #include <windows.h>
     #include <direct.h> // For _mkdir
+    #include <io.h>     // For _write
 #else
     #include <sys/stat.h> // For stat, mkdir
+    #include <dirent.h>   // For opendir, readdir
+    #include <fcntl.h>    // For AT_FDCWD, AT_EACCESS
+    #include <unistd.h>   // For faccessat, write
+    #include <cerrno>
 #endif
 
 // --- Definitions for Global Constants ---
@@ -55,79 +66,221 @@ std::string path_get_filename(const std::string& path) {
 }
 
 #if defined(_WIN32) || defined(_WIN64)
-    bool is_directory(const std::string& path) {
-        DWORD attrib = GetFileAttributesA(path.c_str());
-        return (attrib != INVALID_FILE_ATTRIBUTES && (attrib & FILE_ATTRIBUTE_DIRECTORY));
+    FileInfo get_file_info(const std::string& path) {
+        FileInfo info;
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data)) return info;
+        info.exists = true;
+        info.is_directory = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        info.is_regular = !info.is_directory && !(data.dwFileAttributes & FILE_ATTRIBUTE_DEVICE);
+        info.size = (static_cast<unsigned long long>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+        // FILETIME counts 100 ns ticks since 1601-01-01
+        const unsigned long long ticks = (static_cast<unsigned long long>(data.ftLastWriteTime.dwHighDateTime) << 32) |
+                                         data.ftLastWriteTime.dwLowDateTime;
+        info.modified_ms = static_cast<long long>(ticks / 10000) - 11644473600000LL;
+        return info;
     }
     bool create_directory(const std::string& path) {
         return _mkdir(path.c_str()) == 0;
     }
+    bool write_all(int fd, const void* data, size_t length) {
+        const char* bytes = static_cast<const char*>(data);
+        while (length > 0) {
+            int chunk = static_cast<int>(length > (1u << 30) ? (1u << 30) : length);
+            int written = _write(fd, bytes, static_cast<unsigned>(chunk));
+            if (written <= 0) return false;
+            bytes += written;
+            length -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+    bool replace_file(const std::string& from, const std::string& to) {
+        return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+    }
+    std::vector<std::string> list_directory_files(const std::string& dir_path) {
+        std::vector<std::string> names;
+        WIN32_FIND_DATAA entry;
+        HANDLE find = FindFirstFileA(path_join(dir_path, "*").c_str(), &entry);
+        if (find == INVALID_HANDLE_VALUE) return names;
+        do {
+            if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+                names.emplace_back(entry.cFileName);
+            }
+        } while (FindNextFileA(find, &entry));
+        FindClose(find);
+        return names;
+    }
 #else // For macOS, Linux, etc.
-    bool is_directory(const std::string& path) {
-        struct stat info;
-        if (stat(path.c_str(), &info) != 0) return false;
-        return (info.st_mode & S_IFDIR) != 0;
+    FileInfo get_file_info(const std::string& path) {
+        FileInfo info;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) return info;
+        info.exists = true;
+        info.is_regular = S_ISREG(st.st_mode);
+        info.is_directory = S_ISDIR(st.st_mode);
+        info.size = static_cast<unsigned long long>(st.st_size);
+        info.device = static_cast<unsigned long long>(st.st_dev);
+        info.inode = static_cast<unsigned long long>(st.st_ino);
+        info.modified_ms = static_cast<long long>(st.st_mtime) * 1000;
+        return info;
     }
     bool create_directory(const std::string& path) {
         return mkdir(path.c_str(), 0755) == 0;
     }
+    bool write_all(int fd, const void* data, size_t length) {
+        const char* bytes = static_cast<const char*>(data);
+        while (length > 0) {
+            ssize_t written = ::write(fd, bytes, length);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            bytes += written;
+            length -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+    bool replace_file(const std::string& from, const std::string& to) {
+        return std::rename(from.c_str(), to.c_str()) == 0;
+    }
+    std::vector<std::string> list_directory_files(const std::string& dir_path) {
+        std::vector<std::string> names;
+        DIR* dir = opendir(dir_path.c_str());
+        if (!dir) return names;
+        while (struct dirent* entry = readdir(dir)) {
+            const std::string name = entry->d_name;
+            if (name == "." || name == "..") continue;
+        #if defined(DT_REG) && defined(DT_UNKNOWN)
+            if (entry->d_type == DT_REG) { names.push_back(name); continue; }
+            if (entry->d_type != DT_UNKNOWN) continue;
+        #endif
+            struct stat info;
+            if (stat(path_join(dir_path, name).c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+                names.push_back(name);
+            }
+        }
+        closedir(dir);
+        return names;
+    }
 #endif
 
 bool file_exists(const std::string& path) {
-    std::ifstream f(path.c_str());
-    return f.good();
+    return get_file_info(path).exists;
 }
 
 bool is_regular_file(const std::string& path) {
-    return file_exists(path) && !is_directory(path);
+    return get_file_info(path).is_regular;
+}
+
+bool is_directory(const std::string& path) {
+    return get_file_info(path).is_directory;
 }
 
 // --- Anonymous Namespace for INTERNAL (File-Local) Helper Functions ---
 namespace {
 
-    long long get_file_size(const std::string& path) {
-        std::ifstream file(path, std::ios::binary | std::ios::ate);
-        if (!file) return -1;
-        return static_cast<long long>(file.tellg());
-    }
-
     std::string path_get_extension(const std::string& path) {
         std::string filename = path_get_filename(path);
         size_t pos = filename.find_last_of('.');
         return (pos != std::string::npos) ? filename.substr(pos) : "";
     }
 
-    bool manual_copy_file(const std::string& src, const std::string& dest) {
-        std::ifstream src_stream(src, std::ios::binary);
-        if (!src_stream) return false;
-        std::ofstream dest_stream(dest, std::ios::binary | std::ios::trunc);
-        if (!dest_stream) return false;
-        dest_stream << src_stream.rdbuf();
-        return src_stream.good() && dest_stream.good();
+    // Asks the OS whether new files can be created in 'dir' without touching the directory
+    bool query_directory_writable(const std::string& dir) {
+    #if defined(_WIN32) || defined(_WIN64)
+        // _access() ignores ACLs, so Windows still probes, but with a per-thread name (no clash
+        // with concurrent jobs) and a handle that deletes the file itself when closed
+        const std::string probe = path_join(dir, "write_check_" + std::to_string(GetCurrentProcessId()) + "_" +
+                                                 std::to_string(GetCurrentThreadId()) + ".tmp");
+        HANDLE handle = CreateFileA(probe.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW,
+                                    FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) return false;
+        CloseHandle(handle);
+        return true;
+    #else
+        // Write and search permission on the directory are what creating an entry needs
+        return faccessat(AT_FDCWD, dir.c_str(), W_OK | X_OK, AT_EACCESS) == 0;
+    #endif
     }
-    
+
+    // Writability per output directory, so a batch writing many files into one directory
+    // asks once. Entries are tied to the directory's identity and expire so permission
+    // changes are noticed; the real open in process_file_core still reports any failure.
+    class WritableDirectoryCache {
+    public:
+        bool is_writable(const std::string& dir, const FileInfo& info) {
+            const auto now = std::chrono::steady_clock::now();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = entries.find(dir);
+                if (it != entries.end() && it->second.device == info.device && it->second.inode == info.inode &&
+                    now - it->second.checked_at < ENTRY_LIFETIME) {
+                    return it->second.writable;
+                }
+            }
+            const bool writable = query_directory_writable(dir);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (entries.size() >= MAX_ENTRIES) entries.clear();
+            entries[dir] = Entry{info.device, info.inode, writable, now};
+            return writable;
+        }
+
+    private:
+        struct Entry {
+            unsigned long long device = 0;
+            unsigned long long inode = 0;
+            bool writable = false;
+            std::chrono::steady_clock::time_point checked_at;
+        };
+        inline static constexpr std::chrono::seconds ENTRY_LIFETIME{5};
+        inline static constexpr size_t MAX_ENTRIES = 1024;
+
+        std::mutex mutex;
+        std::unordered_map<std::string, Entry> entries;
+    };
+
+    WritableDirectoryCache& writable_directory_cache() {
+        static WritableDirectoryCache cache;
+        return cache;
+    }
+
     bool validate_output_file(const std::string& output_filename, const std::string& input_filename) {
         if (!input_filename.empty() && output_filename == input_filename) {
             std::cerr << "Error (Output): Output file cannot be the same as the input file.\n";
             return false;
         }
         std::string parent_dir = path_get_parent(output_filename);
-        if (!is_directory(parent_dir)) {
+        const FileInfo parent_info = get_file_info(parent_dir);
+        if (!parent_info.is_directory) {
             std::cerr << "Error (Output): Directory '" << parent_dir << "' does not exist.\n";
             return false;
         }
-        std::string temp_file_path = path_join(parent_dir, "write_check.tmp");
-        std::ofstream temp_stream(temp_file_path);
-        if (!temp_stream.is_open()) {
+        if (!writable_directory_cache().is_writable(parent_dir, parent_info)) {
             std::cerr << "Error (Output): Cannot write to output directory '" << parent_dir << "'. Check permissions.\n";
             return false;
         }
-        temp_stream.close();
-        std::remove(temp_file_path.c_str());
         return true;
     }
 
-    bool process_file_core(const std::string& input_file, const std::string& output_file, int pegs, bool encrypt_mode) {
+    // Largest read/write buffer used when processing a file; small files get a buffer of their own size
+    constexpr size_t PROCESS_BUFFER_MAX = 256 * BUFFER_SIZE;
+
+    bool check_input_info(const std::string& filename, const FileInfo& info) {
+        if (!info.is_regular) {
+            std::cerr << "Error (Input): File '" << filename << "' does not exist or is not a regular file.\n";
+            return false;
+        }
+        if (info.size == 0) {
+            std::cerr << "Error (Input): File '" << filename << "' is empty.\n";
+            return false;
+        }
+        return true;
+    }
+
+    // 'out_input_digest', if given, receives the SHA-256 of the input, computed as it is read
+    // (left empty if hashing failed)
+    bool process_file_core(const std::string& input_file, const FileInfo& input_info, const std::string& output_file,
+                           int pegs, bool encrypt_mode, std::optional<Sha256Digest>* out_input_digest = nullptr) {
         std::ifstream in(input_file, std::ios::binary);
         if (!in) {
             std::cerr << "Error: Could not open input file: " << input_file << '\n';
@@ -140,9 +293,16 @@ namespace {
         }
         const char* mode_str = encrypt_mode ? "Encrypting" : "Decrypting";
         std::cout << mode_str << " " << input_file << " -> " << output_file << " (Pegs: " << pegs << ")\n";
-        std::vector<unsigned char> buffer(BUFFER_SIZE);
+        const OperationTimer timer;
+        unsigned long long total_bytes = 0;
+        std::unique_ptr<Sha256Stream> input_hash;
+        if (out_input_digest) input_hash = std::make_unique<Sha256Stream>();
+        std::vector<unsigned char> buffer(static_cast<size_t>(
+            std::clamp<unsigned long long>(input_info.size, BUFFER_SIZE, PROCESS_BUFFER_MAX)));
         while (in.read(reinterpret_cast<char*>(buffer.data()), buffer.size()) || in.gcount() > 0) {
             size_t bytes_read = static_cast<size_t>(in.gcount());
+            total_bytes += bytes_read;
+            if (input_hash) input_hash->update(buffer.data(), bytes_read);
             for (size_t i = 0; i < bytes_read; ++i) {
                 if (encrypt_mode) {
                     buffer[i] = static_cast<unsigned char>((buffer[i] + pegs) % 256);
@@ -160,25 +320,59 @@ namespace {
             return false;
         }
         std::cout << "Success: File processing complete.\n";
-        log_operation((encrypt_mode ? "ENCRYPT" : "DECRYPT"), input_file, output_file, pegs);
+        HistoryRecord record;
+        record.op = encrypt_mode ? "ENCRYPT" : "DECRYPT";
+        record.input_path = input_file;
+        record.output_path = output_file;
+        record.pegs = pegs;
+        Sha256Digest input_digest;
+        if (input_hash && input_hash->finish(input_digest)) {
+            record.input_sha256 = input_digest.to_hex();
+            *out_input_digest = input_digest;
+        }
+        timer.stamp(record, total_bytes, IO_BACKEND_STREAM);
+        log_operation(std::move(record));
         return true;
     }
     
-    void log_to_file(const std::string& message) {
-        std::ofstream file(HISTORY_FILE, std::ios::app);
-        if (!file) {
-            std::cerr << "Warning: Could not open history file '" << HISTORY_FILE << "' for logging.\n";
-            return;
+    // 'entry' carries what the caller knows about the original (pegs, digest, encrypted path)
+    bool move_into_vault(const std::string& original_filepath, const FileInfo& original_info, VaultEntry entry) {
+        if (!ensure_private_vault_exists()) return false;
+
+        if (!original_info.is_regular) {
+            std::cerr << "Error (Vault): Source '" << original_filepath << "' is not a valid file to move.\n";
+            return false;
         }
-        auto now = std::chrono::system_clock::now();
-        std::time_t now_c = std::chrono::system_clock::to_time_t(now);
-        std::tm now_tm_obj{};
-    #if defined(_WIN32) || defined(_WIN64)
-        localtime_s(&now_tm_obj, &now_c);
-    #else
-        localtime_r(&now_c, &now_tm_obj);
-    #endif
-        file << std::put_time(&now_tm_obj, "%Y-%m-%d %H:%M:%S") << " | " << message << '\n';
+
+        entry.name = path_get_filename(original_filepath);
+        entry.size = original_info.size;
+        entry.modified_ms = original_info.modified_ms;
+        entry.original_path = original_filepath;
+        bool deduplicated = false;
+        switch (Vault::instance().store(original_filepath, std::move(entry))) {
+            case VaultStoreResult::Stored:
+                break;
+            case VaultStoreResult::Deduplicated:
+                deduplicated = true;
+                break;
+            case VaultStoreResult::NameTaken:
+                std::cerr << "Error (Vault): A file with the name '" << path_get_filename(original_filepath)
+                          << "' already exists in the vault.\n";
+                return false;
+            case VaultStoreResult::Failed:
+                std::cerr << "Error (Vault): Failed to move '" << original_filepath << "'. Check permissions.\n";
+                return false;
+        }
+
+        log_event("VAULT_STORE", "Moved to vault: " + path_get_filename(original_filepath) +
+                                 (deduplicated ? " (deduplicated)" : ""));
+        return true;
+    }
+
+    // Hands the line and its structured record to the background history writer;
+    // the caller never touches the files
+    void log_to_file(std::string message, HistoryRecord record) {
+        HistoryLogger::instance().append(std::move(message), std::move(record));
     }
 
 } // End anonymous namespace
@@ -191,15 +385,7 @@ bool has_txt_extension(const std::string& filename) {
 }
 
 bool validate_input_file(const std::string& filename) {
-    if (!is_regular_file(filename)) {
-        std::cerr << "Error (Input): File '" << filename << "' does not exist or is not a regular file.\n";
-        return false;
-    }
-    if (get_file_size(filename) == 0) {
-        std::cerr << "Error (Input): File '" << filename << "' is empty.\n";
-        return false;
-    }
-    return true;
+    return check_input_info(filename, get_file_info(filename));
 }
 
 bool validate_peg_value(int peg) {
@@ -242,18 +428,27 @@ bool encrypt_file(const std::string& input_file, int pegs) {
         log_event("ENCRYPT_FAIL", "Attempted to re-encrypt file: " + input_file);
         return false;
     }
-    if (!validate_encryption_params_new(input_file, pegs)) {
+    // The input is queried once; validation, processing and the vault move all reuse the result
+    const FileInfo input_info = get_file_info(input_file);
+    std::string output_file = path_join(path_get_parent(input_file), "enc_" + path_get_filename(input_file));
+    if (!check_input_info(input_file, input_info) || !validate_peg_value(pegs) || !validate_output_file(output_file, input_file)) {
         return false;
     }
     
-    std::string output_file = path_join(path_get_parent(input_file), "enc_" + path_get_filename(input_file));
-    
-    if (!process_file_core(input_file, output_file, pegs, true)) {
+    std::optional<Sha256Digest> input_digest;
+    if (!process_file_core(input_file, input_info, output_file, pegs, true, &input_digest)) {
         log_event("ENCRYPT_FAIL", "Core processing failed for: " + input_file);
         return false;
     }
+    VaultEntry vault_entry;
+    if (input_digest) {
+        vault_entry.digest = *input_digest;
+        vault_entry.has_digest = true;
+    }
+    vault_entry.pegs = pegs;
+    vault_entry.encrypted_path = output_file;
     
-    if (!move_to_vault(input_file)) {
+    if (!move_into_vault(input_file, input_info, std::move(vault_entry))) {
         std::cerr << "Warning: Encryption succeeded, but failed to move original file to the vault.\n";
         log_event("VAULT_FAIL", "Failed to move " + input_file + " to vault post-encryption.");
     }
@@ -261,75 +456,133 @@ bool encrypt_file(const std::string& input_file, int pegs) {
 }
 
 bool decrypt_file(const std::string& input_file, const std::string& output_file, int pegs) {
-    OperationParams params = {input_file, output_file, pegs};
-    if (!validate_decryption_params(params)) {
+    // Same checks and order as validate_decryption_params, with the input queried only once
+    const FileInfo input_info = get_file_info(input_file);
+    if (!check_input_info(input_file, input_info) || !validate_output_file(output_file, input_file) || !validate_peg_value(pegs)) {
         return false;
     }
-    return process_file_core(input_file, output_file, pegs, false);
+    return process_file_core(input_file, input_info, output_file, pegs, false);
 }
 
 bool move_to_vault(const std::string& original_filepath) {
-    if (!ensure_private_vault_exists()) return false;
-    
-    if (!is_regular_file(original_filepath)) {
-        std::cerr << "Error (Vault): Source '" << original_filepath << "' is not a valid file to move.\n";
-        return false;
-    }
-    
-    std::string dest_in_vault = path_join(PRIVATE_VAULT_DIR, path_get_filename(original_filepath));
-    if (file_exists(dest_in_vault)) {
-        std::cerr << "Error (Vault): A file with the name '" << path_get_filename(original_filepath)
-                  << "' already exists in the vault.\n";
-        return false;
-    }
-    
-    if (std::rename(original_filepath.c_str(), dest_in_vault.c_str()) != 0) {
-        std::cerr << "Error (Vault): Failed to move '" << original_filepath << "'. Check permissions.\n";
-        return false;
-    }
-    
-    log_event("VAULT_STORE", "Moved to vault: " + path_get_filename(original_filepath));
-    return true;
+    return move_into_vault(original_filepath, get_file_info(original_filepath), VaultEntry{});
 }
 
-bool retrieve_from_vault(const std::string& filename_in_vault, const std::string& destination_path) {
+bool retrieve_from_vault(const std::string& filename_in_vault, const std::string& destination_path,
+                         bool keep_in_vault) {
     if (!ensure_private_vault_exists()) {
         std::cerr << "Error (Retrieve): Private vault does not exist.\n";
         return false;
     }
     
-    std::string source_in_vault = path_join(PRIVATE_VAULT_DIR, filename_in_vault);
-    if (!is_regular_file(source_in_vault)) {
+    // The vault copies straight from wherever the entry's data lives (a file or a pack record), so
+    // the entry is named here, never opened by path
+    Vault& vault = Vault::instance();
+    const FileInfo source_info = vault.entry_info(filename_in_vault);
+    if (!source_info.is_regular) {
         std::cerr << "Error (Retrieve): File '" << filename_in_vault << "' not found in the vault.\n";
         return false;
     }
     
-    if (!validate_output_file(destination_path, source_in_vault)) {
+    // The vault itself refuses destinations inside it, wherever the entry's data lives
+    if (!validate_output_file(destination_path, "")) {
         return false;
     }
     
-    if (!manual_copy_file(source_in_vault, destination_path)) {
-        std::cerr << "Error (Retrieve): Failed to copy file from vault to '" << destination_path << "'.\n";
-        log_event("RETRIEVE_FAIL", "Failed copy from " + filename_in_vault + " to " + destination_path);
+    const OperationTimer timer;
+    unsigned long long bytes_copied = 0;
+    const char* io_backend = IO_BACKEND_READ;
+    const bool retrieved = keep_in_vault ? vault.copy_out(filename_in_vault, destination_path, bytes_copied, io_backend)
+                                         : vault.move_out(filename_in_vault, destination_path, bytes_copied, io_backend);
+    if (!retrieved) {
+        std::cerr << "Error (Retrieve): Failed to " << (keep_in_vault ? "copy" : "move") << " file from vault to '"
+                  << destination_path << "'.\n";
+        log_event("RETRIEVE_FAIL", std::string(keep_in_vault ? "Failed copy from " : "Failed move from ") +
+                                   filename_in_vault + " to " + destination_path);
         return false;
     }
     
-    std::cout << "Info: File '" << filename_in_vault << "' retrieved to '" << destination_path << "'.\n";
-    log_event("VAULT_RETRIEVE", filename_in_vault + " retrieved to " + destination_path);
+    std::cout << "Info: File '" << filename_in_vault << "' " << (keep_in_vault ? "retrieved" : "moved out of the vault")
+              << " to '" << destination_path << "'.\n";
+    HistoryRecord record;
+    record.op = "VAULT_RETRIEVE";
+    record.input_path = filename_in_vault;
+    record.output_path = destination_path;
+    record.details = filename_in_vault + (keep_in_vault ? " retrieved to " : " moved out to ") + destination_path;
+    timer.stamp(record, bytes_copied, io_backend);
+    log_event(std::move(record));
     return true;
 }
 
 // --- History and Logging ---
 void log_operation(const std::string& op_type, const std::string& in_file, const std::string& out_file, int pegs) {
+    HistoryRecord record;
+    record.op = op_type;
+    record.input_path = in_file;
+    record.output_path = out_file;
+    record.pegs = pegs;
+    log_operation(std::move(record));
+}
+
+void log_operation(HistoryRecord record) {
     std::ostringstream msg;
-    msg << op_type << ": " << in_file << " -> " << out_file << " (pegs: " << pegs << ")";
-    log_to_file(msg.str());
+    msg << record.op << ": " << record.input_path << " -> " << record.output_path << " (pegs: " << record.pegs << ")";
+    log_to_file(msg.str(), std::move(record));
 }
 
 void log_event(const std::string& event_type, const std::string& details) {
+    HistoryRecord record;
+    record.op = event_type;
+    record.details = details;
+    log_event(std::move(record));
+}
+
+void log_event(HistoryRecord record) {
     std::ostringstream msg;
-    msg << "EVENT (" << event_type << "): " << details;
-    log_to_file(msg.str());
+    msg << "EVENT (" << record.op << "): " << record.details;
+    log_to_file(msg.str(), std::move(record));
+}
+
+std::vector<EncryptionRecord> load_encryption_records() {
+    std::vector<EncryptionRecord> records;
+    HistoryLogger::instance().flush_structured(); // Include records still queued for the writer
+
+    // The structured log holds everything (legacy lines are imported when it is created)
+    if (is_regular_file(HISTORY_LOG_FILE)) {
+        for (HistoryRecord& entry : load_history_records_by_op("ENCRYPT")) {
+            if (entry.pegs >= MIN_PEG && entry.pegs <= MAX_PEG) {
+                records.push_back({std::move(entry.input_path), std::move(entry.output_path), entry.pegs});
+            }
+        }
+        return records;
+    }
+
+    std::ifstream file(HISTORY_FILE);
+    if (!file) return records;
+
+    // Matches "... ENCRYPT: <input> -> <output> (pegs: N) ..." as written by log_operation
+    const std::string op_marker = "ENCRYPT: ";
+    const std::string arrow = " -> ";
+    const std::string pegs_marker = " (pegs: ";
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t op_pos = line.find(op_marker);
+        if (op_pos == std::string::npos || (op_pos > 0 && line[op_pos - 1] == 'D')) continue; // Skip DECRYPT
+        size_t in_begin = op_pos + op_marker.size();
+        size_t arrow_pos = line.find(arrow, in_begin);
+        if (arrow_pos == std::string::npos) continue;
+        size_t pegs_pos = line.rfind(pegs_marker);
+        if (pegs_pos == std::string::npos || pegs_pos < arrow_pos) continue;
+
+        EncryptionRecord record;
+        record.input_file = line.substr(in_begin, arrow_pos - in_begin);
+        record.output_file = line.substr(arrow_pos + arrow.size(), pegs_pos - arrow_pos - arrow.size());
+        record.pegs = std::atoi(line.c_str() + pegs_pos + pegs_marker.size());
+        if (record.pegs >= MIN_PEG && record.pegs <= MAX_PEG) {
+            records.push_back(std::move(record));
+        }
+    }
+    return records;
 }
 
 // --- Admin/Security ---
@@ -338,74 +591,24 @@ bool check_admin_password(const std::string& password_attempt) {
 }
 
 bool ensure_private_vault_exists() {
-    if (is_directory(PRIVATE_VAULT_DIR)) {
-        return true;
-    }
-    if (file_exists(PRIVATE_VAULT_DIR)) {
-        std::cerr << "Error: Vault path '" << PRIVATE_VAULT_DIR << "' exists but is not a directory.\n";
-        return false;
-    }
-    if (!create_directory(PRIVATE_VAULT_DIR)) {
-        std::cerr << "Error: Could not create private vault directory '" << PRIVATE_VAULT_DIR << "'.\n";
-        return false;
-    }
-    std::cout << "Info: Private vault directory created: '" << PRIVATE_VAULT_DIR << "'\n";
-    return true;
+    return Vault::instance().open(); // Opened (or created) once, then free
 }
 
 // --- Comparison and Hashing ---
 std::string calculate_sha256(const std::string& filepath) {
-    std::ifstream file(filepath, std::ios::binary);
-    if (!file) {
-        log_event("HASH_ERROR", "Could not open file for hashing: " + filepath);
-        return "";
-    }
-
-    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-    const EVP_MD* md = EVP_get_digestbyname("SHA256");
-    if (!mdctx || !md) {
-        log_event("HASH_ERROR", "OpenSSL SHA256 setup failed for: " + filepath);
-        if (mdctx) EVP_MD_CTX_free(mdctx);
-        return "";
-    }
-
-    if (1 != EVP_DigestInit_ex(mdctx, md, nullptr)) {
-        log_event("HASH_ERROR", "EVP_DigestInit_ex failed for: " + filepath);
-        EVP_MD_CTX_free(mdctx);
-        return "";
-    }
-
-    std::vector<char> read_buffer(BUFFER_SIZE);
-    while (file.read(read_buffer.data(), read_buffer.size()) || file.gcount() > 0) {
-        if (1 != EVP_DigestUpdate(mdctx, read_buffer.data(), file.gcount())) {
-            log_event("HASH_ERROR", "EVP_DigestUpdate failed for: " + filepath);
-            EVP_MD_CTX_free(mdctx);
-            return "";
-        }
-    }
-
-    if (file.bad()) {
-        log_event("HASH_ERROR", "File read error during hashing: " + filepath);
-        EVP_MD_CTX_free(mdctx);
-        return "";
-    }
-
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int hash_len = 0;
-    if (1 != EVP_DigestFinal_ex(mdctx, hash, &hash_len)) {
-        log_event("HASH_ERROR", "EVP_DigestFinal_ex failed for: " + filepath);
-        EVP_MD_CTX_free(mdctx);
+    Sha256Digest digest;
+    if (!calculate_sha256_digest(filepath, digest)) {
         return "";
     }
+    return digest.to_hex();
+}
 
-    EVP_MD_CTX_free(mdctx);
+bool calculate_sha256_digest(const std::string& filepath, Sha256Digest& out_digest) {
+    return HashService::instance().sha256_file(filepath, out_digest);
+}
 
-    std::ostringstream ss;
-    ss << std::hex << std::setfill('0');
-    for (unsigned int i = 0; i < hash_len; ++i) {
-        ss << std::setw(2) << static_cast<int>(hash[i]);
-    }
-    return ss.str();
+bool calculate_fast_hash(const std::string& filepath, FastDigest& out_digest) {
+    return HashService::instance().fast_hash_file(filepath, out_digest);
 }
 
 std::string load_file_content_to_string(const std::string& filepath, size_t max_chars_to_load) {
@@ -429,27 +632,24 @@ std::string load_file_content_to_string(const std::string& filepath, size_t max_
     return content;
 }
 
-TextCompareResult compare_string_contents(const std::string& content1, const std::string& content2,
+TextCompareResult compare_string_contents(std::string_view content1, std::string_view content2,
                                           const std::string& label1, const std::string& label2) {
+    const OperationTimer timer;
     TextCompareResult result;
     result.files_readable = true;
-    result.content1 = content1;
-    result.content2 = content2;
+    result.length1 = content1.length();
+    result.length2 = content2.length();
 
-    const size_t len1 = content1.length();
-    const size_t len2 = content2.length();
+    const size_t len1 = result.length1;
+    const size_t len2 = result.length2;
     const size_t min_len = std::min(len1, len2);
     const size_t max_len = std::max(len1, len2);
-    size_t matching_chars = 0;
-    result.first_diff_offset = -1;
-
-    for (size_t i = 0; i < min_len; ++i) {
-        if (content1[i] == content2[i]) {
-            matching_chars++;
-        } else if (result.first_diff_offset == -1) {
-            result.first_diff_offset = static_cast<long>(i);
-        }
-    }
+    long long first_diff = -1;
+    const size_t matching_chars = count_matching_bytes(reinterpret_cast<const unsigned char*>(content1.data()),
+                                                       reinterpret_cast<const unsigned char*>(content2.data()),
+                                                       min_len, first_diff);
+    result.matching_chars = matching_chars;
+    result.first_diff_offset = static_cast<long>(first_diff);
 
     if (max_len > 0) {
         result.match_percentage = (static_cast<float>(matching_chars) / static_cast<float>(max_len)) * 100.0f;
@@ -461,7 +661,11 @@ TextCompareResult compare_string_contents(const std::string& content1, const std
         result.first_diff_offset = static_cast<long>(min_len);
     }
     
-    log_event("COMPARE_STRINGS", "Compared " + label1 + " with " + label2);
+    HistoryRecord record;
+    record.op = "COMPARE_STRINGS";
+    record.details = "Compared " + label1 + " with " + label2;
+    timer.stamp(record, len1 + len2, IO_BACKEND_MEMORY);
+    log_event(std::move(record));
     return result;
 }
 
@@ -475,66 +679,95 @@ TextCompareResult compare_text_files(const std::string& filepath1, const std::st
         result.error_message = "File 2 not found or is not a regular file: " + filepath2;
         return result;
     }
-    result.content1 = load_file_content_to_string(filepath1, max_chars);
-    result.content2 = load_file_content_to_string(filepath2, max_chars);
-    result.files_readable = true;
+    // Compare the mapped files in place; nothing is copied into std::string buffers
+    FileView view1;
+    FileView view2;
+    if (!view1.open(filepath1, max_chars)) {
+        result.error_message = "Could not read file 1: " + filepath1;
+        return result;
+    }
+    if (!view2.open(filepath2, max_chars)) {
+        result.error_message = "Could not read file 2: " + filepath2;
+        return result;
+    }
+    return compare_string_contents(view1.view(), view2.view(), filepath1, filepath2);
+}
 
-    return compare_string_contents(result.content1, result.content2, filepath1, filepath2);
+TextCompareExcerpt materialize_compare_excerpt(std::string_view content1, std::string_view content2,
+                                               long long first_diff_offset, size_t max_chars) {
+    TextCompareExcerpt excerpt;
+    if (first_diff_offset > 0) {
+        // Keep a little leading context so the difference is not the first visible character
+        const size_t diff = static_cast<size_t>(first_diff_offset);
+        excerpt.offset = diff - std::min(diff, max_chars / 4);
+    }
+    excerpt.content1 = std::string(content1.substr(std::min(excerpt.offset, content1.size()), max_chars));
+    excerpt.content2 = std::string(content2.substr(std::min(excerpt.offset, content2.size()), max_chars));
+    return excerpt;
 }
 
 BinaryCompareResult compare_binary_files(const std::string& filepath1, const std::string& filepath2) {
+    const OperationTimer timer;
     BinaryCompareResult result;
+    unsigned long long bytes_read = 0; // Hashing reads both files once per digest computed
 
-    // Process File 1
-    result.file1_exists = is_regular_file(filepath1);
+    // One stat per file gives both existence and size
+    const FileInfo info1 = get_file_info(filepath1);
+    const bool size1_known = info1.is_regular;
+    result.file1_exists = info1.is_regular;
     if (result.file1_exists) {
-        long long size = get_file_size(filepath1);
-        if (size < 0) {
-            result.error_message_file1 = "Could not read size of '" + filepath1 + "'.";
-        } else {
-            result.file1_size = static_cast<unsigned long long>(size);
-            result.file1_hash = calculate_sha256(filepath1);
-            if (result.file1_hash.empty() && result.file1_size > 0) {
-                result.error_message_file1 = "Failed to calculate SHA256 hash for '" + filepath1 + "'.";
-            }
-        }
+        result.file1_size = info1.size;
     } else {
         result.error_message_file1 = "File not found or is not a regular file: " + filepath1;
     }
 
-    // Process File 2
-    result.file2_exists = is_regular_file(filepath2);
+    const FileInfo info2 = get_file_info(filepath2);
+    const bool size2_known = info2.is_regular;
+    result.file2_exists = info2.is_regular;
     if (result.file2_exists) {
-        long long size = get_file_size(filepath2);
-        if (size < 0) {
-            result.error_message_file2 = "Could not read size of '" + filepath2 + "'.";
-        } else {
-            result.file2_size = static_cast<unsigned long long>(size);
-            result.file2_hash = calculate_sha256(filepath2);
-            if (result.file2_hash.empty() && result.file2_size > 0) {
-                result.error_message_file2 = "Failed to calculate SHA256 hash for '" + filepath2 + "'.";
-            }
-        }
+        result.file2_size = info2.size;
     } else {
         result.error_message_file2 = "File not found or is not a regular file: " + filepath2;
     }
 
-    // Compare results
-    if (result.file1_exists && result.file2_exists) {
+    // Compare results. A size mismatch settles it from the stat alone. Equal sizes go straight
+    // to SHA-256: a fast digest of both files would read them end to end just the same, so as a
+    // prefilter it would only add a second full pass.
+    if (size1_known && size2_known) {
         result.sizes_match = (result.file1_size == result.file2_size);
-        bool hash1_ok = !result.file1_hash.empty() || result.file1_size == 0;
-        bool hash2_ok = !result.file2_hash.empty() || result.file2_size == 0;
-        if (hash1_ok && hash2_ok) {
-            result.hashes_match = (result.file1_hash == result.file2_hash);
+        if (!result.sizes_match) {
+            result.prefilter_rejected = true;
+        } else {
+            result.file1_hashed = calculate_sha256_digest(filepath1, result.file1_hash);
+            if (!result.file1_hashed) {
+                result.error_message_file1 = "Failed to calculate SHA256 hash for '" + filepath1 + "'.";
+            }
+            result.file2_hashed = calculate_sha256_digest(filepath2, result.file2_hash);
+            if (!result.file2_hashed) {
+                result.error_message_file2 = "Failed to calculate SHA256 hash for '" + filepath2 + "'.";
+            }
+            bytes_read += result.file1_size + result.file2_size;
+            if (result.file1_hashed && result.file2_hashed) {
+                result.hashes_match = (result.file1_hash == result.file2_hash);
+            }
         }
     }
     
-    log_event("COMPARE_BINARY", "Compared " + filepath1 + " with " + filepath2);
+    HistoryRecord record;
+    record.op = "COMPARE_BINARY";
+    record.input_path = filepath1;
+    record.output_path = filepath2;
+    timer.stamp(record, bytes_read, bytes_read > 0 ? HashService::io_backend_for(std::max(result.file1_size, result.file2_size))
+                                                   : IO_BACKEND_STAT);
+    if (result.file1_hashed) record.input_sha256 = result.file1_hash.to_hex();
+    if (result.file2_hashed) record.output_sha256 = result.file2_hash.to_hex();
+    record.details = "Compared " + filepath1 + " with " + filepath2;
+    log_event(std::move(record));
     return result;
 }
 
-std::string process_content_caesar(const std::string& content, int pegs, bool encrypt_mode) {
-    std::string processed_content = content;
+std::string process_content_caesar(std::string_view content, int pegs, bool encrypt_mode) {
+    std::string processed_content(content);
     for (char& c : processed_content) {
         unsigned char uc = static_cast<unsigned char>(c);
         if (encrypt_mode) {
@@ -1,9 +1,13 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <cstddef> // For size_t
 
+#include "hash_service.h"  // For Sha256Digest
+#include "history_index.h" // For HistoryRecord
+
 // --- Constants ---
 constexpr int MIN_PEG = 1;
 constexpr int MAX_PEG = 255;
@@ -31,24 +35,55 @@ struct ValidationFlags {
 inline constexpr ValidationFlags DEFAULT_ENCRYPT_DECRYPT_FLAGS = {true, true, true, true};
 inline constexpr ValidationFlags DEFAULT_DECRYPT_FLAGS_NO_INPUT_CHECK = {false, true, true, true};
 
+// Statistics only; compared content is never copied into the result
 struct TextCompareResult {
     bool files_readable = false;
-    std::string content1;
-    std::string content2;
+    size_t length1 = 0;
+    size_t length2 = 0;
+    size_t matching_chars = 0;
     float match_percentage = 0.0f;
     long first_diff_offset = -1;
     std::string error_message;
 };
 
+// Opt-in copy of the content around a compare result's first difference, for display
+struct TextCompareExcerpt {
+    size_t offset = 0; // Position in the compared content where both excerpts start
+    std::string content1;
+    std::string content2;
+};
+
+// One ENCRYPT entry recovered from the history log
+struct EncryptionRecord {
+    std::string input_file;
+    std::string output_file;
+    int pegs = 0;
+};
+
+// Result of one stat() of a path. Taken once per operation and handed to the validation,
+// processing and vault steps instead of each of them querying the filesystem again.
+struct FileInfo {
+    bool exists = false;
+    bool is_regular = false;
+    bool is_directory = false;
+    unsigned long long size = 0;
+    unsigned long long device = 0; // Together with 'inode', identifies the file (0 where unavailable)
+    unsigned long long inode = 0;
+    long long modified_ms = 0;     // Last modification, Unix epoch milliseconds
+};
+
 struct BinaryCompareResult {
     bool file1_exists = false;
     bool file2_exists = false;
     unsigned long long file1_size = 0;
     unsigned long long file2_size = 0;
-    std::string file1_hash;
-    std::string file2_hash;
+    Sha256Digest file1_hash;
+    Sha256Digest file2_hash;
+    bool file1_hashed = false;
+    bool file2_hashed = false;
     bool hashes_match = false;
     bool sizes_match = false;
+    bool prefilter_rejected = false; // Sizes differed, so SHA-256 was skipped
     std::string error_message_file1;
     std::string error_message_file2;
 };
@@ -57,11 +92,15 @@ struct BinaryCompareResult {
 
 // Publicly accessible Filesystem Helpers
 std::string path_join(const std::string& p1, const std::string& p2);
+FileInfo get_file_info(const std::string& path); // One stat(); 'exists' is false if the path cannot be queried
 bool is_regular_file(const std::string& path);
 bool is_directory(const std::string& path);
 bool create_directory(const std::string& path);
+bool write_all(int fd, const void* data, size_t length); // Retries short and interrupted writes
+bool replace_file(const std::string& from, const std::string& to); // Rename that overwrites 'to' everywhere
 std::string path_get_filename(const std::string& path);
 std::string path_get_parent(const std::string& path);
+std::vector<std::string> list_directory_files(const std::string& dir_path);
 
 // Validation Functions
 bool has_txt_extension(const std::string& filename);
@@ -75,11 +114,16 @@ bool validate_decryption_params(const OperationParams& params);
 bool encrypt_file(const std::string& input_file, int pegs);
 bool decrypt_file(const std::string& input_file, const std::string& output_file, int pegs);
 bool move_to_vault(const std::string& original_filepath);
-bool retrieve_from_vault(const std::string& filename_in_vault, const std::string& destination_path);
+// With 'keep_in_vault' false the entry is moved out (a rename where possible) and leaves the vault
+bool retrieve_from_vault(const std::string& filename_in_vault, const std::string& destination_path,
+                         bool keep_in_vault = true);
 
 // History and Logging
 void log_operation(const std::string& operation_type, const std::string& input_file, const std::string& output_file, int pegs);
+void log_operation(HistoryRecord record); // Same, with measurements/digests filled in by the caller
 void log_event(const std::string& event_type, const std::string& details);
+void log_event(HistoryRecord record);     // 'op' is the event type and 'details' its text
+std::vector<EncryptionRecord> load_encryption_records();
 
 // Admin/Security
 bool check_admin_password(const std::string& password_attempt);
@@ -89,6 +133,9 @@ bool ensure_private_vault_exists();
 TextCompareResult compare_text_files(const std::string& filepath1, const std::string& filepath2, size_t max_chars_to_load = 100000);
 BinaryCompareResult compare_binary_files(const std::string& filepath1, const std::string& filepath2);
 std::string calculate_sha256(const std::string& filepath);
-TextCompareResult compare_string_contents(const std::string& content1, const std::string& content2, const std::string& label1 = "Content 1", const std::string& label2 = "Content 2");
-std::string process_content_caesar(const std::string& content, int pegs, bool encrypt_mode);
+bool calculate_sha256_digest(const std::string& filepath, Sha256Digest& out_digest);
+bool calculate_fast_hash(const std::string& filepath, FastDigest& out_digest);
+TextCompareResult compare_string_contents(std::string_view content1, std::string_view content2, const std::string& label1 = "Content 1", const std::string& label2 = "Content 2");
+TextCompareExcerpt materialize_compare_excerpt(std::string_view content1, std::string_view content2, long long first_diff_offset, size_t max_chars);
+std::string process_content_caesar(std::string_view content, int pegs, bool encrypt_mode);
 std::string load_file_content_to_string(const std::string& filepath, size_t max_chars_to_load = 1000000);
\ No newline at end of file
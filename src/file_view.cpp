@@ -0,0 +1,121 @@
+#include "file_view.h"
+
+#include <utility>   // For std::exchange
+#include <algorithm> // For std::min
+
+// Platform-specific includes for memory mapping
+#if defined(_WIN32) || defined(_WIN64)
+    #include <windows.h>
+#else
+    #include <fcntl.h>    // For open
+    #include <unistd.h>   // For close
+    #include <sys/mman.h> // For mmap, munmap, madvise
+    #include <sys/stat.h> // For fstat
+#endif
+
+FileView::~FileView() noexcept {
+    close();
+}
+
+FileView::FileView(FileView&& other) noexcept
+    : data(std::exchange(other.data, nullptr)),
+      length(std::exchange(other.length, 0)),
+      opened(std::exchange(other.opened, false))
+#if defined(_WIN32) || defined(_WIN64)
+      , mapping_handle(std::exchange(other.mapping_handle, nullptr))
+#endif
+{}
+
+FileView& FileView::operator=(FileView&& other) noexcept {
+    if (this != &other) {
+        close();
+        data = std::exchange(other.data, nullptr);
+        length = std::exchange(other.length, 0);
+        opened = std::exchange(other.opened, false);
+#if defined(_WIN32) || defined(_WIN64)
+        mapping_handle = std::exchange(other.mapping_handle, nullptr);
+#endif
+    }
+    return *this;
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+bool FileView::open(const std::string& path, size_t max_bytes) {
+    close();
+    // Files such as the history log stay open for writing in this process for its whole lifetime
+    // (and may be renamed), so sharing only reads would fail every view of them
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        return false;
+    }
+    const size_t map_length = std::min(static_cast<size_t>(file_size.QuadPart), max_bytes);
+    if (map_length == 0) {
+        CloseHandle(file);
+        opened = true;
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file); // The mapping object keeps its own reference to the file
+    if (!mapping) return false;
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, map_length);
+    if (!view) {
+        CloseHandle(mapping);
+        return false;
+    }
+    data = view;
+    length = map_length;
+    mapping_handle = mapping;
+    opened = true;
+    return true;
+}
+
+void FileView::close() noexcept {
+    if (data) UnmapViewOfFile(data);
+    if (mapping_handle) CloseHandle(static_cast<HANDLE>(mapping_handle));
+    data = nullptr;
+    mapping_handle = nullptr;
+    length = 0;
+    opened = false;
+}
+#else // For macOS, Linux, etc.
+bool FileView::open(const std::string& path, size_t max_bytes) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+    const size_t map_length = std::min(static_cast<size_t>(info.st_size), max_bytes);
+    if (map_length == 0) {
+        ::close(fd);
+        opened = true;
+        return true;
+    }
+
+    void* view = mmap(nullptr, map_length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping stays valid after the descriptor is closed
+    if (view == MAP_FAILED) return false;
+    madvise(view, map_length, MADV_SEQUENTIAL);
+
+    data = view;
+    length = map_length;
+    opened = true;
+    return true;
+}
+
+void FileView::close() noexcept {
+    if (data) munmap(const_cast<void*>(data), length);
+    data = nullptr;
+    length = 0;
+    opened = false;
+}
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstddef> // For size_t
+
+// Read-only, memory-mapped view of a file. Lets comparisons work on file contents in place
+// instead of loading them into std::string copies. Move-only; the mapping is released on destruction.
+class FileView {
+public:
+    FileView() noexcept = default;
+    ~FileView() noexcept;
+
+    FileView(FileView&& other) noexcept;
+    FileView& operator=(FileView&& other) noexcept;
+
+    // Maps at most 'max_bytes' from the start of the file. Returns false if the file cannot be
+    // opened or mapped; an empty file succeeds with an empty view.
+    bool open(const std::string& path, size_t max_bytes = static_cast<size_t>(-1));
+    void close() noexcept;
+
+    std::string_view view() const noexcept { return {static_cast<const char*>(data), length}; }
+    const unsigned char* bytes() const noexcept { return static_cast<const unsigned char*>(data); }
+    size_t size() const noexcept { return length; }
+    bool is_open() const noexcept { return opened; }
+
+    // Disable copy operations to ensure single ownership of the mapping
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
+
+private:
+    const void* data = nullptr;
+    size_t length = 0;
+    bool opened = false;
+#if defined(_WIN32) || defined(_WIN64)
+    void* mapping_handle = nullptr; // HANDLE of the file mapping object
+#endif
+};
@@ -0,0 +1,429 @@
+#include "hash_service.h"
+#include "cipher_utils.h" // For log_event
+#include "op_metrics.h"   // For IO_BACKEND_*
+
+#include <fstream>
+#include <vector>
+#include <algorithm> // For std::min
+#include <cerrno>
+#include <cstring> // For std::memcpy
+
+// OpenSSL for SHA256 hashing
+#include <openssl/evp.h>
+#include <openssl/opensslv.h>
+
+// Platform-specific includes for raw file access
+#if defined(_WIN32) || defined(_WIN64)
+    // Windows builds stream through std::ifstream with a large buffer
+#else
+    #include <fcntl.h>    // For open, posix_fadvise
+    #include <unistd.h>   // For read, close
+    #include <sys/mman.h> // For mmap, munmap, madvise
+    #include <sys/stat.h> // For fstat
+#endif
+
+// --- Anonymous Namespace for INTERNAL (File-Local) Helper Functions ---
+namespace {
+
+    // Per-thread scratch state. The context is created lazily and reused for every
+    // digest computed on this thread, then released when the thread exits.
+    struct ThreadHashState {
+        EVP_MD_CTX* ctx = nullptr;
+        std::vector<unsigned char> read_buffer;
+
+        ~ThreadHashState() {
+            if (ctx) EVP_MD_CTX_free(ctx);
+        }
+    };
+
+    thread_local ThreadHashState t_hash_state;
+
+    EVP_MD_CTX* acquire_thread_context() {
+        if (!t_hash_state.ctx) {
+            t_hash_state.ctx = EVP_MD_CTX_new();
+        }
+        return t_hash_state.ctx;
+    }
+
+    unsigned char* acquire_thread_buffer(size_t size) {
+        if (t_hash_state.read_buffer.size() < size) {
+            t_hash_state.read_buffer.resize(size);
+        }
+        return t_hash_state.read_buffer.data();
+    }
+
+    bool finish_digest(EVP_MD_CTX* ctx, Sha256Digest& out_digest) {
+        unsigned int hash_len = 0;
+        if (1 != EVP_DigestFinal_ex(ctx, out_digest.bytes.data(), &hash_len)) return false;
+        return hash_len == Sha256Digest::SIZE;
+    }
+
+#if !defined(_WIN32) && !defined(_WIN64)
+    // RAII wrapper so every early return closes the descriptor
+    class ScopedFd {
+    public:
+        explicit ScopedFd(int fd) noexcept : fd(fd) {}
+        ~ScopedFd() { if (fd >= 0) ::close(fd); }
+        int get() const noexcept { return fd; }
+
+    private:
+        ScopedFd(const ScopedFd&) = delete;
+        ScopedFd& operator=(const ScopedFd&) = delete;
+
+        int fd;
+    };
+
+    // Reads until 'size' bytes are in 'buffer' or EOF is reached. Returns -1 on error.
+    ssize_t read_full(int fd, unsigned char* buffer, size_t size) {
+        size_t total = 0;
+        while (total < size) {
+            ssize_t n = ::read(fd, buffer + total, size - total);
+            if (n == 0) break;
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return -1;
+            }
+            total += static_cast<size_t>(n);
+        }
+        return static_cast<ssize_t>(total);
+    }
+#endif
+
+    constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+    // --- wyhash (final version 4) primitives ---
+    constexpr uint64_t WY_SECRET[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+                                       0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+    constexpr uint64_t FAST_HASH_SEED = 0x9e3779b97f4a7c15ull;
+
+    inline void wy_mum(uint64_t* a, uint64_t* b) noexcept {
+    #if defined(__SIZEOF_INT128__)
+        __uint128_t r = static_cast<__uint128_t>(*a) * *b;
+        *a = static_cast<uint64_t>(r);
+        *b = static_cast<uint64_t>(r >> 64);
+    #else
+        uint64_t ha = *a >> 32, hb = *b >> 32, la = static_cast<uint32_t>(*a), lb = static_cast<uint32_t>(*b);
+        uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32);
+        uint64_t c = t < rl;
+        uint64_t lo = t + (rm1 << 32);
+        c += lo < t;
+        uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+        *a = lo;
+        *b = hi;
+    #endif
+    }
+
+    inline uint64_t wy_mix(uint64_t a, uint64_t b) noexcept {
+        wy_mum(&a, &b);
+        return a ^ b;
+    }
+
+    inline uint64_t wy_read8(const unsigned char* p) noexcept { uint64_t v; std::memcpy(&v, p, 8); return v; }
+    inline uint64_t wy_read4(const unsigned char* p) noexcept { uint32_t v; std::memcpy(&v, p, 4); return v; }
+    inline uint64_t wy_read3(const unsigned char* p, size_t k) noexcept {
+        return (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[k >> 1]) << 8) | p[k - 1];
+    }
+
+    uint64_t wyhash(const unsigned char* p, size_t len, uint64_t seed) noexcept {
+        seed ^= wy_mix(seed ^ WY_SECRET[0], WY_SECRET[1]);
+        uint64_t a, b;
+        if (len <= 16) {
+            if (len >= 4) {
+                a = (wy_read4(p) << 32) | wy_read4(p + ((len >> 3) << 2));
+                b = (wy_read4(p + len - 4) << 32) | wy_read4(p + len - 4 - ((len >> 3) << 2));
+            } else if (len > 0) {
+                a = wy_read3(p, len);
+                b = 0;
+            } else {
+                a = b = 0;
+            }
+        } else {
+            size_t i = len;
+            if (i >= 48) {
+                uint64_t see1 = seed, see2 = seed;
+                do {
+                    seed = wy_mix(wy_read8(p) ^ WY_SECRET[1], wy_read8(p + 8) ^ seed);
+                    see1 = wy_mix(wy_read8(p + 16) ^ WY_SECRET[2], wy_read8(p + 24) ^ see1);
+                    see2 = wy_mix(wy_read8(p + 32) ^ WY_SECRET[3], wy_read8(p + 40) ^ see2);
+                    p += 48;
+                    i -= 48;
+                } while (i >= 48);
+                seed ^= see1 ^ see2;
+            }
+            while (i > 16) {
+                seed = wy_mix(wy_read8(p) ^ WY_SECRET[1], wy_read8(p + 8) ^ seed);
+                i -= 16;
+                p += 16;
+            }
+            a = wy_read8(p + i - 16);
+            b = wy_read8(p + i - 8);
+        }
+        a ^= WY_SECRET[1];
+        b ^= seed;
+        wy_mum(&a, &b);
+        return wy_mix(a ^ WY_SECRET[0] ^ len, b ^ WY_SECRET[1]);
+    }
+
+    // Folds the chained chunk state and the total length into the final digest
+    inline FastDigest finish_fast_hash(uint64_t state, uint64_t total_length) noexcept {
+        return wy_mix(state ^ WY_SECRET[2], total_length ^ WY_SECRET[3]);
+    }
+
+} // End anonymous namespace
+
+// --- Sha256Digest ---
+
+void Sha256Digest::write_hex(char* out) const noexcept {
+    for (size_t i = 0; i < SIZE; ++i) {
+        out[i * 2]     = HEX_DIGITS[bytes[i] >> 4];
+        out[i * 2 + 1] = HEX_DIGITS[bytes[i] & 0x0F];
+    }
+}
+
+std::string Sha256Digest::to_hex() const {
+    std::string hex(HEX_LENGTH, '\0');
+    write_hex(&hex[0]);
+    return hex;
+}
+
+// --- HashService ---
+
+HashService& HashService::instance() {
+    static HashService service;
+    return service;
+}
+
+HashService::HashService() noexcept
+    : sha256_md(nullptr),
+      owns_md(false)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    // Fetch the provider implementation once instead of resolving it on every call
+    sha256_md = EVP_MD_fetch(nullptr, "SHA256", nullptr);
+    owns_md = (sha256_md != nullptr);
+#endif
+    if (!sha256_md) {
+        sha256_md = EVP_sha256();
+    }
+}
+
+HashService::~HashService() noexcept {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    if (owns_md) {
+        EVP_MD_free(const_cast<EVP_MD*>(sha256_md));
+    }
+#endif
+}
+
+bool HashService::sha256_buffer(const void* data, size_t length, Sha256Digest& out_digest) {
+    EVP_MD_CTX* ctx = acquire_thread_context();
+    if (!ctx || !sha256_md) return false;
+    if (1 != EVP_DigestInit_ex(ctx, sha256_md, nullptr)) return false;
+    if (length > 0 && 1 != EVP_DigestUpdate(ctx, data, length)) return false;
+    return finish_digest(ctx, out_digest);
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+bool HashService::sha256_file(const std::string& filepath, Sha256Digest& out_digest) {
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file) {
+        log_event("HASH_ERROR", "Could not open file for hashing: " + filepath);
+        return false;
+    }
+
+    EVP_MD_CTX* ctx = acquire_thread_context();
+    if (!ctx || !sha256_md || 1 != EVP_DigestInit_ex(ctx, sha256_md, nullptr)) {
+        log_event("HASH_ERROR", "OpenSSL SHA256 setup failed for: " + filepath);
+        return false;
+    }
+
+    char* buffer = reinterpret_cast<char*>(acquire_thread_buffer(READ_BUFFER_SIZE));
+    while (file.read(buffer, READ_BUFFER_SIZE) || file.gcount() > 0) {
+        if (1 != EVP_DigestUpdate(ctx, buffer, static_cast<size_t>(file.gcount()))) {
+            log_event("HASH_ERROR", "EVP_DigestUpdate failed for: " + filepath);
+            return false;
+        }
+    }
+    if (file.bad()) {
+        log_event("HASH_ERROR", "File read error during hashing: " + filepath);
+        return false;
+    }
+    if (!finish_digest(ctx, out_digest)) {
+        log_event("HASH_ERROR", "EVP_DigestFinal_ex failed for: " + filepath);
+        return false;
+    }
+    return true;
+}
+#else // For macOS, Linux, etc.
+bool HashService::sha256_file(const std::string& filepath, Sha256Digest& out_digest) {
+    ScopedFd fd(::open(filepath.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd.get() < 0) {
+        log_event("HASH_ERROR", "Could not open file for hashing: " + filepath);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd.get(), &info) != 0 || !S_ISREG(info.st_mode)) {
+        log_event("HASH_ERROR", "Not a readable regular file: " + filepath);
+        return false;
+    }
+
+    EVP_MD_CTX* ctx = acquire_thread_context();
+    if (!ctx || !sha256_md || 1 != EVP_DigestInit_ex(ctx, sha256_md, nullptr)) {
+        log_event("HASH_ERROR", "OpenSSL SHA256 setup failed for: " + filepath);
+        return false;
+    }
+
+    const size_t file_size = static_cast<size_t>(info.st_size);
+    if (file_size >= MMAP_THRESHOLD) {
+        // Large files: hash straight out of the page cache without copying into user buffers
+        void* mapped = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+        if (mapped != MAP_FAILED) {
+            madvise(mapped, file_size, MADV_SEQUENTIAL);
+            bool ok = (1 == EVP_DigestUpdate(ctx, mapped, file_size));
+            munmap(mapped, file_size);
+            if (!ok) {
+                log_event("HASH_ERROR", "EVP_DigestUpdate failed for: " + filepath);
+                return false;
+            }
+            if (!finish_digest(ctx, out_digest)) {
+                log_event("HASH_ERROR", "EVP_DigestFinal_ex failed for: " + filepath);
+                return false;
+            }
+            return true;
+        }
+        // Mapping can fail on special filesystems; fall through to plain reads
+    }
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fd.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    unsigned char* buffer = acquire_thread_buffer(READ_BUFFER_SIZE);
+    for (;;) {
+        ssize_t bytes_read = ::read(fd.get(), buffer, READ_BUFFER_SIZE);
+        if (bytes_read == 0) break;
+        if (bytes_read < 0) {
+            if (errno == EINTR) continue;
+            log_event("HASH_ERROR", "File read error during hashing: " + filepath);
+            return false;
+        }
+        if (1 != EVP_DigestUpdate(ctx, buffer, static_cast<size_t>(bytes_read))) {
+            log_event("HASH_ERROR", "EVP_DigestUpdate failed for: " + filepath);
+            return false;
+        }
+    }
+    if (!finish_digest(ctx, out_digest)) {
+        log_event("HASH_ERROR", "EVP_DigestFinal_ex failed for: " + filepath);
+        return false;
+    }
+    return true;
+}
+#endif
+
+// --- Fast (non-cryptographic) Digest ---
+
+const char* HashService::io_backend_for(unsigned long long file_size) noexcept {
+#if defined(_WIN32) || defined(_WIN64)
+    (void)file_size;
+    return IO_BACKEND_STREAM;
+#else
+    return (file_size >= MMAP_THRESHOLD) ? IO_BACKEND_MMAP : IO_BACKEND_READ;
+#endif
+}
+
+FastDigest HashService::fast_hash_buffer(const void* data, size_t length) noexcept {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t state = FAST_HASH_SEED;
+    for (size_t offset = 0; offset < length; offset += FAST_HASH_CHUNK_SIZE) {
+        state = wyhash(p + offset, std::min(FAST_HASH_CHUNK_SIZE, length - offset), state);
+    }
+    return finish_fast_hash(state, length);
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+bool HashService::fast_hash_file(const std::string& filepath, FastDigest& out_digest) {
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file) {
+        log_event("HASH_ERROR", "Could not open file for fast hashing: " + filepath);
+        return false;
+    }
+    char* buffer = reinterpret_cast<char*>(acquire_thread_buffer(FAST_HASH_CHUNK_SIZE));
+    uint64_t state = FAST_HASH_SEED;
+    uint64_t total = 0;
+    while (file.read(buffer, FAST_HASH_CHUNK_SIZE) || file.gcount() > 0) {
+        size_t bytes_read = static_cast<size_t>(file.gcount());
+        state = wyhash(reinterpret_cast<const unsigned char*>(buffer), bytes_read, state);
+        total += bytes_read;
+    }
+    if (file.bad()) {
+        log_event("HASH_ERROR", "File read error during fast hashing: " + filepath);
+        return false;
+    }
+    out_digest = finish_fast_hash(state, total);
+    return true;
+}
+#else // For macOS, Linux, etc.
+bool HashService::fast_hash_file(const std::string& filepath, FastDigest& out_digest) {
+    ScopedFd fd(::open(filepath.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd.get() < 0) {
+        log_event("HASH_ERROR", "Could not open file for fast hashing: " + filepath);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd.get(), &info) != 0 || !S_ISREG(info.st_mode)) {
+        log_event("HASH_ERROR", "Not a readable regular file: " + filepath);
+        return false;
+    }
+
+    const size_t file_size = static_cast<size_t>(info.st_size);
+    if (file_size >= MMAP_THRESHOLD) {
+        void* mapped = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+        if (mapped != MAP_FAILED) {
+            madvise(mapped, file_size, MADV_SEQUENTIAL);
+            out_digest = fast_hash_buffer(mapped, file_size);
+            munmap(mapped, file_size);
+            return true;
+        }
+    }
+
+    unsigned char* buffer = acquire_thread_buffer(FAST_HASH_CHUNK_SIZE);
+    uint64_t state = FAST_HASH_SEED;
+    uint64_t total = 0;
+    for (;;) {
+        ssize_t bytes_read = read_full(fd.get(), buffer, FAST_HASH_CHUNK_SIZE);
+        if (bytes_read < 0) {
+            log_event("HASH_ERROR", "File read error during fast hashing: " + filepath);
+            return false;
+        }
+        if (bytes_read == 0) break;
+        state = wyhash(buffer, static_cast<size_t>(bytes_read), state);
+        total += static_cast<uint64_t>(bytes_read);
+        if (static_cast<size_t>(bytes_read) < FAST_HASH_CHUNK_SIZE) break;
+    }
+    out_digest = finish_fast_hash(state, total);
+    return true;
+}
+#endif
+
+// --- Sha256Stream ---
+
+Sha256Stream::Sha256Stream() noexcept
+    : ctx(EVP_MD_CTX_new()),
+      ok(false)
+{
+    const EVP_MD* md = HashService::instance().sha256_md;
+    ok = ctx && md && 1 == EVP_DigestInit_ex(ctx, md, nullptr);
+}
+
+Sha256Stream::~Sha256Stream() noexcept {
+    if (ctx) EVP_MD_CTX_free(ctx);
+}
+
+void Sha256Stream::update(const void* data, size_t length) noexcept {
+    if (ok && length > 0) ok = (1 == EVP_DigestUpdate(ctx, data, length));
+}
+
+bool Sha256Stream::finish(Sha256Digest& out_digest) noexcept {
+    if (!ok) return false;
+    ok = false;
+    return finish_digest(ctx, out_digest);
+}
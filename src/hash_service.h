@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <cstddef> // For size_t
+#include <cstdint> // For uint64_t
+
+// Forward-declare the OpenSSL digest types to keep <openssl/evp.h> out of this header
+struct evp_md_st;
+struct evp_md_ctx_st;
+
+// --- Structures ---
+
+// Fixed-size SHA-256 digest. Passed around by value instead of a heap-allocated hex string.
+struct Sha256Digest {
+    static constexpr size_t SIZE = 32;
+    static constexpr size_t HEX_LENGTH = SIZE * 2;
+
+    std::array<unsigned char, SIZE> bytes{};
+
+    // Writes exactly HEX_LENGTH lowercase hex characters (no terminator) to 'out'
+    void write_hex(char* out) const noexcept;
+    std::string to_hex() const;
+
+    bool operator==(const Sha256Digest& other) const noexcept { return bytes == other.bytes; }
+    bool operator!=(const Sha256Digest& other) const noexcept { return bytes != other.bytes; }
+};
+
+// Non-cryptographic 64-bit digest (wyhash) used as a cheap first-stage filter for
+// change detection and duplicate search. Equal values still need SHA-256 confirmation.
+using FastDigest = std::uint64_t;
+
+// Long-lived SHA-256 service. The digest implementation is fetched once at startup,
+// and every thread reuses its own EVP_MD_CTX and read buffer across calls.
+class HashService {
+public:
+    // Returns the process-wide instance (created on first use)
+    static HashService& instance();
+
+    // Hashes a whole file. Returns false (and logs a HASH_ERROR event) on failure.
+    bool sha256_file(const std::string& filepath, Sha256Digest& out_digest);
+
+    // Hashes an in-memory buffer
+    bool sha256_buffer(const void* data, size_t length, Sha256Digest& out_digest);
+
+    // Fast non-cryptographic digest of a whole file or buffer. The input is processed in
+    // FAST_HASH_CHUNK_SIZE pieces so file and buffer results are always identical.
+    bool fast_hash_file(const std::string& filepath, FastDigest& out_digest);
+    static FastDigest fast_hash_buffer(const void* data, size_t length) noexcept;
+
+    // I/O backend the file functions above use for a file of 'file_size' bytes (see op_metrics.h)
+    static const char* io_backend_for(unsigned long long file_size) noexcept;
+
+    // Disable copy and move operations; there is exactly one service
+    HashService(const HashService&) = delete;
+    HashService& operator=(const HashService&) = delete;
+    HashService(HashService&&) = delete;
+    HashService& operator=(HashService&&) = delete;
+
+private:
+    friend class Sha256Stream;
+
+    HashService() noexcept;
+    ~HashService() noexcept;
+
+    const evp_md_st* sha256_md;
+    bool owns_md; // True when the digest was fetched explicitly and must be released
+
+    // --- Tuning Constants ---
+    inline static constexpr size_t READ_BUFFER_SIZE = 256 * 1024;  // Per-thread read buffer
+    inline static constexpr size_t MMAP_THRESHOLD   = 1024 * 1024; // Files at least this big are mapped
+    inline static constexpr size_t FAST_HASH_CHUNK_SIZE = READ_BUFFER_SIZE; // Part of the digest definition
+};
+
+// Incremental SHA-256 for data that is already passing through the caller (e.g. a file being
+// encrypted), so it does not have to be read a second time. Owns its own context.
+class Sha256Stream {
+public:
+    Sha256Stream() noexcept;
+    ~Sha256Stream() noexcept;
+
+    void update(const void* data, size_t length) noexcept;
+    // False if any step failed; the stream cannot be used afterwards
+    bool finish(Sha256Digest& out_digest) noexcept;
+
+    // Disable copy and move operations to ensure single ownership of the context
+    Sha256Stream(const Sha256Stream&) = delete;
+    Sha256Stream& operator=(const Sha256Stream&) = delete;
+    Sha256Stream(Sha256Stream&&) = delete;
+    Sha256Stream& operator=(Sha256Stream&&) = delete;
+
+private:
+    evp_md_ctx_st* ctx;
+    bool ok;
+};
@@ -0,0 +1,419 @@
+#include "history_index.h"
+#include "history_log.h"  // For HistoryLogger::flush
+#include "hash_service.h" // For HashService::fast_hash_buffer
+#include "file_view.h"
+
+#include <algorithm>
+#include <cctype>  // For std::isdigit
+#include <cstdio>  // For std::sscanf, std::snprintf
+#include <cstdlib> // For std::strtod, std::strtoll, std::strtoull
+#include <cstring> // For std::memcmp
+#include <ctime>
+#include <sstream>
+#include <iomanip>
+
+// --- Definitions for Global Constants ---
+const std::string HISTORY_LOG_FILE = "history.jsonl";
+const std::string HISTORY_TIME_INDEX_FILE = "history.jsonl.tidx";
+const std::string HISTORY_PATH_INDEX_FILE = "history.jsonl.pidx";
+
+// --- Anonymous Namespace for INTERNAL (File-Local) Helper Functions ---
+namespace {
+
+    void append_json_string(std::string& out, std::string_view value) {
+        static const char HEX[] = "0123456789abcdef";
+        out += '"';
+        for (char c : value) {
+            const unsigned char uc = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (uc < 0x20) {
+                out += "\\u00";
+                out += HEX[uc >> 4];
+                out += HEX[uc & 0xF];
+            } else {
+                out += c; // Other bytes are copied verbatim; paths need not be valid UTF-8
+            }
+        }
+        out += '"';
+    }
+
+    void append_json_field(std::string& out, const char* key, std::string_view value) {
+        out += '"';
+        out += key;
+        out += "\":";
+        append_json_string(out, value);
+    }
+
+    void append_json_field(std::string& out, const char* key, unsigned long long value) {
+        out += '"';
+        out += key;
+        out += "\":";
+        out += std::to_string(value);
+    }
+
+    // Two decimals are plenty for a rate and keep the line short
+    void append_json_decimal(std::string& out, double value) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.2f", value);
+        out += buffer;
+    }
+
+    // Minimal reader for the flat objects written above (string and number values only)
+    class JsonLineReader {
+    public:
+        explicit JsonLineReader(std::string_view line) : text(line) {}
+
+        bool expect(char c) {
+            skip_space();
+            if (pos >= text.size() || text[pos] != c) return false;
+            ++pos;
+            return true;
+        }
+        bool peek(char c) {
+            skip_space();
+            return pos < text.size() && text[pos] == c;
+        }
+        bool read_string(std::string& out) {
+            out.clear();
+            if (!expect('"')) return false;
+            while (pos < text.size()) {
+                char c = text[pos++];
+                if (c == '"') return true;
+                if (c != '\\') { out += c; continue; }
+                if (pos >= text.size()) return false;
+                char esc = text[pos++];
+                switch (esc) {
+                    case 'n': out += '\n'; break;
+                    case 't': out += '\t'; break;
+                    case 'r': out += '\r'; break;
+                    case 'u': {
+                        if (pos + 4 > text.size()) return false;
+                        unsigned value = 0;
+                        for (int i = 0; i < 4; ++i) {
+                            char h = text[pos++];
+                            value <<= 4;
+                            if (h >= '0' && h <= '9') value |= static_cast<unsigned>(h - '0');
+                            else if (h >= 'a' && h <= 'f') value |= static_cast<unsigned>(h - 'a' + 10);
+                            else if (h >= 'A' && h <= 'F') value |= static_cast<unsigned>(h - 'A' + 10);
+                            else return false;
+                        }
+                        out += static_cast<char>(value & 0xFF); // The writer only escapes control bytes
+                        break;
+                    }
+                    default: out += esc; break;
+                }
+            }
+            return false;
+        }
+        // Returns the raw number token (digits, sign, decimal point, exponent)
+        bool read_number(std::string_view& token) {
+            skip_space();
+            size_t begin = pos;
+            while (pos < text.size() && (std::isdigit(static_cast<unsigned char>(text[pos])) ||
+                   text[pos] == '-' || text[pos] == '+' || text[pos] == '.' || text[pos] == 'e' || text[pos] == 'E')) {
+                ++pos;
+            }
+            token = text.substr(begin, pos - begin);
+            return !token.empty();
+        }
+
+    private:
+        void skip_space() {
+            while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r')) ++pos;
+        }
+
+        std::string_view text;
+        size_t pos = 0;
+    };
+
+    unsigned long long parse_unsigned(std::string_view token) {
+        return std::strtoull(std::string(token).c_str(), nullptr, 10);
+    }
+
+    std::string_view bare_filename(std::string_view path) {
+        size_t pos = path.find_last_of("/\\");
+        return (pos != std::string_view::npos) ? path.substr(pos + 1) : path;
+    }
+
+    bool record_matches_path(const HistoryRecord& record, std::string_view path) {
+        return record.input_path == path || record.output_path == path ||
+               (!record.input_path.empty() && bare_filename(record.input_path) == path) ||
+               (!record.output_path.empty() && bare_filename(record.output_path) == path);
+    }
+
+    // Returns the line starting at 'offset' (without its '\n'), or an empty view if out of range
+    std::string_view line_at(std::string_view log, unsigned long long offset) {
+        if (offset >= log.size()) return {};
+        size_t begin = static_cast<size_t>(offset);
+        size_t end = log.find('\n', begin);
+        if (end == std::string_view::npos) return {}; // Partially written trailing line
+        return log.substr(begin, end - begin);
+    }
+
+    bool needs_json_escape(std::string_view text) {
+        for (char c : text) {
+            if (c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20) return true;
+        }
+        return false;
+    }
+
+} // End anonymous namespace
+
+// --- Record Encoding ---
+
+void append_history_record_json(const HistoryRecord& record, std::string& out) {
+    out += "{\"ts\":";
+    out += std::to_string(record.timestamp_ms);
+    out += ',';
+    append_json_field(out, "op", record.op);
+    out += ',';
+    append_json_field(out, "in", record.input_path);
+    out += ',';
+    append_json_field(out, "out", record.output_path);
+    out += ",\"pegs\":";
+    out += std::to_string(record.pegs);
+    out += ',';
+    append_json_field(out, "bytes", record.bytes);
+    out += ',';
+    append_json_field(out, "dur_us", record.duration_us);
+    out += ',';
+    append_json_field(out, "cpu_us", record.cpu_us);
+    out += ",\"mb_s\":";
+    append_json_decimal(out, record.throughput_mb_s);
+    out += ',';
+    append_json_field(out, "io", record.io_backend);
+    out += ',';
+    append_json_field(out, "in_sha256", record.input_sha256);
+    out += ',';
+    append_json_field(out, "out_sha256", record.output_sha256);
+    out += ',';
+    append_json_field(out, "details", record.details);
+    out += "}\n";
+}
+
+bool parse_history_record_json(std::string_view line, HistoryRecord& out_record) {
+    out_record = HistoryRecord{};
+    JsonLineReader reader(line);
+    if (!reader.expect('{')) return false;
+    if (reader.peek('}')) return false; // Every record has at least an op
+
+    std::string key;
+    std::string string_value;
+    std::string_view number;
+    do {
+        if (!reader.read_string(key) || !reader.expect(':')) return false;
+        if (reader.peek('"')) {
+            if (!reader.read_string(string_value)) return false;
+            if (key == "op") out_record.op = std::move(string_value);
+            else if (key == "in") out_record.input_path = std::move(string_value);
+            else if (key == "out") out_record.output_path = std::move(string_value);
+            else if (key == "in_sha256") out_record.input_sha256 = std::move(string_value);
+            else if (key == "out_sha256") out_record.output_sha256 = std::move(string_value);
+            else if (key == "details") out_record.details = std::move(string_value);
+            else if (key == "io") out_record.io_backend = std::move(string_value);
+        } else {
+            if (!reader.read_number(number)) return false;
+            if (key == "ts") out_record.timestamp_ms = std::strtoll(std::string(number).c_str(), nullptr, 10);
+            else if (key == "pegs") out_record.pegs = static_cast<int>(std::strtol(std::string(number).c_str(), nullptr, 10));
+            else if (key == "bytes") out_record.bytes = parse_unsigned(number);
+            else if (key == "dur_us") out_record.duration_us = parse_unsigned(number);
+            else if (key == "cpu_us") out_record.cpu_us = parse_unsigned(number);
+            else if (key == "mb_s") out_record.throughput_mb_s = std::strtod(std::string(number).c_str(), nullptr);
+        }
+    } while (reader.expect(','));
+    return reader.expect('}') && !out_record.op.empty();
+}
+
+unsigned long long history_path_key(std::string_view path) {
+    return HashService::fast_hash_buffer(path.data(), path.size());
+}
+
+size_t history_record_path_keys(const HistoryRecord& record, unsigned long long (&keys)[4]) {
+    size_t count = 0;
+    auto add = [&](std::string_view path) {
+        if (path.empty()) return;
+        unsigned long long key = history_path_key(path);
+        for (size_t i = 0; i < count; ++i) {
+            if (keys[i] == key) return;
+        }
+        keys[count++] = key;
+    };
+    add(record.input_path);
+    add(bare_filename(record.input_path));
+    add(record.output_path);
+    add(bare_filename(record.output_path));
+    return count;
+}
+
+// --- Timestamps ---
+
+std::string format_history_timestamp(long long timestamp_ms) {
+    std::time_t seconds = static_cast<std::time_t>(timestamp_ms / 1000);
+    std::tm tm_obj{};
+#if defined(_WIN32) || defined(_WIN64)
+    localtime_s(&tm_obj, &seconds);
+#else
+    localtime_r(&seconds, &tm_obj);
+#endif
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm_obj);
+    return buffer;
+}
+
+bool parse_history_timestamp(const std::string& text, long long& out_timestamp_ms) {
+    std::tm tm_obj{};
+    int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+    int fields = std::sscanf(text.c_str(), "%d-%d-%d %d:%d:%d", &year, &month, &day, &hour, &minute, &second);
+    if (fields != 3 && fields != 6) return false;
+    tm_obj.tm_year = year - 1900;
+    tm_obj.tm_mon = month - 1;
+    tm_obj.tm_mday = day;
+    tm_obj.tm_hour = hour;
+    tm_obj.tm_min = minute;
+    tm_obj.tm_sec = second;
+    tm_obj.tm_isdst = -1;
+    std::time_t seconds = std::mktime(&tm_obj);
+    if (seconds == static_cast<std::time_t>(-1)) return false;
+    out_timestamp_ms = static_cast<long long>(seconds) * 1000;
+    return true;
+}
+
+// --- Queries ---
+
+std::vector<HistoryRecord> find_history_by_path(const std::string& path, size_t max_results) {
+    std::vector<HistoryRecord> results;
+    HistoryLogger::instance().flush_structured();
+
+    FileView index;
+    FileView log;
+    index.open(HISTORY_PATH_INDEX_FILE); // Open the index first: the log only ever grows past it
+    if (!log.open(HISTORY_LOG_FILE) || path.empty()) return results;
+    const std::string_view log_text = log.view();
+
+    // Indexed part: binary search the sorted (key, offset) entries
+    unsigned long long covered = 0;
+    std::vector<unsigned long long> offsets;
+    HistoryPathIndexHeader header{};
+    if (index.size() >= sizeof(header)) {
+        std::memcpy(&header, index.bytes(), sizeof(header));
+        const size_t available = (index.size() - sizeof(header)) / sizeof(HistoryPathIndexEntry);
+        if (std::memcmp(header.magic, HISTORY_PATH_INDEX_MAGIC, sizeof(header.magic)) == 0 && header.entry_count <= available) {
+            covered = std::min<unsigned long long>(header.covered_offset, log_text.size());
+            const auto* entries = reinterpret_cast<const HistoryPathIndexEntry*>(index.bytes() + sizeof(header));
+            const auto* entries_end = entries + header.entry_count;
+            const unsigned long long key = history_path_key(path);
+            auto range = std::equal_range(entries, entries_end, HistoryPathIndexEntry{key, 0},
+                [](const HistoryPathIndexEntry& a, const HistoryPathIndexEntry& b) { return a.path_key < b.path_key; });
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->offset < covered) offsets.push_back(it->offset);
+            }
+            std::sort(offsets.begin(), offsets.end());
+            offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+        }
+    }
+
+    HistoryRecord record;
+    for (unsigned long long offset : offsets) {
+        if (results.size() >= max_results) return results;
+        if (parse_history_record_json(line_at(log_text, offset), record) && record_matches_path(record, path)) {
+            results.push_back(std::move(record));
+        }
+    }
+
+    // Unindexed tail: scan lines, skipping those that cannot contain the filename
+    const std::string_view name = bare_filename(path);
+    const bool can_prefilter = !name.empty() && !needs_json_escape(name);
+    size_t pos = static_cast<size_t>(covered);
+    while (pos < log_text.size() && results.size() < max_results) {
+        size_t end = log_text.find('\n', pos);
+        if (end == std::string_view::npos) break;
+        std::string_view line = log_text.substr(pos, end - pos);
+        pos = end + 1;
+        if (can_prefilter && line.find(name) == std::string_view::npos) continue;
+        if (parse_history_record_json(line, record) && record_matches_path(record, path)) {
+            results.push_back(std::move(record));
+        }
+    }
+    return results;
+}
+
+std::vector<HistoryRecord> find_history_by_time(long long from_ms, long long to_ms, size_t max_results) {
+    std::vector<HistoryRecord> results;
+    HistoryLogger::instance().flush_structured();
+
+    FileView index;
+    FileView log;
+    if (!index.open(HISTORY_TIME_INDEX_FILE) || !log.open(HISTORY_LOG_FILE)) return results;
+    const size_t magic_size = sizeof(HISTORY_TIME_INDEX_MAGIC);
+    if (index.size() < magic_size || std::memcmp(index.bytes(), HISTORY_TIME_INDEX_MAGIC, magic_size) != 0) {
+        return results;
+    }
+    const auto* entries = reinterpret_cast<const HistoryTimeIndexEntry*>(index.bytes() + magic_size);
+    const auto* entries_end = entries + (index.size() - magic_size) / sizeof(HistoryTimeIndexEntry);
+
+    auto it = std::lower_bound(entries, entries_end, from_ms,
+        [](const HistoryTimeIndexEntry& entry, long long value) { return entry.timestamp_ms < value; });
+    HistoryRecord record;
+    for (; it != entries_end && it->timestamp_ms <= to_ms && results.size() < max_results; ++it) {
+        if (parse_history_record_json(line_at(log.view(), it->offset), record) &&
+            record.timestamp_ms >= from_ms && record.timestamp_ms <= to_ms) {
+            results.push_back(std::move(record));
+        }
+    }
+    return results;
+}
+
+std::vector<HistoryRecord> load_history_records_by_op(const std::string& op) {
+    std::vector<HistoryRecord> results;
+    HistoryLogger::instance().flush_structured();
+
+    FileView log;
+    if (!log.open(HISTORY_LOG_FILE)) return results;
+    const std::string_view log_text = log.view();
+
+    // Jump between occurrences of the op field instead of parsing every line
+    std::string needle;
+    append_json_field(needle, "op", op);
+    HistoryRecord record;
+    size_t pos = 0;
+    while ((pos = log_text.find(needle, pos)) != std::string_view::npos) {
+        size_t begin = log_text.rfind('\n', pos);
+        begin = (begin == std::string_view::npos) ? 0 : begin + 1;
+        size_t end = log_text.find('\n', pos);
+        if (end == std::string_view::npos) break;
+        if (parse_history_record_json(log_text.substr(begin, end - begin), record) && record.op == op) {
+            results.push_back(std::move(record));
+        }
+        pos = end + 1;
+    }
+    return results;
+}
+
+std::string describe_history_record(const HistoryRecord& record) {
+    std::ostringstream text;
+    text << format_history_timestamp(record.timestamp_ms) << " | " << record.op;
+    if (!record.input_path.empty() || !record.output_path.empty()) {
+        text << ": " << record.input_path << " -> " << record.output_path << " (pegs: " << record.pegs << ")";
+    }
+    if (record.bytes > 0) {
+        text << ", " << record.bytes << " bytes";
+    }
+    if (record.duration_us > 0) {
+        text << ", " << std::fixed << std::setprecision(2) << (static_cast<double>(record.duration_us) / 1000.0) << " ms";
+        if (record.cpu_us > 0) {
+            text << " (CPU " << (static_cast<double>(record.cpu_us) / 1000.0) << " ms)";
+        }
+    }
+    if (record.throughput_mb_s > 0.0) {
+        text << ", " << std::fixed << std::setprecision(2) << record.throughput_mb_s << " MB/s";
+    }
+    if (!record.io_backend.empty()) {
+        text << " [" << record.io_backend << "]";
+    }
+    if (!record.details.empty()) {
+        text << " - " << record.details;
+    }
+    return text.str();
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef> // For size_t
+
+// --- Files ---
+// Append-only structured log (one JSON object per line) plus two binary sidecar indexes.
+// All three are written only by the HistoryLogger writer thread.
+extern const std::string HISTORY_LOG_FILE;        // history.jsonl
+extern const std::string HISTORY_TIME_INDEX_FILE; // history.jsonl.tidx
+extern const std::string HISTORY_PATH_INDEX_FILE; // history.jsonl.pidx
+
+// --- Structures ---
+
+// One structured history entry. Unknown values stay zero/empty and are still written,
+// so every line carries the same fixed set of fields.
+struct HistoryRecord {
+    long long timestamp_ms = 0;          // Unix epoch milliseconds (set by the writer)
+    std::string op;                      // ENCRYPT, DECRYPT, or an event type such as VAULT_STORE
+    std::string input_path;
+    std::string output_path;
+    int pegs = 0;
+    unsigned long long bytes = 0;        // Bytes processed by the operation
+    unsigned long long duration_us = 0;  // Wall time of the operation (monotonic clock)
+    unsigned long long cpu_us = 0;       // CPU time of the thread that ran it
+    double throughput_mb_s = 0.0;        // bytes / duration_us
+    std::string io_backend;              // How the data was read: stream, read, mmap, ...
+    std::string input_sha256;            // Lowercase hex; empty when not computed
+    std::string output_sha256;
+    std::string details;                 // Free-form text (events)
+};
+
+// On-disk time index: an 8-byte magic followed by entries in append order.
+// 'timestamp_ms' is clamped to be non-decreasing so the file can be binary searched.
+struct HistoryTimeIndexEntry {
+    long long timestamp_ms;
+    unsigned long long offset; // Byte offset of the record's line in HISTORY_LOG_FILE
+};
+
+// On-disk path index: a header followed by entries sorted by (path_key, offset). Records
+// past 'covered_offset' are not indexed yet and are found by scanning the log tail; the
+// writer merges them in once enough accumulate.
+struct HistoryPathIndexHeader {
+    char magic[8];
+    unsigned long long covered_offset;
+    unsigned long long entry_count;
+};
+
+struct HistoryPathIndexEntry {
+    unsigned long long path_key;
+    unsigned long long offset;
+};
+
+inline constexpr char HISTORY_TIME_INDEX_MAGIC[8] = {'C', 'G', 'H', 'T', 'I', 'X', '1', '\0'};
+inline constexpr char HISTORY_PATH_INDEX_MAGIC[8] = {'C', 'G', 'H', 'P', 'I', 'X', '1', '\0'};
+
+// --- Record Encoding ---
+
+// Appends 'record' as one JSON line (including the trailing '\n') to 'out'
+void append_history_record_json(const HistoryRecord& record, std::string& out);
+
+// Parses one line produced by append_history_record_json. Returns false for malformed lines.
+bool parse_history_record_json(std::string_view line, HistoryRecord& out_record);
+
+// Keys under which a record is reachable in the path index: the full input and output
+// paths and their bare filenames. Returns the number of distinct keys written to 'keys'.
+size_t history_record_path_keys(const HistoryRecord& record, unsigned long long (&keys)[4]);
+unsigned long long history_path_key(std::string_view path);
+
+// Local-time conversion helpers ("YYYY-MM-DD HH:MM:SS"; the time part is optional when parsing)
+std::string format_history_timestamp(long long timestamp_ms);
+bool parse_history_timestamp(const std::string& text, long long& out_timestamp_ms);
+
+// --- Queries ---
+// Each query flushes the in-process logger first, so records logged just before are visible.
+
+// Records whose input or output path (or its bare filename) equals 'path', oldest first
+std::vector<HistoryRecord> find_history_by_path(const std::string& path, size_t max_results = 1000);
+
+// Records with from_ms <= timestamp <= to_ms, oldest first
+std::vector<HistoryRecord> find_history_by_time(long long from_ms, long long to_ms, size_t max_results = 1000);
+
+// Every record with the given op type, oldest first (full scan of the structured log)
+std::vector<HistoryRecord> load_history_records_by_op(const std::string& op);
+
+// One-line human-readable summary of a record, for the GUI and CLI
+std::string describe_history_record(const HistoryRecord& record);
@@ -0,0 +1,601 @@
+#include "history_log.h"
+#include "cipher_utils.h" // For HISTORY_FILE, MIN_PEG, MAX_PEG
+#include "file_view.h"
+
+#include <algorithm>
+#include <cstdio>  // For std::remove
+#include <cstdlib> // For std::atoi
+#include <cstring> // For std::memcpy, std::memcmp
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <ctime>
+
+// Platform-specific includes for the persistent file handle
+#if defined(_WIN32) || defined(_WIN64)
+    #include <io.h>       // For _open, _write, _commit, _close, _lseeki64
+    #include <fcntl.h>    // For _O_* flags
+    #include <sys/stat.h> // For _S_IREAD, _S_IWRITE
+#else
+    #include <fcntl.h>    // For open
+    #include <unistd.h>   // For write, fsync, close, lseek
+    #include <cerrno>
+#endif
+
+// --- Anonymous Namespace for INTERNAL (File-Local) Helper Functions ---
+namespace {
+
+#if defined(_WIN32) || defined(_WIN64)
+    int open_append(const std::string& path) {
+        return _open(path.c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+    }
+    int open_truncate(const std::string& path) {
+        return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+    }
+    unsigned long long file_end(int fd) {
+        long long end = _lseeki64(fd, 0, SEEK_END);
+        return end < 0 ? 0 : static_cast<unsigned long long>(end);
+    }
+    void sync_file(int fd) { _commit(fd); }
+    void close_file(int fd) { _close(fd); }
+#else // For macOS, Linux, etc.
+    int open_append(const std::string& path) {
+        return ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    }
+    int open_truncate(const std::string& path) {
+        return ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    }
+    unsigned long long file_end(int fd) {
+        off_t end = ::lseek(fd, 0, SEEK_END);
+        return end < 0 ? 0 : static_cast<unsigned long long>(end);
+    }
+    void sync_file(int fd) { ::fsync(fd); }
+    void close_file(int fd) { ::close(fd); }
+#endif
+
+    bool write_all(int fd, const std::string& data) {
+        return ::write_all(fd, data.data(), data.size());
+    }
+
+    template <typename T>
+    void append_raw(std::string& out, const T& value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    // Converts one legacy "YYYY-MM-DD HH:MM:SS | message" line of HISTORY_FILE into a record
+    bool parse_legacy_history_line(const std::string& line, HistoryRecord& record) {
+        const std::string separator = " | ";
+        size_t sep_pos = line.find(separator);
+        if (sep_pos == std::string::npos) return false;
+        record = HistoryRecord{};
+        if (!parse_history_timestamp(line.substr(0, sep_pos), record.timestamp_ms)) return false;
+        const std::string message = line.substr(sep_pos + separator.size());
+
+        // "EVENT (TYPE): details"
+        const std::string event_marker = "EVENT (";
+        if (message.rfind(event_marker, 0) == 0) {
+            size_t close_pos = message.find("): ");
+            if (close_pos == std::string::npos) return false;
+            record.op = message.substr(event_marker.size(), close_pos - event_marker.size());
+            record.details = message.substr(close_pos + 3);
+            return !record.op.empty();
+        }
+
+        // "OP: input -> output (pegs: N)"
+        size_t colon_pos = message.find(": ");
+        size_t arrow_pos = message.find(" -> ");
+        size_t pegs_pos = message.rfind(" (pegs: ");
+        if (colon_pos == std::string::npos || arrow_pos == std::string::npos || pegs_pos == std::string::npos ||
+            arrow_pos < colon_pos || pegs_pos < arrow_pos) {
+            record.op = "NOTE";
+            record.details = message;
+            return true;
+        }
+        record.op = message.substr(0, colon_pos);
+        record.input_path = message.substr(colon_pos + 2, arrow_pos - colon_pos - 2);
+        record.output_path = message.substr(arrow_pos + 4, pegs_pos - arrow_pos - 4);
+        record.pegs = std::atoi(message.c_str() + pegs_pos + 8);
+        return true;
+    }
+
+} // End anonymous namespace
+
+// --- HistoryLogger ---
+
+HistoryLogger& HistoryLogger::instance() {
+    static HistoryLogger logger;
+    return logger;
+}
+
+HistoryLogger::HistoryLogger()
+    : last_sync(std::chrono::steady_clock::now())
+{
+    open_active_segment();
+    if (file_handle < 0) {
+        std::cerr << "Warning: Could not open history file '" << HISTORY_FILE << "' for logging.\n";
+    }
+    legacy_history_bytes = active_bytes;
+    // Recovery can take a while (a first start imports the whole legacy history), so it runs on
+    // its own thread and the text log is written meanwhile; the writer takes the structured log
+    // over once it finishes
+    recovery = std::thread([this] {
+        open_structured_log();
+        {
+            std::lock_guard<std::mutex> stats_lock(stats_mutex);
+            stats_ready = true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+            structured_recovered = true;
+        }
+        wake_cv.notify_one();
+    });
+    writer = std::thread(&HistoryLogger::writer_loop, this);
+}
+
+HistoryLogger::~HistoryLogger() {
+    if (recovery.joinable()) recovery.join(); // The writer then hands over held-back records before it stops
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        stopping = true;
+    }
+    wake_cv.notify_one();
+    if (writer.joinable()) writer.join();
+    archiver.reset(); // Stops the compressor; unfinished segments are resumed on the next start
+    save_stats_if_due(true);
+    for (int fd : {file_handle, log_handle, time_index_handle}) {
+        if (fd < 0) continue;
+        if (writer_config.fsync_policy != FsyncPolicy::Never) sync_file(fd);
+        close_file(fd);
+    }
+}
+
+void HistoryLogger::configure(const HistoryLoggerConfig& new_config) {
+    std::lock_guard<std::mutex> lock(wake_mutex);
+    config = new_config;
+}
+
+void HistoryLogger::append(std::string message) {
+    push(new Node{std::chrono::system_clock::now(), std::move(message), std::nullopt, nullptr});
+}
+
+void HistoryLogger::append(std::string message, HistoryRecord record) {
+    push(new Node{std::chrono::system_clock::now(), std::move(message), std::move(record), nullptr});
+}
+
+void HistoryLogger::push(Node* node) {
+    node->next = queue_head.load(std::memory_order_relaxed);
+    while (!queue_head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+        // 'node->next' was refreshed by the failed exchange; retry
+    }
+    enqueued_count.fetch_add(1, std::memory_order_release);
+}
+
+void HistoryLogger::flush() {
+    const unsigned long long target = enqueued_count.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    flush_requested = true;
+    wake_cv.notify_one();
+    written_cv.wait(lock, [&] { return written_count.load(std::memory_order_acquire) >= target; });
+}
+
+void HistoryLogger::flush_structured() {
+    const unsigned long long target = enqueued_count.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    flush_requested = true;
+    wake_cv.notify_one();
+    written_cv.wait(lock, [&] { return structured_ready && written_count.load(std::memory_order_acquire) >= target; });
+}
+
+bool HistoryLogger::stats_snapshot(HistoryStats& out_stats) const {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    out_stats = stats;
+    return stats_ready;
+}
+
+void HistoryLogger::writer_loop() {
+    archiver = std::make_unique<HistorySegmentArchiver>();
+
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    for (;;) {
+        wake_cv.wait_for(lock, config.flush_interval, [&] {
+            return flush_requested || stopping || (structured_recovered && !structured_live);
+        });
+        const bool exiting = stopping;
+        const bool forced = flush_requested;
+        flush_requested = false;
+        structured_live = structured_recovered;
+        writer_config = config; // configure() may run on any thread; the rest of the pass uses this copy
+        lock.unlock();
+
+        Node* batch = queue_head.exchange(nullptr, std::memory_order_acquire);
+        const unsigned long long count = batch ? write_batch(batch) : 0;
+        if (structured_live && !pending_records.empty()) {
+            write_structured_batch(pending_records);
+            pending_records.clear();
+        }
+        written_count.fetch_add(count, std::memory_order_release);
+        sync_if_due(forced);
+        if (structured_live) save_stats_if_due(false);
+
+        lock.lock();
+        structured_ready = structured_live;
+        written_cv.notify_all();
+        if (exiting && queue_head.load(std::memory_order_acquire) == nullptr) break;
+    }
+}
+
+unsigned long long HistoryLogger::write_batch(Node* batch_newest_first) {
+    // Reverse into arrival order
+    Node* oldest_first = nullptr;
+    while (batch_newest_first) {
+        Node* next = batch_newest_first->next;
+        batch_newest_first->next = oldest_first;
+        oldest_first = batch_newest_first;
+        batch_newest_first = next;
+    }
+
+    std::string buffer;
+    unsigned long long count = 0;
+    const long long batch_first_ms = static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        oldest_first->timestamp.time_since_epoch()).count());
+    long long batch_last_ms = batch_first_ms;
+    for (Node* node = oldest_first; node;) {
+        const long long second = static_cast<long long>(std::chrono::system_clock::to_time_t(node->timestamp));
+        if (second != cached_second) {
+            std::time_t now_c = static_cast<std::time_t>(second);
+            std::tm now_tm_obj{};
+        #if defined(_WIN32) || defined(_WIN64)
+            localtime_s(&now_tm_obj, &now_c);
+        #else
+            localtime_r(&now_c, &now_tm_obj);
+        #endif
+            std::strftime(cached_timestamp, sizeof(cached_timestamp), "%Y-%m-%d %H:%M:%S", &now_tm_obj);
+            cached_second = second;
+        }
+        buffer += cached_timestamp;
+        buffer += " | ";
+        buffer += node->message;
+        buffer += '\n';
+        const long long timestamp_ms = static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            node->timestamp.time_since_epoch()).count());
+        batch_last_ms = std::max(batch_last_ms, timestamp_ms);
+        if (node->record) {
+            node->record->timestamp_ms = timestamp_ms;
+            pending_records.push_back(std::move(*node->record));
+        }
+
+        Node* next = node->next;
+        delete node;
+        node = next;
+        count++;
+    }
+
+    // Close the active segment before it outgrows its size or age bound. Not while recovery may
+    // still be importing it as legacy history; it rotates on the first batch after that.
+    const bool over_size = writer_config.segment_max_bytes > 0 && active_bytes + buffer.size() > writer_config.segment_max_bytes;
+    const long long max_age_ms = static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(writer_config.segment_max_age).count());
+    const bool over_age = max_age_ms > 0 && active_first_ms >= 0 && batch_last_ms - active_first_ms > max_age_ms;
+    if (structured_live && active_bytes > 0 && (over_size || over_age)) {
+        rotate_active_segment();
+    }
+
+    if (file_handle < 0) {
+        open_active_segment(); // Retry; the directory may have become writable
+    }
+    if (file_handle >= 0 && write_all(file_handle, buffer)) {
+        active_bytes += buffer.size();
+        if (active_first_ms < 0) active_first_ms = batch_first_ms;
+        active_last_ms = batch_last_ms;
+    }
+    return count;
+}
+
+void HistoryLogger::sync_if_due(bool force) {
+    if (file_handle < 0) return;
+    const auto now = std::chrono::steady_clock::now();
+    switch (writer_config.fsync_policy) {
+        case FsyncPolicy::Never:
+            return;
+        case FsyncPolicy::EveryBatch:
+            break;
+        case FsyncPolicy::Interval:
+            if (!force && now - last_sync < writer_config.fsync_interval) return;
+            break;
+    }
+    sync_file(file_handle);
+    if (structured_live) { // The recovery thread still owns the structured handles otherwise
+        for (int fd : {log_handle, time_index_handle}) {
+            if (fd >= 0) sync_file(fd);
+        }
+    }
+    last_sync = now;
+}
+
+// --- Active Text Segment ---
+
+void HistoryLogger::open_active_segment() {
+    file_handle = open_append(HISTORY_FILE);
+    if (file_handle < 0) return;
+    active_bytes = file_end(file_handle);
+    active_first_ms = active_last_ms = -1;
+    if (active_bytes > 0) {
+        // Only the first timestamp is needed for the age bound
+        FileView head;
+        long long first_ms = 0;
+        constexpr size_t STAMP_LENGTH = 19; // "YYYY-MM-DD HH:MM:SS"
+        if (head.open(HISTORY_FILE, STAMP_LENGTH) && head.size() == STAMP_LENGTH &&
+            parse_history_timestamp(std::string(head.view()), first_ms)) {
+            active_first_ms = active_last_ms = first_ms;
+        }
+    }
+}
+
+void HistoryLogger::rotate_active_segment() {
+    if (file_handle >= 0) {
+        if (writer_config.fsync_policy != FsyncPolicy::Never) sync_file(file_handle);
+        close_file(file_handle); // Windows cannot rename an open file
+        file_handle = -1;
+    }
+    if (archiver) {
+        archiver->archive(HISTORY_FILE, active_first_ms, active_last_ms);
+    }
+    open_active_segment(); // Fresh file, or the old one again if archiving failed
+}
+
+// --- Structured Log ---
+
+void HistoryLogger::open_structured_log() {
+    log_handle = open_append(HISTORY_LOG_FILE);
+    if (log_handle < 0) return; // Only the text log is kept
+    log_size = file_end(log_handle);
+    const bool fresh_log = (log_size == 0);
+
+    FileView log_view;
+    if (log_size > 0 && log_view.open(HISTORY_LOG_FILE, static_cast<size_t>(log_size))) {
+        // Terminate a line cut short by a crash so the next record starts cleanly
+        if (log_view.view().back() != '\n' && write_all(log_handle, "\n", 1)) {
+            log_size++;
+        }
+    }
+
+    // Time index: resume after the last indexed record, or rebuild if it does not fit the log
+    unsigned long long time_resume_offset = 0;
+    bool time_index_valid = false;
+    {
+        FileView index;
+        const size_t magic_size = sizeof(HISTORY_TIME_INDEX_MAGIC);
+        if (index.open(HISTORY_TIME_INDEX_FILE) && index.size() >= magic_size &&
+            std::memcmp(index.bytes(), HISTORY_TIME_INDEX_MAGIC, magic_size) == 0 &&
+            (index.size() - magic_size) % sizeof(HistoryTimeIndexEntry) == 0) {
+            time_index_valid = true;
+            const size_t entries = (index.size() - magic_size) / sizeof(HistoryTimeIndexEntry);
+            if (entries > 0) {
+                HistoryTimeIndexEntry last{};
+                std::memcpy(&last, index.bytes() + index.size() - sizeof(last), sizeof(last));
+                size_t line_end = log_view.view().find('\n', static_cast<size_t>(std::min(last.offset, log_size)));
+                if (last.offset >= log_size || line_end == std::string_view::npos) {
+                    time_index_valid = false;
+                } else {
+                    time_resume_offset = line_end + 1;
+                    last_time_key = last.timestamp_ms;
+                }
+            }
+        }
+    }
+    if (time_index_valid) {
+        time_index_handle = open_append(HISTORY_TIME_INDEX_FILE);
+    } else {
+        time_index_handle = open_truncate(HISTORY_TIME_INDEX_FILE);
+        if (time_index_handle >= 0) write_all(time_index_handle, HISTORY_TIME_INDEX_MAGIC, sizeof(HISTORY_TIME_INDEX_MAGIC));
+        last_time_key = 0;
+    }
+
+    // Path index: only its coverage matters here; stale or foreign files are discarded
+    {
+        FileView index;
+        HistoryPathIndexHeader header{};
+        bool valid = index.open(HISTORY_PATH_INDEX_FILE) && index.size() >= sizeof(header);
+        if (valid) {
+            std::memcpy(&header, index.bytes(), sizeof(header));
+            valid = std::memcmp(header.magic, HISTORY_PATH_INDEX_MAGIC, sizeof(header.magic)) == 0 &&
+                    header.covered_offset <= log_size;
+        }
+        index.close();
+        if (valid) {
+            path_index_covered = header.covered_offset;
+        } else {
+            std::remove(HISTORY_PATH_INDEX_FILE.c_str());
+            path_index_covered = 0;
+        }
+    }
+
+    // Statistics: resume from the saved snapshot unless it covers more than the log holds
+    {
+        HistoryStats saved;
+        const bool resumable = load_history_stats(saved) && saved.covered_offset <= log_size;
+        std::lock_guard<std::mutex> stats_lock(stats_mutex);
+        stats = resumable ? saved : HistoryStats{};
+        stats_saved_offset = stats.covered_offset;
+        stats_saved_at = std::chrono::steady_clock::now();
+    }
+
+    log_view.close();
+    recover_structured_indexes(time_resume_offset);
+    if (fresh_log) import_legacy_history();
+}
+
+void HistoryLogger::recover_structured_indexes(unsigned long long time_resume_offset) {
+    const unsigned long long start = std::min({time_resume_offset, path_index_covered, stats.covered_offset});
+    if (start >= log_size) return;
+    FileView log_view;
+    if (!log_view.open(HISTORY_LOG_FILE, static_cast<size_t>(log_size))) return;
+    const std::string_view log_text = log_view.view();
+
+    std::string time_entries;
+    HistoryRecord record;
+    unsigned long long keys[4];
+    size_t pos = static_cast<size_t>(start);
+    while (pos < log_text.size()) {
+        size_t end = log_text.find('\n', pos);
+        if (end == std::string_view::npos) break;
+        const unsigned long long offset = pos;
+        const bool parsed = parse_history_record_json(log_text.substr(pos, end - pos), record);
+        pos = end + 1;
+        if (!parsed) continue;
+
+        if (offset >= time_resume_offset) {
+            last_time_key = std::max(last_time_key, record.timestamp_ms);
+            append_raw(time_entries, HistoryTimeIndexEntry{last_time_key, offset});
+        }
+        if (offset >= stats.covered_offset) {
+            std::lock_guard<std::mutex> stats_lock(stats_mutex);
+            stats.add(record, pos);
+        }
+        if (offset >= path_index_covered) {
+            size_t key_count = history_record_path_keys(record, keys);
+            for (size_t i = 0; i < key_count; ++i) {
+                pending_path_entries.push_back({keys[i], offset});
+            }
+            if (pending_path_entries.size() >= PATH_INDEX_COMPACT_THRESHOLD) {
+                compact_path_index(pos);
+            }
+        }
+    }
+    if (time_index_handle >= 0 && !time_entries.empty()) {
+        write_all(time_index_handle, time_entries);
+    }
+}
+
+void HistoryLogger::import_legacy_history() {
+    std::vector<HistoryRecord> records;
+    HistoryRecord record;
+    auto import_stream = [&](std::istream& legacy) {
+        std::string line;
+        while (std::getline(legacy, line)) {
+            if (!parse_legacy_history_line(line, record)) continue;
+            records.push_back(std::move(record));
+            if (records.size() >= LEGACY_IMPORT_BATCH) {
+                write_structured_batch(records);
+                records.clear();
+            }
+        }
+    };
+
+    // Archived segments first (oldest to newest), then the active file
+    std::string segment_text;
+    for (const HistorySegmentInfo& segment : load_history_manifest()) {
+        if (!read_history_segment(segment, segment_text)) continue;
+        std::istringstream segment_stream(segment_text);
+        import_stream(segment_stream);
+    }
+    // Only what the file held at startup; lines logged since then carry their own records
+    std::ifstream legacy(HISTORY_FILE, std::ios::binary);
+    if (legacy && legacy_history_bytes > 0) {
+        segment_text.resize(static_cast<size_t>(legacy_history_bytes));
+        legacy.read(&segment_text[0], static_cast<std::streamsize>(segment_text.size()));
+        segment_text.resize(static_cast<size_t>(legacy.gcount()));
+        std::istringstream active_stream(segment_text);
+        import_stream(active_stream);
+    }
+    write_structured_batch(records);
+}
+
+void HistoryLogger::write_structured_batch(std::vector<HistoryRecord>& records) {
+    if (log_handle < 0 || records.empty()) return;
+
+    std::string lines;
+    std::string time_entries;
+    std::vector<HistoryPathIndexEntry> path_entries;
+    std::vector<unsigned long long> end_offsets;
+    end_offsets.reserve(records.size());
+    unsigned long long keys[4];
+    long long time_key = last_time_key;
+    for (const HistoryRecord& record : records) {
+        const unsigned long long offset = log_size + lines.size();
+        append_history_record_json(record, lines);
+        end_offsets.push_back(log_size + lines.size());
+        time_key = std::max(time_key, record.timestamp_ms);
+        append_raw(time_entries, HistoryTimeIndexEntry{time_key, offset});
+        size_t key_count = history_record_path_keys(record, keys);
+        for (size_t i = 0; i < key_count; ++i) {
+            path_entries.push_back({keys[i], offset});
+        }
+    }
+
+    if (!write_all(log_handle, lines)) {
+        log_size = file_end(log_handle); // Offsets are unknown now; the indexes catch up on next start
+        return;
+    }
+    log_size += lines.size();
+    last_time_key = time_key;
+    if (time_index_handle >= 0) write_all(time_index_handle, time_entries);
+    {
+        std::lock_guard<std::mutex> stats_lock(stats_mutex);
+        for (size_t i = 0; i < records.size(); ++i) {
+            stats.add(records[i], end_offsets[i]);
+        }
+    }
+    pending_path_entries.insert(pending_path_entries.end(), path_entries.begin(), path_entries.end());
+    if (pending_path_entries.size() >= PATH_INDEX_COMPACT_THRESHOLD) {
+        compact_path_index(log_size);
+    }
+}
+
+void HistoryLogger::compact_path_index(unsigned long long covered_offset) {
+    auto by_key = [](const HistoryPathIndexEntry& a, const HistoryPathIndexEntry& b) {
+        return a.path_key != b.path_key ? a.path_key < b.path_key : a.offset < b.offset;
+    };
+    std::sort(pending_path_entries.begin(), pending_path_entries.end(), by_key);
+
+    // Merge the existing sorted run with the new entries into a fresh file, then swap it in
+    std::vector<HistoryPathIndexEntry> merged;
+    {
+        FileView index;
+        HistoryPathIndexHeader header{};
+        const HistoryPathIndexEntry* old_entries = nullptr;
+        size_t old_count = 0;
+        if (index.open(HISTORY_PATH_INDEX_FILE) && index.size() >= sizeof(header)) {
+            std::memcpy(&header, index.bytes(), sizeof(header));
+            const size_t available = (index.size() - sizeof(header)) / sizeof(HistoryPathIndexEntry);
+            if (std::memcmp(header.magic, HISTORY_PATH_INDEX_MAGIC, sizeof(header.magic)) == 0 && header.entry_count <= available) {
+                old_entries = reinterpret_cast<const HistoryPathIndexEntry*>(index.bytes() + sizeof(header));
+                old_count = static_cast<size_t>(header.entry_count);
+            }
+        }
+        merged.resize(old_count + pending_path_entries.size());
+        std::merge(old_entries, old_entries + old_count, pending_path_entries.begin(), pending_path_entries.end(),
+                   merged.begin(), by_key);
+    }
+
+    HistoryPathIndexHeader header{};
+    std::memcpy(header.magic, HISTORY_PATH_INDEX_MAGIC, sizeof(header.magic));
+    header.covered_offset = covered_offset;
+    header.entry_count = merged.size();
+
+    const std::string temp_path = HISTORY_PATH_INDEX_FILE + ".tmp";
+    int fd = open_truncate(temp_path);
+    if (fd < 0) return; // Keep the entries pending; the next batch retries
+    bool written = write_all(fd, reinterpret_cast<const char*>(&header), sizeof(header)) &&
+                   write_all(fd, reinterpret_cast<const char*>(merged.data()), merged.size() * sizeof(HistoryPathIndexEntry));
+    close_file(fd);
+    if (!written || !replace_file(temp_path, HISTORY_PATH_INDEX_FILE)) {
+        std::remove(temp_path.c_str());
+        return;
+    }
+    path_index_covered = covered_offset;
+    pending_path_entries.clear();
+}
+
+// --- Statistics ---
+
+void HistoryLogger::save_stats_if_due(bool force) {
+    if (log_handle < 0 || stats.covered_offset == stats_saved_offset) return;
+    const auto now = std::chrono::steady_clock::now();
+    if (!force && now - stats_saved_at < STATS_SAVE_INTERVAL) return;
+    // Only this thread modifies 'stats', so it can be read here without the lock
+    if (save_history_stats(stats)) {
+        stats_saved_offset = stats.covered_offset;
+    }
+    stats_saved_at = now;
+}
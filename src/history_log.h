@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory> // For std::unique_ptr
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstddef> // For size_t
+
+#include "history_index.h"    // For HistoryRecord
+#include "history_segments.h" // For HistorySegmentArchiver
+#include "history_stats.h"    // For HistoryStats
+
+// --- Configuration ---
+
+enum class FsyncPolicy {
+    Never,      // Leave durability to the OS page cache (fastest)
+    EveryBatch, // fsync after every batch written by the background thread
+    Interval    // fsync at most once per 'fsync_interval'
+};
+
+struct HistoryLoggerConfig {
+    FsyncPolicy fsync_policy = FsyncPolicy::Never;
+    std::chrono::milliseconds flush_interval{50};   // Longest a record waits in the queue
+    std::chrono::milliseconds fsync_interval{1000}; // Used by FsyncPolicy::Interval
+
+    // The active HISTORY_FILE is archived once it would exceed either bound (0 disables the bound)
+    unsigned long long segment_max_bytes = 8ull * 1024 * 1024;
+    std::chrono::hours segment_max_age{24};
+};
+
+// Asynchronous history writer. Any thread enqueues records on a lock-free multi-producer queue;
+// one background thread drains it in batches into file handles that stay open for the lifetime
+// of the process: the human-readable HISTORY_FILE (rotated into compressed segments) and the
+// structured HISTORY_LOG_FILE with its time and path indexes. A single process is assumed to
+// own the history files.
+class HistoryLogger {
+public:
+    // Returns the process-wide logger (opens HISTORY_FILE on first use)
+    static HistoryLogger& instance();
+
+    void configure(const HistoryLoggerConfig& new_config);
+
+    // Enqueues one line; the timestamp is taken now and formatted later on the writer thread
+    void append(std::string message);
+
+    // Enqueues a line together with its structured record (the writer fills in the timestamp)
+    void append(std::string message, HistoryRecord record);
+
+    // Blocks until every record enqueued before the call has been written to HISTORY_FILE.
+    // Records queued during startup recovery only reach the structured log once it finishes.
+    void flush();
+
+    // Like flush(), but also waits for those records to reach the structured log, which first
+    // needs its startup recovery (possibly a full legacy import) to finish. Structured queries
+    // call this; keep it off the UI thread.
+    void flush_structured();
+
+    // Copies the running statistics (a fixed-size struct, so O(1) in the log size).
+    // Returns false while startup recovery is still folding in older records.
+    bool stats_snapshot(HistoryStats& out_stats) const;
+
+    // Disable copy and move operations; there is exactly one logger
+    HistoryLogger(const HistoryLogger&) = delete;
+    HistoryLogger& operator=(const HistoryLogger&) = delete;
+    HistoryLogger(HistoryLogger&&) = delete;
+    HistoryLogger& operator=(HistoryLogger&&) = delete;
+
+private:
+    HistoryLogger();
+    ~HistoryLogger();
+
+    struct Node {
+        std::chrono::system_clock::time_point timestamp;
+        std::string message;
+        std::optional<HistoryRecord> record;
+        Node* next = nullptr;
+    };
+
+    void writer_loop();
+    unsigned long long write_batch(Node* batch_newest_first); // Returns the number of records
+
+    void sync_if_due(bool force);
+    void push(Node* node);
+    void open_active_segment();
+    void rotate_active_segment();
+
+    // --- Structured Log (recovery thread until 'structured_recovered', then writer thread only) ---
+    void open_structured_log();
+    void recover_structured_indexes(unsigned long long time_resume_offset);
+    void import_legacy_history();
+    void write_structured_batch(std::vector<HistoryRecord>& records);
+    void compact_path_index(unsigned long long covered_offset);
+    void save_stats_if_due(bool force);
+
+    // --- Queue (Treiber stack; the single consumer takes it whole and reverses it) ---
+    std::atomic<Node*> queue_head{nullptr};
+    std::atomic<unsigned long long> enqueued_count{0};
+    std::atomic<unsigned long long> written_count{0};
+
+    // --- Writer Thread State ---
+    std::mutex wake_mutex;
+    std::condition_variable wake_cv;        // Wakes the writer early (flush/shutdown)
+    std::condition_variable written_cv;     // Signals flush() callers
+    bool flush_requested = false;
+    bool stopping = false;
+    bool structured_recovered = false; // The recovery thread has finished with the structured log
+    bool structured_ready = false;     // ...and the writer has taken it over (flush_structured() waits for this)
+    HistoryLoggerConfig config; // Set by configure()
+    std::chrono::steady_clock::time_point last_sync;
+    int file_handle = -1;
+    std::thread writer;
+    std::thread recovery; // Startup recovery/import of the structured log
+    unsigned long long legacy_history_bytes = 0; // HISTORY_FILE's size at startup; later lines have records
+
+    // Writer thread only
+    HistoryLoggerConfig writer_config;          // 'config' as of the start of the current pass
+    bool structured_live = false;               // Records go straight to the structured log
+    std::vector<HistoryRecord> pending_records; // Held back while recovery is still running
+
+    // Active text segment (HISTORY_FILE)
+    std::unique_ptr<HistorySegmentArchiver> archiver;
+    unsigned long long active_bytes = 0;
+    long long active_first_ms = -1; // Timestamp of the segment's first record, -1 while empty
+    long long active_last_ms = -1;
+
+    int log_handle = -1;        // HISTORY_LOG_FILE
+    int time_index_handle = -1; // HISTORY_TIME_INDEX_FILE
+    unsigned long long log_size = 0;
+    long long last_time_key = 0;
+    unsigned long long path_index_covered = 0;
+    std::vector<HistoryPathIndexEntry> pending_path_entries; // Log records past 'path_index_covered'
+
+    // Aggregates for the History Stats tab, updated as records are written. Only the writer
+    // thread modifies them; it takes 'stats_mutex' to do so, and readers take it to copy.
+    mutable std::mutex stats_mutex;
+    HistoryStats stats;
+    bool stats_ready = false;
+    unsigned long long stats_saved_offset = 0;
+    std::chrono::steady_clock::time_point stats_saved_at;
+
+    // Cache of the last formatted second, so a burst of records formats the timestamp once
+    long long cached_second = -1;
+    char cached_timestamp[32] = {0};
+
+    inline static constexpr size_t PATH_INDEX_COMPACT_THRESHOLD = 64 * 1024; // Pending entries before a merge
+    inline static constexpr size_t LEGACY_IMPORT_BATCH = 4096;
+    inline static constexpr std::chrono::seconds STATS_SAVE_INTERVAL{5};
+};
@@ -0,0 +1,187 @@
+#include "history_search.h"
+#include "history_log.h"  // For HistoryLogger::flush
+#include "byte_kernels.h" // For find_byte_sequence
+#include "file_view.h"
+
+#include <algorithm>
+#include <cstring> // For std::memchr, std::memcmp
+
+// --- Anonymous Namespace for INTERNAL (File-Local) Helper Functions ---
+namespace {
+
+    // Work between progress updates, cancellation checks and hand-offs to the UI
+    constexpr size_t SEARCH_SLICE_BYTES = 8 * 1024 * 1024;
+
+    bool needs_json_escape(std::string_view text) {
+        for (char c : text) {
+            if (c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20) return true;
+        }
+        return false;
+    }
+
+    bool contains(std::string_view haystack, std::string_view needle) {
+        return find_byte_sequence(reinterpret_cast<const unsigned char*>(haystack.data()), haystack.size(),
+                                  reinterpret_cast<const unsigned char*>(needle.data()), needle.size()) != haystack.size() ||
+               needle.empty();
+    }
+
+    bool record_matches(const HistoryRecord& record, const HistorySearchQuery& query) {
+        if (record.timestamp_ms < query.from_ms || record.timestamp_ms > query.to_ms) return false;
+        if (!query.op.empty() && record.op != query.op) return false;
+        if (query.pegs != 0 && record.pegs != query.pegs) return false;
+        if (!query.path.empty() && !contains(record.input_path, query.path) && !contains(record.output_path, query.path)) {
+            return false;
+        }
+        if (!query.text.empty() && !contains(record.op, query.text) && !contains(record.input_path, query.text) &&
+            !contains(record.output_path, query.text) && !contains(record.input_sha256, query.text) &&
+            !contains(record.output_sha256, query.text) && !contains(record.details, query.text)) {
+            return false;
+        }
+        return true;
+    }
+
+    // Bytes that every matching line must contain verbatim, so lines can be skipped without
+    // parsing them. Picks the longest such needle; empty if no filter yields one.
+    std::string choose_prefilter(const HistorySearchQuery& query) {
+        std::string best;
+        auto consider = [&best](std::string candidate) {
+            if (candidate.size() > best.size()) best = std::move(candidate);
+        };
+        if (!query.text.empty() && !needs_json_escape(query.text)) consider(query.text);
+        if (!query.path.empty() && !needs_json_escape(query.path)) consider(query.path);
+        if (!query.op.empty() && !needs_json_escape(query.op)) consider("\"op\":\"" + query.op + "\"");
+        if (query.pegs != 0) consider("\"pegs\":" + std::to_string(query.pegs) + ",");
+        return best;
+    }
+
+    // Narrows [begin, end) of the log to the records the time index places inside the range
+    bool narrow_by_time_index(const HistorySearchQuery& query, size_t log_size, size_t& begin, size_t& end) {
+        FileView index;
+        if (!index.open(HISTORY_TIME_INDEX_FILE)) return false;
+        const size_t magic_size = sizeof(HISTORY_TIME_INDEX_MAGIC);
+        if (index.size() < magic_size || std::memcmp(index.bytes(), HISTORY_TIME_INDEX_MAGIC, magic_size) != 0) {
+            return false;
+        }
+        const auto* entries = reinterpret_cast<const HistoryTimeIndexEntry*>(index.bytes() + magic_size);
+        const auto* entries_end = entries + (index.size() - magic_size) / sizeof(HistoryTimeIndexEntry);
+        if (entries == entries_end) return false;
+
+        auto first = std::lower_bound(entries, entries_end, query.from_ms,
+            [](const HistoryTimeIndexEntry& entry, long long value) { return entry.timestamp_ms < value; });
+        auto last = std::upper_bound(first, entries_end, query.to_ms,
+            [](long long value, const HistoryTimeIndexEntry& entry) { return value < entry.timestamp_ms; });
+        // Records written after the last index entry are not covered and are always scanned
+        const unsigned long long indexed_end = (entries_end - 1)->offset;
+        begin = static_cast<size_t>(std::min<unsigned long long>(first != entries_end ? first->offset : indexed_end, log_size));
+        end = (last != entries_end) ? static_cast<size_t>(std::min<unsigned long long>(last->offset, log_size)) : log_size;
+        if (end < begin) end = begin;
+        return true;
+    }
+
+} // End anonymous namespace
+
+// --- HistorySearchStream ---
+
+void HistorySearchStream::publish(std::string& lines) {
+    if (lines.empty()) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (pending.empty()) {
+        pending.swap(lines);
+    } else {
+        pending += lines;
+    }
+    lines.clear();
+}
+
+size_t HistorySearchStream::take(std::string& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const size_t moved = pending.size();
+    if (out.empty()) {
+        out.swap(pending);
+    } else {
+        out += pending;
+    }
+    pending.clear();
+    return moved;
+}
+
+// --- Search ---
+
+bool history_search_query_is_empty(const HistorySearchQuery& query) {
+    return query.text.empty() && query.op.empty() && query.path.empty() && query.pegs == 0 &&
+           query.from_ms == std::numeric_limits<long long>::min() && query.to_ms == std::numeric_limits<long long>::max();
+}
+
+HistorySearchSummary search_history(const HistorySearchQuery& query, HistorySearchStream& stream) {
+    HistorySearchSummary summary;
+    HistoryLogger::instance().flush_structured();
+
+    FileView log;
+    if (!log.open(HISTORY_LOG_FILE)) return summary;
+    summary.log_readable = true;
+    const std::string_view log_text = log.view();
+
+    size_t begin = 0;
+    size_t end = log_text.size();
+    const bool has_time_range = query.from_ms != std::numeric_limits<long long>::min() ||
+                                query.to_ms != std::numeric_limits<long long>::max();
+    if (has_time_range) {
+        summary.used_time_index = narrow_by_time_index(query, log_text.size(), begin, end);
+    }
+    stream.bytes_total = end - begin;
+
+    const std::string needle = choose_prefilter(query);
+    const auto* bytes = reinterpret_cast<const unsigned char*>(log_text.data());
+    const auto* needle_bytes = reinterpret_cast<const unsigned char*>(needle.data());
+    HistoryRecord record;
+    std::string batch;
+
+    size_t pos = begin;
+    while (pos < end) {
+        if (stream.cancel_requested) {
+            summary.cancelled = true;
+            break;
+        }
+        // Slices end on a line boundary so every line is handled by exactly one slice
+        size_t slice_end = std::min(end, pos + SEARCH_SLICE_BYTES);
+        if (slice_end < end) {
+            const void* newline = std::memchr(bytes + slice_end, '\n', end - slice_end);
+            slice_end = newline ? static_cast<size_t>(static_cast<const unsigned char*>(newline) - bytes) + 1 : end;
+        }
+
+        size_t line_begin = pos;
+        while (line_begin < slice_end) {
+            if (!needle.empty()) {
+                // Jump to the next line containing the needle instead of visiting every line
+                const size_t hit = line_begin + find_byte_sequence(bytes + line_begin, slice_end - line_begin,
+                                                                   needle_bytes, needle.size());
+                if (hit >= slice_end) break;
+                const size_t previous_newline = log_text.rfind('\n', hit);
+                line_begin = std::max(line_begin, previous_newline == std::string_view::npos ? size_t(0) : previous_newline + 1);
+            }
+            const void* newline = std::memchr(bytes + line_begin, '\n', slice_end - line_begin);
+            if (newline == nullptr) break; // Partially written trailing line
+            const size_t line_end = static_cast<size_t>(static_cast<const unsigned char*>(newline) - bytes);
+            if (parse_history_record_json(log_text.substr(line_begin, line_end - line_begin), record) &&
+                record_matches(record, query)) {
+                batch += describe_history_record(record);
+                batch += '\n';
+                summary.match_count++;
+                if (summary.match_count >= query.max_results) {
+                    summary.truncated = true;
+                    break;
+                }
+            }
+            line_begin = line_end + 1;
+        }
+
+        summary.bytes_scanned += slice_end - pos;
+        stream.bytes_done = summary.bytes_scanned;
+        stream.match_count = summary.match_count;
+        stream.publish(batch);
+        if (summary.truncated) break;
+        pos = slice_end;
+    }
+    stream.publish(batch);
+    return summary;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "history_index.h"
+
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <cstddef> // For size_t
+
+// --- Structures ---
+
+// Filters for a history search. Empty or default fields match everything; a record must
+// satisfy every field that is set. Text comparisons are case-sensitive.
+struct HistorySearchQuery {
+    std::string text;  // Substring of the op, either path, either digest or the details
+    std::string op;    // Exact op type, e.g. ENCRYPT
+    std::string path;  // Substring of the input or output path
+    int pegs = 0;      // 0 matches any peg count
+    long long from_ms = std::numeric_limits<long long>::min();
+    long long to_ms = std::numeric_limits<long long>::max();
+    size_t max_results = 1000000;
+};
+
+// Shared between a search worker and the UI thread. Matches are handed over in batches of
+// describe_history_record() lines so the UI can show them while the scan continues.
+class HistorySearchStream {
+public:
+    std::atomic<unsigned long long> bytes_done{0};
+    std::atomic<unsigned long long> bytes_total{0};
+    std::atomic<unsigned long long> match_count{0};
+    std::atomic<bool> cancel_requested{false};
+
+    // Worker side: queues '\n'-terminated lines
+    void publish(std::string& lines);
+
+    // UI side: moves the queued lines to the end of 'out'. Returns the number of bytes moved.
+    size_t take(std::string& out);
+
+private:
+    std::mutex mutex;
+    std::string pending;
+};
+
+struct HistorySearchSummary {
+    bool log_readable = false;
+    bool cancelled = false;
+    bool truncated = false;       // Stopped at query.max_results
+    bool used_time_index = false; // The date range narrowed the scan through the time index
+    unsigned long long match_count = 0;
+    unsigned long long bytes_scanned = 0;
+};
+
+// --- Search ---
+
+// True if no filter is set, i.e. the search would return the whole log
+bool history_search_query_is_empty(const HistorySearchQuery& query);
+
+// Scans the structured log for records matching 'query', publishing matches to 'stream'
+// oldest first. Meant to run on a worker thread; checks stream.cancel_requested between slices.
+HistorySearchSummary search_history(const HistorySearchQuery& query, HistorySearchStream& stream);
@@ -0,0 +1,366 @@
+#include "history_segments.h"
+#include "history_index.h" // For parse_history_timestamp
+#include "cipher_utils.h"  // For path_join, create_directory, list_directory_files, replace_file
+#include "block_codec.h"
+#include "file_view.h"
+
+#include <algorithm>
+#include <cstdio>  // For std::remove, std::snprintf
+#include <cstring> // For std::memcpy, std::memcmp
+#include <fstream>
+#include <sstream>
+
+#if defined(_WIN32) || defined(_WIN64)
+    #include <windows.h> // For CreateFileA, FlushFileBuffers
+#else
+    #include <fcntl.h>    // For open
+    #include <unistd.h>   // For write, fsync, close
+    #include <cerrno>
+#endif
+
+// --- Definitions for Global Constants ---
+const std::string HISTORY_SEGMENT_DIR = "history";
+const std::string HISTORY_MANIFEST_FILE = path_join(HISTORY_SEGMENT_DIR, "manifest.txt");
+
+// --- Anonymous Namespace for INTERNAL (File-Local) Helper Functions ---
+namespace {
+
+    const std::string RAW_SEGMENT_EXTENSION = ".md";
+    const std::string COMPRESSED_SEGMENT_EXTENSION = ".cgz";
+
+    // Writes 'data' to 'path' (replacing it) and flushes it to disk before returning, so the
+    // rename that publishes it cannot leave an empty or partial file behind after a power loss
+    bool write_file_synced(const std::string& path, std::string_view data) {
+    #if defined(_WIN32) || defined(_WIN64)
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        bool ok = true;
+        while (ok && !data.empty()) {
+            DWORD written = 0;
+            const DWORD chunk = static_cast<DWORD>(std::min<size_t>(data.size(), 1u << 30));
+            ok = WriteFile(file, data.data(), chunk, &written, nullptr) && written > 0;
+            data.remove_prefix(written);
+        }
+        ok = ok && FlushFileBuffers(file);
+        return CloseHandle(file) && ok;
+    #else
+        const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+        bool ok = true;
+        while (ok && !data.empty()) {
+            const ssize_t written = ::write(fd, data.data(), data.size());
+            if (written < 0 && errno == EINTR) continue;
+            ok = written > 0;
+            if (ok) data.remove_prefix(static_cast<size_t>(written));
+        }
+        ok = ok && ::fsync(fd) == 0;
+        return (::close(fd) == 0) && ok;
+    #endif
+    }
+
+    // Makes renames into 'dir' durable before a file they supersede is removed. Windows journals
+    // directory changes itself and cannot open a directory this way.
+    void sync_directory(const std::string& dir) {
+    #if !defined(_WIN32) && !defined(_WIN64)
+        const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) return;
+        ::fsync(fd);
+        ::close(fd);
+    #else
+        (void)dir;
+    #endif
+    }
+
+    std::string segment_file_name(unsigned long long id, const std::string& extension) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "segment-%06llu", id);
+        return buffer + extension;
+    }
+
+    bool ends_with(const std::string& text, const std::string& suffix) {
+        return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    // Timestamps of the first and last "YYYY-MM-DD HH:MM:SS | ..." lines of a segment
+    void text_time_bounds(std::string_view text, long long& first_ms, long long& last_ms) {
+        constexpr size_t STAMP_LENGTH = 19;
+        first_ms = last_ms = 0;
+        if (text.size() >= STAMP_LENGTH) {
+            parse_history_timestamp(std::string(text.substr(0, STAMP_LENGTH)), first_ms);
+        }
+        size_t end = text.size();
+        while (end > 0 && text[end - 1] == '\n') --end;
+        size_t begin = text.rfind('\n', end == 0 ? 0 : end - 1);
+        begin = (begin == std::string_view::npos) ? 0 : begin + 1;
+        if (end - begin >= STAMP_LENGTH) {
+            parse_history_timestamp(std::string(text.substr(begin, STAMP_LENGTH)), last_ms);
+        }
+    }
+
+    // Writes 'raw' as a block-compressed segment file
+    bool write_compressed_segment(std::string_view raw, const std::string& path) {
+        const unsigned int block_size = HistorySegmentArchiver::BLOCK_SIZE;
+        const size_t block_count = (raw.size() + block_size - 1) / block_size;
+
+        HistorySegmentHeader header{};
+        std::memcpy(header.magic, HISTORY_SEGMENT_MAGIC, sizeof(header.magic));
+        header.raw_size = raw.size();
+        header.block_size = block_size;
+        header.block_count = static_cast<unsigned int>(block_count);
+
+        std::vector<HistorySegmentBlock> table(block_count);
+        std::string payload;
+        payload.reserve(raw.size() / 4);
+        std::string compressed;
+        std::vector<unsigned char> check;
+        unsigned long long offset = sizeof(header) + block_count * sizeof(HistorySegmentBlock);
+        for (size_t i = 0; i < block_count; ++i) {
+            const size_t begin = i * block_size;
+            const size_t length = std::min<size_t>(block_size, raw.size() - begin);
+            const auto* block = reinterpret_cast<const unsigned char*>(raw.data() + begin);
+            compressed.clear();
+            lz_compress_block(block, length, compressed);
+            // Every block is decoded again before it is kept; one that does not reproduce its
+            // input is stored raw, so a codec fault costs compression rather than history
+            bool store_raw = compressed.size() >= length;
+            if (!store_raw) {
+                check.resize(length);
+                store_raw = !lz_decompress_block(reinterpret_cast<const unsigned char*>(compressed.data()), compressed.size(), check.data(), length) ||
+                            std::memcmp(check.data(), block, length) != 0;
+            }
+            table[i] = {offset, static_cast<unsigned int>(store_raw ? length : compressed.size()), static_cast<unsigned int>(length)};
+            if (store_raw) {
+                payload.append(raw.data() + begin, length);
+            } else {
+                payload += compressed;
+            }
+            offset += table[i].stored_size;
+        }
+
+        std::string image;
+        image.reserve(static_cast<size_t>(offset));
+        image.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        image.append(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(HistorySegmentBlock));
+        image += payload;
+        return write_file_synced(path, image);
+    }
+
+    bool decode_compressed_segment(const FileView& file, std::string& out_text) {
+        HistorySegmentHeader header{};
+        if (file.size() < sizeof(header)) return false;
+        std::memcpy(&header, file.bytes(), sizeof(header));
+        // Sizes come from the file, so the whole table is checked before anything is allocated:
+        // a damaged header must not size the output buffer
+        if (header.block_size != HistorySegmentArchiver::BLOCK_SIZE ||
+            header.block_count > (file.size() - sizeof(header)) / sizeof(HistorySegmentBlock)) {
+            return false;
+        }
+        const unsigned char* table = file.bytes() + sizeof(header);
+        unsigned long long table_raw_size = 0;
+        unsigned long long table_stored_size = 0;
+        for (unsigned int i = 0; i < header.block_count; ++i) {
+            HistorySegmentBlock block{};
+            std::memcpy(&block, table + i * sizeof(HistorySegmentBlock), sizeof(block));
+            // A stored byte expands to at most 255 raw ones (one match-length byte), so a block
+            // claiming more is damaged
+            if (block.raw_size > header.block_size || block.offset > file.size() ||
+                block.stored_size > file.size() - block.offset ||
+                block.raw_size > 255ull * block.stored_size + 255) {
+                return false;
+            }
+            table_raw_size += block.raw_size;
+            table_stored_size += block.stored_size;
+        }
+        // Blocks do not overlap, so together they fit in the file
+        if (table_raw_size != header.raw_size || table_stored_size > file.size()) return false;
+
+        out_text.resize(static_cast<size_t>(header.raw_size));
+        size_t written = 0;
+        for (unsigned int i = 0; i < header.block_count; ++i) {
+            HistorySegmentBlock block{};
+            std::memcpy(&block, table + i * sizeof(HistorySegmentBlock), sizeof(block));
+            auto* target = reinterpret_cast<unsigned char*>(&out_text[0]) + written;
+            if (block.stored_size == block.raw_size) {
+                std::memcpy(target, file.bytes() + block.offset, block.raw_size);
+            } else if (!lz_decompress_block(file.bytes() + block.offset, block.stored_size, target, block.raw_size)) {
+                return false;
+            }
+            written += block.raw_size;
+        }
+        return written == out_text.size();
+    }
+
+} // End anonymous namespace
+
+bool HistorySegmentInfo::compressed() const {
+    return ends_with(file_name, COMPRESSED_SEGMENT_EXTENSION);
+}
+
+// --- Readers ---
+
+std::vector<HistorySegmentInfo> load_history_manifest() {
+    std::vector<HistorySegmentInfo> segments;
+    std::ifstream manifest(HISTORY_MANIFEST_FILE);
+    std::string line;
+    while (std::getline(manifest, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        HistorySegmentInfo segment;
+        if (fields >> segment.id >> segment.first_timestamp_ms >> segment.last_timestamp_ms >> segment.raw_bytes >> segment.file_name) {
+            segments.push_back(std::move(segment));
+        }
+    }
+    std::sort(segments.begin(), segments.end(),
+              [](const HistorySegmentInfo& a, const HistorySegmentInfo& b) { return a.id < b.id; });
+    return segments;
+}
+
+bool read_history_segment(const HistorySegmentInfo& segment, std::string& out_text) {
+    out_text.clear();
+    FileView file;
+    if (!file.open(path_join(HISTORY_SEGMENT_DIR, segment.file_name))) {
+        // The compressor may have replaced the raw file since the manifest was read
+        if (segment.compressed() ||
+            !file.open(path_join(HISTORY_SEGMENT_DIR, segment_file_name(segment.id, COMPRESSED_SEGMENT_EXTENSION)))) {
+            return false;
+        }
+    }
+    const size_t magic_size = sizeof(HISTORY_SEGMENT_MAGIC);
+    if (file.size() >= magic_size && std::memcmp(file.bytes(), HISTORY_SEGMENT_MAGIC, magic_size) == 0) {
+        return decode_compressed_segment(file, out_text);
+    }
+    out_text.assign(file.view());
+    return true;
+}
+
+// --- HistorySegmentArchiver ---
+
+HistorySegmentArchiver::HistorySegmentArchiver() {
+    if (!is_directory(HISTORY_SEGMENT_DIR)) {
+        create_directory(HISTORY_SEGMENT_DIR);
+    }
+    segments = load_history_manifest();
+    for (const HistorySegmentInfo& segment : segments) {
+        next_id = std::max(next_id, segment.id + 1);
+    }
+    adopt_orphaned_segments();
+    for (const HistorySegmentInfo& segment : segments) {
+        if (!segment.compressed()) pending_ids.push_back(segment.id);
+    }
+    compressor = std::thread(&HistorySegmentArchiver::compressor_loop, this);
+}
+
+HistorySegmentArchiver::~HistorySegmentArchiver() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true; // Unfinished segments stay raw and are queued again on the next start
+    }
+    pending_cv.notify_one();
+    if (compressor.joinable()) compressor.join();
+}
+
+void HistorySegmentArchiver::adopt_orphaned_segments() {
+    // A crash between moving a segment and saving the manifest leaves a file the manifest
+    // does not list; leftovers of a finished compression are simply removed
+    bool changed = false;
+    for (const std::string& name : list_directory_files(HISTORY_SEGMENT_DIR)) {
+        unsigned long long id = 0;
+        if (name.rfind("segment-", 0) != 0 || std::sscanf(name.c_str() + 8, "%llu", &id) != 1) continue;
+        const std::string path = path_join(HISTORY_SEGMENT_DIR, name);
+        auto listed = std::find_if(segments.begin(), segments.end(),
+                                   [&](const HistorySegmentInfo& segment) { return segment.id == id; });
+        if (listed != segments.end()) {
+            if (listed->file_name != name) std::remove(path.c_str());
+            continue;
+        }
+        if (!ends_with(name, RAW_SEGMENT_EXTENSION)) {
+            std::remove(path.c_str()); // Partial compressor output
+            continue;
+        }
+        FileView file;
+        if (!file.open(path)) continue;
+        HistorySegmentInfo segment;
+        segment.id = id;
+        segment.raw_bytes = file.size();
+        segment.file_name = name;
+        text_time_bounds(file.view(), segment.first_timestamp_ms, segment.last_timestamp_ms);
+        segments.push_back(std::move(segment));
+        next_id = std::max(next_id, id + 1);
+        changed = true;
+    }
+    if (changed) {
+        std::sort(segments.begin(), segments.end(),
+                  [](const HistorySegmentInfo& a, const HistorySegmentInfo& b) { return a.id < b.id; });
+        save_manifest_locked();
+    }
+}
+
+bool HistorySegmentArchiver::archive(const std::string& active_path, long long first_timestamp_ms, long long last_timestamp_ms) {
+    std::lock_guard<std::mutex> lock(mutex);
+    HistorySegmentInfo segment;
+    segment.id = next_id;
+    segment.first_timestamp_ms = first_timestamp_ms;
+    segment.last_timestamp_ms = last_timestamp_ms;
+    segment.file_name = segment_file_name(segment.id, RAW_SEGMENT_EXTENSION);
+    const std::string segment_path = path_join(HISTORY_SEGMENT_DIR, segment.file_name);
+    if (!replace_file(active_path, segment_path)) return false;
+    next_id++;
+
+    FileView file;
+    if (file.open(segment_path)) segment.raw_bytes = file.size();
+    segments.push_back(segment);
+    save_manifest_locked();
+    pending_ids.push_back(segment.id);
+    pending_cv.notify_one();
+    return true;
+}
+
+void HistorySegmentArchiver::compressor_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        pending_cv.wait(lock, [&] { return stopping || !pending_ids.empty(); });
+        if (stopping) return;
+        const unsigned long long id = pending_ids.front();
+        pending_ids.pop_front();
+        auto it = std::find_if(segments.begin(), segments.end(), [&](const HistorySegmentInfo& s) { return s.id == id; });
+        if (it == segments.end() || it->compressed()) continue;
+        const std::string raw_path = path_join(HISTORY_SEGMENT_DIR, it->file_name);
+        lock.unlock();
+
+        // Compress outside the lock; rotation only appends to 'segments'
+        const std::string compressed_name = segment_file_name(id, COMPRESSED_SEGMENT_EXTENSION);
+        const std::string compressed_path = path_join(HISTORY_SEGMENT_DIR, compressed_name);
+        const std::string temp_path = compressed_path + ".tmp";
+        bool done = false;
+        {
+            FileView raw;
+            done = raw.open(raw_path) && write_compressed_segment(raw.view(), temp_path) &&
+                   replace_file(temp_path, compressed_path);
+        }
+        if (!done) std::remove(temp_path.c_str());
+
+        lock.lock();
+        if (done) {
+            it = std::find_if(segments.begin(), segments.end(), [&](const HistorySegmentInfo& s) { return s.id == id; });
+            if (it != segments.end()) {
+                it->file_name = compressed_name;
+                done = save_manifest_locked();
+            }
+            // The raw copy goes only once the compressed file and the manifest naming it are on disk
+            if (done) std::remove(raw_path.c_str());
+        }
+    }
+}
+
+bool HistorySegmentArchiver::save_manifest_locked() const {
+    const std::string temp_path = HISTORY_MANIFEST_FILE + ".tmp";
+    std::ostringstream out;
+    out << "# id first_ms last_ms raw_bytes file\n";
+    for (const HistorySegmentInfo& segment : segments) {
+        out << segment.id << ' ' << segment.first_timestamp_ms << ' ' << segment.last_timestamp_ms << ' '
+            << segment.raw_bytes << ' ' << segment.file_name << '\n';
+    }
+    if (!write_file_synced(temp_path, out.str()) || !replace_file(temp_path, HISTORY_MANIFEST_FILE)) return false;
+    sync_directory(HISTORY_SEGMENT_DIR); // Also covers segment files renamed in before this save
+    return true;
+}
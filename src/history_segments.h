@@ -0,0 +1,88 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstddef> // For size_t
+
+// --- Files ---
+// HISTORY_FILE is the active segment. When it reaches the configured size or age the writer
+// moves it into HISTORY_SEGMENT_DIR as a closed segment, and a background thread compresses it.
+// The manifest lists closed segments oldest first so readers only open the ones they need.
+extern const std::string HISTORY_SEGMENT_DIR;   // history/
+extern const std::string HISTORY_MANIFEST_FILE; // history/manifest.txt
+
+// --- Structures ---
+
+struct HistorySegmentInfo {
+    unsigned long long id = 0;
+    long long first_timestamp_ms = 0;
+    long long last_timestamp_ms = 0;
+    unsigned long long raw_bytes = 0; // Size of the uncompressed text
+    std::string file_name;            // Inside HISTORY_SEGMENT_DIR: ".md" until compressed, then ".cgz"
+
+    bool compressed() const;
+};
+
+// Compressed segment layout: header, block table, then the blocks. Blocks are compressed
+// independently so a reader can decode just the part it needs.
+struct HistorySegmentHeader {
+    char magic[8];
+    unsigned long long raw_size;
+    unsigned int block_size;
+    unsigned int block_count;
+};
+
+struct HistorySegmentBlock {
+    unsigned long long offset;  // From the start of the file
+    unsigned int stored_size;   // Equal to raw_size when the block is stored uncompressed
+    unsigned int raw_size;
+};
+
+inline constexpr char HISTORY_SEGMENT_MAGIC[8] = {'C', 'G', 'S', 'E', 'G', '1', '\0', '\0'};
+
+// --- Readers ---
+
+// Closed segments, oldest first. Empty if nothing has been rotated yet.
+std::vector<HistorySegmentInfo> load_history_manifest();
+
+// Reads a closed segment's text, decompressing it if needed
+bool read_history_segment(const HistorySegmentInfo& segment, std::string& out_text);
+
+// --- Writer Side ---
+
+// Owned by the HistoryLogger. archive() runs on the writer thread; compression runs on
+// this class's own thread so rotation never stalls logging.
+class HistorySegmentArchiver {
+public:
+    HistorySegmentArchiver();
+    ~HistorySegmentArchiver();
+
+    // Moves the closed file at 'active_path' into the archive and schedules its compression.
+    // The caller must have closed its handle to the file.
+    bool archive(const std::string& active_path, long long first_timestamp_ms, long long last_timestamp_ms);
+
+    // Disable copy and move operations; the compressor thread holds 'this'
+    HistorySegmentArchiver(const HistorySegmentArchiver&) = delete;
+    HistorySegmentArchiver& operator=(const HistorySegmentArchiver&) = delete;
+    HistorySegmentArchiver(HistorySegmentArchiver&&) = delete;
+    HistorySegmentArchiver& operator=(HistorySegmentArchiver&&) = delete;
+
+    inline static constexpr unsigned int BLOCK_SIZE = 1024 * 1024;
+
+private:
+    void adopt_orphaned_segments();
+    void compressor_loop();
+    bool save_manifest_locked() const;
+
+    std::mutex mutex;
+    std::condition_variable pending_cv;
+    std::vector<HistorySegmentInfo> segments;
+    std::deque<unsigned long long> pending_ids; // Segments waiting for compression
+    unsigned long long next_id = 1;
+    bool stopping = false;
+    std::thread compressor;
+};
@@ -0,0 +1,170 @@
+#include "history_stats.h"
+#include "cipher_utils.h" // For replace_file
+#include "file_view.h"
+
+#include <algorithm>
+#include <cstring> // For std::memcpy, std::memcmp, std::strncmp
+#include <fstream>
+#include <type_traits>
+
+// --- Definitions for Global Constants ---
+const std::string HISTORY_STATS_FILE = "history.jsonl.stats";
+
+// --- Anonymous Namespace for INTERNAL (File-Local) Helper Functions ---
+namespace {
+
+    // The size is part of the check so a snapshot from a build with different bounds is rebuilt
+    constexpr char STATS_MAGIC[8] = {'C', 'G', 'H', 'S', 'T', 'A', '1', '\0'};
+    constexpr unsigned long long STATS_SIZE = sizeof(HistoryStats);
+    constexpr long long MS_PER_DAY = 24LL * 60 * 60 * 1000;
+
+    static_assert(std::is_trivially_copyable<HistoryStats>::value, "HistoryStats is saved as raw bytes");
+
+    HistoryStatsKind kind_of(const std::string& op) {
+        if (op == "ENCRYPT") return HistoryStatsKind::Encrypt;
+        if (op == "DECRYPT") return HistoryStatsKind::Decrypt;
+        return HistoryStatsKind::Other;
+    }
+
+    template <size_t N>
+    void copy_truncated(char (&out)[N], const std::string& value) {
+        const size_t length = std::min(value.size(), N - 1);
+        std::memcpy(out, value.data(), length);
+        out[length] = '\0';
+    }
+
+    long long floor_day(long long timestamp_ms) {
+        return (timestamp_ms >= 0) ? timestamp_ms / MS_PER_DAY : -((-timestamp_ms + MS_PER_DAY - 1) / MS_PER_DAY);
+    }
+
+} // End anonymous namespace
+
+// --- HistoryDurationHistogram ---
+
+void HistoryDurationHistogram::add(unsigned long long duration_us) noexcept {
+    size_t bucket;
+    if (duration_us < 4) {
+        bucket = static_cast<size_t>(duration_us);
+    } else {
+        const int octave = 63 - __builtin_clzll(duration_us); // >= 2
+        const size_t sub = static_cast<size_t>((duration_us >> (octave - 2)) & 3);
+        bucket = 4 * static_cast<size_t>(octave - 1) + sub;
+    }
+    counts[std::min(bucket, BUCKETS - 1)]++;
+    samples++;
+}
+
+unsigned long long HistoryDurationHistogram::percentile_us(double fraction) const noexcept {
+    if (samples == 0) return 0;
+    const unsigned long long rank = std::max<unsigned long long>(1, static_cast<unsigned long long>(
+        std::clamp(fraction, 0.0, 1.0) * static_cast<double>(samples) + 0.5));
+    unsigned long long seen = 0;
+    for (size_t bucket = 0; bucket < BUCKETS; ++bucket) {
+        seen += counts[bucket];
+        if (seen < rank) continue;
+        if (bucket < 4) return bucket;
+        // Middle of the bucket's range [(4 + sub) << shift, (5 + sub) << shift)
+        const unsigned shift = static_cast<unsigned>(bucket / 4 - 1);
+        const unsigned long long sub = bucket % 4;
+        return ((4 + sub) << shift) + ((1ull << shift) >> 1);
+    }
+    return 0;
+}
+
+// --- HistoryStats ---
+
+void HistoryStats::add(const HistoryRecord& record, unsigned long long end_offset) {
+    covered_offset = std::max(covered_offset, end_offset);
+    record_count++;
+    const HistoryStatsKind kind = kind_of(record.op);
+    if (kind == HistoryStatsKind::Encrypt) {
+        encrypt_count++;
+        bytes_encrypted += record.bytes;
+    } else if (kind == HistoryStatsKind::Decrypt) {
+        decrypt_count++;
+        bytes_decrypted += record.bytes;
+    }
+
+    // Per-day bucket; records older than the ring are only counted in the totals
+    const long long day = floor_day(record.timestamp_ms);
+    HistoryDayStats& slot = days[static_cast<size_t>(((day % static_cast<long long>(DAYS)) + DAYS) % DAYS)];
+    if (slot.day < day) {
+        slot = HistoryDayStats{};
+        slot.day = day;
+    }
+    if (slot.day == day) {
+        slot.operations++;
+        if (kind == HistoryStatsKind::Encrypt) slot.bytes_encrypted += record.bytes;
+        if (kind == HistoryStatsKind::Decrypt) slot.bytes_decrypted += record.bytes;
+    }
+
+    if (record.duration_us > 0) {
+        durations[static_cast<size_t>(kind)].add(record.duration_us);
+    }
+    if (kind == HistoryStatsKind::Other) return;
+
+    if (record.throughput_mb_s > 0.0) {
+        throughput_mb_s[throughput_next] = static_cast<float>(record.throughput_mb_s);
+        throughput_next = (throughput_next + 1) % THROUGHPUT_SAMPLES;
+        throughput_count = std::min(throughput_count + 1, THROUGHPUT_SAMPLES);
+    }
+
+    // Top files by size: the same path keeps one slot, otherwise the smallest entry is replaced
+    if (record.bytes == 0 || record.input_path.empty()) return;
+    HistoryLargestFile* target = nullptr;
+    for (HistoryLargestFile& entry : largest_files) {
+        if (entry.bytes > 0 && std::strncmp(entry.path, record.input_path.c_str(), sizeof(entry.path) - 1) == 0) {
+            target = &entry;
+            break;
+        }
+        if (!target || entry.bytes < target->bytes) target = &entry;
+    }
+    if (target->bytes > record.bytes) return;
+    target->bytes = record.bytes;
+    target->timestamp_ms = record.timestamp_ms;
+    copy_truncated(target->op, record.op);
+    copy_truncated(target->path, record.input_path);
+}
+
+long long HistoryStats::latest_day() const noexcept {
+    long long latest = -1;
+    for (const HistoryDayStats& slot : days) {
+        latest = std::max(latest, slot.day);
+    }
+    return latest;
+}
+
+const HistoryDayStats* HistoryStats::day_stats(long long day) const noexcept {
+    if (day < 0) return nullptr;
+    const HistoryDayStats& slot = days[static_cast<size_t>(day % static_cast<long long>(DAYS))];
+    return (slot.day == day) ? &slot : nullptr;
+}
+
+// --- Persistence ---
+
+bool load_history_stats(HistoryStats& out_stats) {
+    FileView view;
+    if (!view.open(HISTORY_STATS_FILE) || view.size() != sizeof(STATS_MAGIC) + sizeof(STATS_SIZE) + sizeof(HistoryStats)) {
+        return false;
+    }
+    unsigned long long stored_size = 0;
+    std::memcpy(&stored_size, view.bytes() + sizeof(STATS_MAGIC), sizeof(stored_size));
+    if (std::memcmp(view.bytes(), STATS_MAGIC, sizeof(STATS_MAGIC)) != 0 || stored_size != STATS_SIZE) {
+        return false;
+    }
+    std::memcpy(&out_stats, view.bytes() + sizeof(STATS_MAGIC) + sizeof(STATS_SIZE), sizeof(HistoryStats));
+    out_stats.throughput_next %= HistoryStats::THROUGHPUT_SAMPLES; // Never index past the ring
+    return true;
+}
+
+bool save_history_stats(const HistoryStats& stats) {
+    const std::string temp_path = HISTORY_STATS_FILE + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        out.write(STATS_MAGIC, sizeof(STATS_MAGIC));
+        out.write(reinterpret_cast<const char*>(&STATS_SIZE), sizeof(STATS_SIZE));
+        out.write(reinterpret_cast<const char*>(&stats), sizeof(stats));
+        if (!out.flush()) return false;
+    }
+    return replace_file(temp_path, HISTORY_STATS_FILE);
+}
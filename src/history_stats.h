@@ -0,0 +1,82 @@
+#pragma once
+
+#include "history_index.h" // For HistoryRecord
+
+#include <array>
+#include <string>
+#include <cstddef> // For size_t
+
+// --- Files ---
+// Snapshot of the aggregates below, saved by the HistoryLogger writer thread. On startup only
+// the part of HISTORY_LOG_FILE past the snapshot's 'covered_offset' is folded in again.
+extern const std::string HISTORY_STATS_FILE; // history.jsonl.stats
+
+// --- Structures ---
+// Everything is fixed-size (no heap memory), so a snapshot is one bounded copy no matter how
+// long the log is, and the whole struct can be written to disk as-is.
+
+enum class HistoryStatsKind { Encrypt, Decrypt, Other };
+
+struct HistoryDayStats {
+    long long day = -1; // Days since the Unix epoch (UTC); -1 for an unused slot
+    unsigned long long operations = 0;
+    unsigned long long bytes_encrypted = 0;
+    unsigned long long bytes_decrypted = 0;
+};
+
+// Log-scale histogram of operation durations: four buckets per power of two, so any
+// percentile read from it is within about 12% of the exact value
+struct HistoryDurationHistogram {
+    inline static constexpr size_t BUCKETS = 256;
+    unsigned long long counts[BUCKETS] = {};
+    unsigned long long samples = 0;
+
+    void add(unsigned long long duration_us) noexcept;
+    // Estimated duration below which 'fraction' (0..1) of the samples fall; 0 if empty
+    unsigned long long percentile_us(double fraction) const noexcept;
+};
+
+struct HistoryLargestFile {
+    unsigned long long bytes = 0;
+    long long timestamp_ms = 0;
+    char op[16] = {};
+    char path[240] = {}; // Truncated if longer; display only
+};
+
+struct HistoryStats {
+    inline static constexpr size_t DAYS = 90;                 // Per-day buckets kept
+    inline static constexpr size_t THROUGHPUT_SAMPLES = 256;  // Recent ENCRYPT/DECRYPT MB/s values
+    inline static constexpr size_t TOP_FILES = 10;
+
+    unsigned long long covered_offset = 0; // Bytes of HISTORY_LOG_FILE folded in so far
+    unsigned long long record_count = 0;
+    unsigned long long encrypt_count = 0;
+    unsigned long long decrypt_count = 0;
+    unsigned long long bytes_encrypted = 0;
+    unsigned long long bytes_decrypted = 0;
+
+    std::array<HistoryDayStats, DAYS> days{}; // Ring indexed by day % DAYS
+    std::array<HistoryDurationHistogram, 3> durations{}; // Indexed by HistoryStatsKind
+
+    std::array<float, THROUGHPUT_SAMPLES> throughput_mb_s{}; // Ring; oldest at throughput_next once full
+    size_t throughput_next = 0;
+    size_t throughput_count = 0;
+
+    std::array<HistoryLargestFile, TOP_FILES> largest_files{}; // Unsorted; 'bytes' 0 marks a free slot
+
+    // Folds in one record whose line ends 'end_offset' bytes into the log
+    void add(const HistoryRecord& record, unsigned long long end_offset);
+
+    const HistoryDurationHistogram& histogram(HistoryStatsKind kind) const noexcept {
+        return durations[static_cast<size_t>(kind)];
+    }
+    // Most recent day with any records, or -1
+    long long latest_day() const noexcept;
+    // Bucket for 'day', or nullptr if it is not in the ring
+    const HistoryDayStats* day_stats(long long day) const noexcept;
+};
+
+// --- Persistence ---
+
+bool load_history_stats(HistoryStats& out_stats);
+bool save_history_stats(const HistoryStats& stats);
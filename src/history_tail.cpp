@@ -0,0 +1,146 @@
+#include "history_tail.h"
+#include "history_segments.h" // For load_history_manifest, read_history_segment
+#include "cipher_utils.h"     // For path_get_parent, path_get_filename
+
+#include <fstream>
+#include <vector>
+
+// Platform-specific includes for file identity and change notification
+#if defined(_WIN32) || defined(_WIN64)
+    #include <sys/types.h>
+    #include <sys/stat.h> // For _stat64
+#else
+    #include <sys/stat.h> // For stat
+    #include <unistd.h>   // For read, close
+    #include <cerrno>
+    #if defined(__linux__)
+        #include <sys/inotify.h>
+    #endif
+#endif
+
+HistoryTailFollower::HistoryTailFollower(std::string path) noexcept
+    : path(std::move(path)) {}
+
+HistoryTailFollower::~HistoryTailFollower() noexcept {
+    stop_watch();
+}
+
+void HistoryTailFollower::reset(unsigned long long offset) {
+    unsigned long long size = 0;
+    read_offset = offset;
+    file_identity = 0;
+    stat_file(size, file_identity);
+    std::vector<HistorySegmentInfo> segments = load_history_manifest();
+    last_archived_id = segments.empty() ? 0 : segments.back().id;
+}
+
+bool HistoryTailFollower::stat_file(unsigned long long& size, unsigned long long& identity) const {
+#if defined(_WIN32) || defined(_WIN64)
+    struct _stat64 info;
+    if (_stat64(path.c_str(), &info) != 0) return false;
+    size = static_cast<unsigned long long>(info.st_size);
+    identity = 0; // No stable inode number; rotation is detected by the size shrinking
+#else
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) return false;
+    size = static_cast<unsigned long long>(info.st_size);
+    identity = static_cast<unsigned long long>(info.st_ino);
+#endif
+    return true;
+}
+
+bool HistoryTailFollower::start_watch() {
+    if (watch_enabled) return true;
+#if defined(__linux__)
+    notify_handle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notify_handle >= 0) {
+        // Watch the directory, not the file: rotation renames the file away from its watch
+        const uint32_t mask = IN_MODIFY | IN_CREATE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE;
+        if (inotify_add_watch(notify_handle, path_get_parent(path).c_str(), mask) < 0) {
+            close(notify_handle);
+            notify_handle = -1; // Fall back to polling
+        }
+    }
+#endif
+    watch_enabled = true;
+    last_poll = {};
+    return true;
+}
+
+void HistoryTailFollower::stop_watch() noexcept {
+#if defined(__linux__)
+    if (notify_handle >= 0) {
+        close(notify_handle);
+        notify_handle = -1;
+    }
+#endif
+    watch_enabled = false;
+}
+
+bool HistoryTailFollower::poll_changed() {
+    if (!watch_enabled) return false;
+#if defined(__linux__)
+    if (notify_handle >= 0) {
+        const std::string name = path_get_filename(path);
+        alignas(struct inotify_event) char buffer[4096];
+        bool changed = false;
+        for (;;) {
+            ssize_t length = read(notify_handle, buffer, sizeof(buffer));
+            if (length <= 0) break; // EAGAIN: no more events queued
+            for (ssize_t pos = 0; pos < length;) {
+                const auto* event = reinterpret_cast<const struct inotify_event*>(buffer + pos);
+                if (event->len > 0 && name == event->name) changed = true;
+                if (event->mask & IN_Q_OVERFLOW) changed = true;
+                pos += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+            }
+        }
+        return changed;
+    }
+#endif
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_poll < POLL_INTERVAL) return false;
+    last_poll = now;
+    unsigned long long size = 0, identity = 0;
+    if (!stat_file(size, identity)) return read_offset > 0;
+    return size != read_offset || identity != file_identity;
+}
+
+size_t HistoryTailFollower::read_new(std::string& out) {
+    const size_t initial_size = out.size();
+    unsigned long long size = 0, identity = 0;
+    const bool exists = stat_file(size, identity);
+
+    // The writer archived the file we were reading: finish it from the first segment archived
+    // since, then take any later segments whole (several rotations may have happened meanwhile)
+    const bool rotated = exists ? (size < read_offset || (file_identity != 0 && identity != file_identity))
+                                : read_offset > 0;
+    if (rotated) {
+        std::vector<HistorySegmentInfo> segments = load_history_manifest();
+        for (const HistorySegmentInfo& segment : segments) {
+            if (segment.id <= last_archived_id) continue;
+            std::string text;
+            if (read_history_segment(segment, text) && text.size() > read_offset) {
+                out.append(text, static_cast<size_t>(read_offset), std::string::npos);
+            }
+            read_offset = 0;
+        }
+        if (!segments.empty()) last_archived_id = segments.back().id;
+        read_offset = 0;
+    }
+    if (!exists) return out.size() - initial_size;
+    file_identity = identity;
+
+    if (size > read_offset) {
+        std::ifstream file(path, std::ios::binary);
+        if (file.seekg(static_cast<std::streamoff>(read_offset))) {
+            const size_t wanted = static_cast<size_t>(size - read_offset);
+            const size_t old_size = out.size();
+            out.resize(old_size + wanted);
+            file.read(&out[old_size], static_cast<std::streamsize>(wanted));
+            const size_t got = static_cast<size_t>(file.gcount());
+            out.resize(old_size + got);
+            read_offset += got;
+        }
+    }
+    return out.size() - initial_size;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <cstddef> // For size_t
+
+// Follows the active history file from a remembered offset so the History screen only reads
+// bytes appended since its last read. On Linux an inotify watch on the file's directory says
+// when to look; elsewhere the file size is polled at most every POLL_INTERVAL.
+// Rotation (the writer moving the file into the segment archive) is detected and the
+// unread tail of the archived segment, plus any segments archived after it, is returned
+// before the new file's contents.
+class HistoryTailFollower {
+public:
+    explicit HistoryTailFollower(std::string path) noexcept;
+    ~HistoryTailFollower() noexcept;
+
+    // Starts following from 'offset' bytes into the current file
+    void reset(unsigned long long offset);
+
+    // Live-follow: enable or disable change notifications
+    bool start_watch();
+    void stop_watch() noexcept;
+    bool watching() const noexcept { return watch_enabled; }
+
+    // Cheap check, safe to call every frame: true if the file may have new data
+    bool poll_changed();
+
+    // Appends everything written since the last read to 'out'. Returns the number of bytes added.
+    size_t read_new(std::string& out);
+
+    unsigned long long offset() const noexcept { return read_offset; }
+
+    // Disable copy and move operations; the object owns a notification handle
+    HistoryTailFollower(const HistoryTailFollower&) = delete;
+    HistoryTailFollower& operator=(const HistoryTailFollower&) = delete;
+    HistoryTailFollower(HistoryTailFollower&&) = delete;
+    HistoryTailFollower& operator=(HistoryTailFollower&&) = delete;
+
+    inline static constexpr std::chrono::milliseconds POLL_INTERVAL{500};
+
+private:
+    bool stat_file(unsigned long long& size, unsigned long long& identity) const;
+
+    std::string path;
+    unsigned long long read_offset = 0;
+    unsigned long long file_identity = 0; // Inode number where available, 0 otherwise
+    unsigned long long last_archived_id = 0; // Newest archived segment before the file being read
+    bool watch_enabled = false;
+    int notify_handle = -1;               // inotify descriptor (Linux only)
+    std::chrono::steady_clock::time_point last_poll{};
+};
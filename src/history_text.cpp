@@ -0,0 +1,134 @@
+#include "history_text.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring> // For std::memchr
+
+void HistoryText::clear() {
+    chunks.clear();
+    first_line.clear();
+    total_lines = 0;
+    total_bytes = 0;
+    if (pending.valid()) abandoned.push_back(std::move(pending));
+}
+
+void HistoryText::index_lines(Chunk& chunk, size_t from) {
+    const std::string& text = chunk.text;
+    if (from >= text.size()) return;
+    if (from == 0 || text[from - 1] == '\n') {
+        chunk.line_starts.push_back(static_cast<std::uint32_t>(from));
+    }
+    const char* base = text.data();
+    const char* cursor = base + from;
+    const char* end = base + text.size();
+    while (cursor < end) {
+        const void* found = std::memchr(cursor, '\n', static_cast<size_t>(end - cursor));
+        if (!found) break;
+        const char* next_line = static_cast<const char*>(found) + 1;
+        if (next_line < end) {
+            chunk.line_starts.push_back(static_cast<std::uint32_t>(next_line - base));
+        }
+        cursor = next_line;
+    }
+}
+
+void HistoryText::rebuild_line_table() {
+    first_line.resize(chunks.size());
+    total_lines = 0;
+    total_bytes = 0;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        first_line[i] = total_lines;
+        total_lines += chunks[i].line_starts.size();
+        total_bytes += chunks[i].text.size();
+    }
+}
+
+void HistoryText::append(std::string_view text) {
+    if (text.empty()) return;
+    if (chunks.empty() || chunks.back().text.size() + text.size() > MAX_CHUNK_BYTES) {
+        chunks.emplace_back();
+        first_line.push_back(total_lines);
+    }
+    Chunk& chunk = chunks.back();
+    const size_t old_lines = chunk.line_starts.size();
+    const size_t from = chunk.text.size();
+    chunk.text.append(text.data(), text.size());
+    index_lines(chunk, from);
+    total_lines += chunk.line_starts.size() - old_lines;
+    total_bytes += text.size();
+}
+
+bool HistoryText::prepend_async(std::function<bool(std::string&)> load) {
+    if (pending.valid()) return false;
+    pending = std::async(std::launch::async, [load = std::move(load)]() {
+        LoadResult result;
+        std::string text;
+        result.ok = load(text);
+        if (!result.ok) return result;
+
+        // Split oversized text at line boundaries so every chunk fits 32-bit offsets
+        size_t begin = 0;
+        while (begin < text.size()) {
+            size_t length = std::min(text.size() - begin, MAX_CHUNK_BYTES);
+            if (begin + length < text.size()) {
+                size_t cut = text.rfind('\n', begin + length - 1);
+                if (cut != std::string::npos && cut >= begin) length = cut + 1 - begin;
+            }
+            Chunk chunk;
+            chunk.text = (begin == 0 && length == text.size()) ? std::move(text) : text.substr(begin, length);
+            index_lines(chunk, 0);
+            begin += length;
+            result.chunks.push_back(std::move(chunk));
+        }
+        return result;
+    });
+    return true;
+}
+
+bool HistoryText::poll() {
+    abandoned.erase(std::remove_if(abandoned.begin(), abandoned.end(), [](const std::future<LoadResult>& load) {
+        return load.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }), abandoned.end());
+    if (!pending.valid() || pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return false;
+    }
+    LoadResult result = pending.get();
+    if (!result.ok) {
+        load_failed = true;
+        return false;
+    }
+    for (auto it = result.chunks.rbegin(); it != result.chunks.rend(); ++it) {
+        chunks.push_front(std::move(*it));
+    }
+    rebuild_line_table();
+    return true;
+}
+
+bool HistoryText::take_load_failure() noexcept {
+    bool failed = load_failed;
+    load_failed = false;
+    return failed;
+}
+
+std::string_view HistoryText::line(size_t index) const {
+    if (index >= total_lines) return {};
+    const size_t chunk_index = static_cast<size_t>(std::upper_bound(first_line.begin(), first_line.end(), index) - first_line.begin()) - 1;
+    const Chunk& chunk = chunks[chunk_index];
+    const size_t local = index - first_line[chunk_index];
+    const size_t begin = chunk.line_starts[local];
+    size_t end = (local + 1 < chunk.line_starts.size()) ? chunk.line_starts[local + 1] : chunk.text.size();
+    if (end > begin && chunk.text[end - 1] == '\n') --end;
+    return std::string_view(chunk.text).substr(begin, end - begin);
+}
+
+std::string HistoryText::join_lines(size_t first, size_t last) const {
+    std::string out;
+    if (total_lines == 0) return out;
+    last = std::min(last, total_lines - 1);
+    for (size_t i = first; i <= last; ++i) {
+        std::string_view text = line(i);
+        out.append(text.data(), text.size());
+        out += '\n';
+    }
+    return out;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef> // For size_t
+
+// Line-addressable history text for the virtualized History viewer. Text is held in chunks
+// (the active file plus any older segments the user loaded), each with the start offset of
+// every line, so row N is found without scanning. Appends index only the new bytes; larger
+// loads are indexed on a worker thread and spliced in front when poll() sees them finish.
+class HistoryText {
+public:
+    void clear();
+
+    // Appends newly logged text after everything loaded so far
+    void append(std::string_view text);
+
+    // Loads older text on a worker ('load' runs there too) and places it before the current
+    // text once indexed. Only one load runs at a time; returns false if one is still running.
+    // clear() abandons a running load (it finishes in the background and is discarded), so the
+    // first load after a clear() always starts.
+    bool prepend_async(std::function<bool(std::string&)> load);
+
+    // Splices in a finished background load. Returns true if the text changed.
+    bool poll();
+
+    bool loading() const noexcept { return pending.valid(); }
+    // True once after a background load reported failure
+    bool take_load_failure() noexcept;
+
+    size_t line_count() const noexcept { return total_lines; }
+    size_t byte_size() const noexcept { return total_bytes; }
+
+    // Line text without its '\n'. Valid until the next append/poll/clear.
+    std::string_view line(size_t index) const;
+
+    // Joins lines [first, last] with '\n' (for copying a selection)
+    std::string join_lines(size_t first, size_t last) const;
+
+private:
+    struct Chunk {
+        std::string text;
+        std::vector<std::uint32_t> line_starts;
+    };
+    struct LoadResult {
+        bool ok = false;
+        std::vector<Chunk> chunks;
+    };
+
+    static void index_lines(Chunk& chunk, size_t from);
+    void rebuild_line_table();
+
+    std::deque<Chunk> chunks;
+    std::vector<size_t> first_line; // first_line[i] = global index of chunk i's first line
+    size_t total_lines = 0;
+    size_t total_bytes = 0;
+    std::future<LoadResult> pending;
+    // Loads abandoned by clear(); kept until they finish, since dropping an std::async future blocks
+    std::vector<std::future<LoadResult>> abandoned;
+    bool load_failed = false;
+
+    // Chunks stay below this size so 32-bit line offsets suffice
+    inline static constexpr size_t MAX_CHUNK_BYTES = size_t(1) << 31;
+};
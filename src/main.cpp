@@ -1,9 +1,157 @@
 // src/main.cpp
 #include "application.h"
+#include "verifier.h"      // For the headless vault sweep
+#include "history_index.h" // For headless history queries
+#include "history_log.h"   // For HistoryLoggerConfig
+#include "vault.h"         // For VaultConfig
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <limits>  // For std::numeric_limits
+#include <cstdlib> // For std::strtoul, std::strtoull, std::strtod
+
+namespace {
+    // Durability of the history log, accepted ahead of any other arguments:
+    //   cipher_gui --history-fsync never|batch|interval[:MS] ...
+    // 'never' (the default) leaves flushing to the OS; 'batch' syncs after every write batch;
+    // 'interval' syncs at most once per MS milliseconds (default 1000).
+    bool apply_history_fsync(const std::string& value) {
+        HistoryLoggerConfig config;
+        if (value == "never") {
+            config.fsync_policy = FsyncPolicy::Never;
+        } else if (value == "batch") {
+            config.fsync_policy = FsyncPolicy::EveryBatch;
+        } else if (value.rfind("interval", 0) == 0) {
+            config.fsync_policy = FsyncPolicy::Interval;
+            if (value.size() > 8) {
+                char* end = nullptr;
+                unsigned long interval_ms = (value[8] == ':') ? std::strtoul(value.c_str() + 9, &end, 10) : 0;
+                if (value[8] != ':' || !end || *end != '\0' || interval_ms == 0) return false;
+                config.fsync_interval = std::chrono::milliseconds(interval_ms);
+            }
+        } else {
+            return false;
+        }
+        HistoryLogger::instance().configure(config);
+        return true;
+    }
+
+    // Vault packing (see VaultConfig), also accepted ahead of any other arguments:
+    //   cipher_gui --vault-pack-threshold BYTES ...  originals below BYTES are packed; 0 disables packing
+    //   cipher_gui --vault-sync-packs on|off ...     sync each pack append before the original is removed
+    //   cipher_gui --vault-repack-ratio R ...        rewrite packfiles once R (0 to 1] of them is garbage
+    bool apply_vault_option(const std::string& option, const std::string& value, VaultConfig& config) {
+        char* end = nullptr;
+        if (option == "--vault-pack-threshold") {
+            unsigned long long threshold = std::strtoull(value.c_str(), &end, 10);
+            if (value.empty() || value[0] == '-' || *end != '\0') return false;
+            config.pack_threshold = threshold;
+        } else if (option == "--vault-sync-packs") {
+            if (value != "on" && value != "off") return false;
+            config.sync_packs = (value == "on");
+        } else if (option == "--vault-repack-ratio") {
+            double ratio = std::strtod(value.c_str(), &end);
+            if (value.empty() || *end != '\0' || !(ratio > 0.0 && ratio <= 1.0)) return false;
+            config.repack_garbage_ratio = ratio;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Headless mode for scheduled jobs:
+    //   cipher_gui --verify-vault [--threads N] [--max-mbps N] [--report FILE]
+    // Exit code 0 means every vaulted original matched its encrypted counterpart.
+    int run_vault_sweep(int argc, char** argv) {
+        VaultSweepOptions options;
+        std::string report_path;
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--threads" && i + 1 < argc) {
+                options.threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+            } else if (arg == "--max-mbps" && i + 1 < argc) {
+                options.max_bytes_per_second = std::strtoull(argv[++i], nullptr, 10) * 1024ull * 1024ull;
+            } else if (arg == "--report" && i + 1 < argc) {
+                report_path = argv[++i];
+            } else {
+                std::cerr << "Unknown or incomplete argument: " << arg << '\n';
+                return 1;
+            }
+        }
+
+        VaultSweepReport report = sweep_vault(options);
+        std::string text = format_sweep_report(report);
+        std::cout << text;
+        if (!report_path.empty()) {
+            std::ofstream report_file(report_path, std::ios::trunc);
+            if (!(report_file << text)) {
+                std::cerr << "Error: Could not write report to '" << report_path << "'.\n";
+                return 1;
+            }
+        }
+        bool clean = !report.cancelled && report.mismatched == 0 && report.missing == 0 && report.errors == 0;
+        return clean ? 0 : 2;
+    }
+
+    // Headless history lookups answered from the structured log's indexes:
+    //   cipher_gui --history-find PATH_OR_FILENAME
+    //   cipher_gui --history-range "YYYY-MM-DD[ HH:MM:SS]" ["YYYY-MM-DD[ HH:MM:SS]"]
+    // Exit code 0 means at least one record was found.
+    int run_history_query(int argc, char** argv) {
+        const std::string mode = argv[1];
+        std::vector<HistoryRecord> records;
+        if (mode == "--history-find" && argc == 3) {
+            records = find_history_by_path(argv[2]);
+        } else if (mode == "--history-range" && (argc == 3 || argc == 4)) {
+            long long from_ms = 0;
+            long long to_ms = std::numeric_limits<long long>::max();
+            if (!parse_history_timestamp(argv[2], from_ms) || (argc == 4 && !parse_history_timestamp(argv[3], to_ms))) {
+                std::cerr << "Error: Dates must look like YYYY-MM-DD or \"YYYY-MM-DD HH:MM:SS\".\n";
+                return 1;
+            }
+            records = find_history_by_time(from_ms, to_ms);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " --history-find PATH | --history-range FROM [TO]\n";
+            return 1;
+        }
+        for (const HistoryRecord& record : records) {
+            std::cout << describe_history_record(record) << '\n';
+        }
+        return records.empty() ? 2 : 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    VaultConfig vault_config;
+    while (argc > 1) {
+        const std::string option = argv[1];
+        bool valid = false;
+        if (option == "--history-fsync") {
+            valid = argc >= 3 && apply_history_fsync(argv[2]);
+        } else if (option.rfind("--vault-", 0) == 0) {
+            valid = argc >= 3 && apply_vault_option(option, argv[2], vault_config);
+        } else {
+            break;
+        }
+        if (!valid) {
+            std::cerr << "Usage: " << argv[0] << " [--history-fsync never|batch|interval[:MS]]"
+                      << " [--vault-pack-threshold BYTES] [--vault-sync-packs on|off] [--vault-repack-ratio R] ...\n";
+            return 1;
+        }
+        argv[2] = argv[0]; // Drop the option; the remaining arguments are parsed as usual
+        argv += 2;
+        argc -= 2;
+    }
+    Vault::instance().configure(vault_config);
+    if (argc > 1 && std::string(argv[1]) == "--verify-vault") {
+        return run_vault_sweep(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]).rfind("--history-", 0) == 0) {
+        return run_history_query(argc, argv);
+    }
 
-int main() {
     std::cout << "Starting Cipher GUI Application..." << std::endl;
     Application app;
     return app.run();
-}
\ No newline at end of file
+}
@@ -0,0 +1,45 @@
+#include "op_metrics.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+    #include <windows.h> // For GetThreadTimes
+#else
+    #include <time.h>    // For clock_gettime, CLOCK_THREAD_CPUTIME_ID
+#endif
+
+unsigned long long thread_cpu_time_us() noexcept {
+#if defined(_WIN32) || defined(_WIN64)
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time)) return 0;
+    auto to_100ns = [](const FILETIME& time) {
+        return (static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    return (to_100ns(kernel_time) + to_100ns(user_time)) / 10;
+#else
+    timespec now{};
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0) return 0;
+    return static_cast<unsigned long long>(now.tv_sec) * 1000000ull + static_cast<unsigned long long>(now.tv_nsec) / 1000ull;
+#endif
+}
+
+double throughput_mb_s(unsigned long long bytes, unsigned long long duration_us) noexcept {
+    if (duration_us == 0) return 0.0;
+    return static_cast<double>(bytes) / static_cast<double>(duration_us); // Bytes per microsecond == MB/s
+}
+
+OperationTimer::OperationTimer() noexcept
+    : wall_start(std::chrono::steady_clock::now()),
+      cpu_start_us(thread_cpu_time_us()) {}
+
+unsigned long long OperationTimer::elapsed_us() const noexcept {
+    return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - wall_start).count());
+}
+
+void OperationTimer::stamp(HistoryRecord& record, unsigned long long bytes, const char* io_backend) const {
+    const unsigned long long cpu_now_us = thread_cpu_time_us();
+    record.bytes = bytes;
+    record.duration_us = elapsed_us();
+    record.cpu_us = (cpu_now_us >= cpu_start_us) ? cpu_now_us - cpu_start_us : 0;
+    record.throughput_mb_s = throughput_mb_s(bytes, record.duration_us);
+    record.io_backend = io_backend;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "history_index.h" // For HistoryRecord
+
+#include <chrono>
+
+// --- I/O Backends ---
+// Recorded with each measured operation so slow runs can be told apart from slow disks
+inline constexpr const char* IO_BACKEND_STREAM = "stream"; // Buffered std::fstream
+inline constexpr const char* IO_BACKEND_READ   = "read";   // read() into a reusable buffer
+inline constexpr const char* IO_BACKEND_MMAP   = "mmap";   // Memory-mapped file
+inline constexpr const char* IO_BACKEND_MEMORY = "memory"; // Data already in memory
+inline constexpr const char* IO_BACKEND_STAT   = "stat";   // Decided from metadata alone
+inline constexpr const char* IO_BACKEND_CLONE  = "clone";  // Reflink (FICLONE): blocks shared, nothing copied
+inline constexpr const char* IO_BACKEND_COPY_RANGE = "copy_range"; // copy_file_range (CopyFile on Windows), inside the kernel
+inline constexpr const char* IO_BACKEND_SENDFILE   = "sendfile";   // sendfile(), inside the kernel
+inline constexpr const char* IO_BACKEND_RENAME     = "rename";     // Moved by rename, not copied
+
+// CPU time consumed so far by the calling thread, in microseconds (0 if unavailable)
+unsigned long long thread_cpu_time_us() noexcept;
+
+// Decimal megabytes per second; 0 when no time was measured
+double throughput_mb_s(unsigned long long bytes, unsigned long long duration_us) noexcept;
+
+// Measures one operation on the calling thread: wall time on the monotonic clock and
+// the thread's CPU time. Starts timing on construction.
+class OperationTimer {
+public:
+    OperationTimer() noexcept;
+
+    unsigned long long elapsed_us() const noexcept;
+
+    // Fills the metric fields of 'record': bytes, wall and CPU time, MB/s and I/O backend
+    void stamp(HistoryRecord& record, unsigned long long bytes, const char* io_backend) const;
+
+private:
+    std::chrono::steady_clock::time_point wall_start;
+    unsigned long long cpu_start_us;
+};
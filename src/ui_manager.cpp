@@ -2,15 +2,21 @@
 
 // Note: No 'cipher_utils::' prefixes needed anymore.
 #include "cipher_utils.h"
+#include "history_log.h"
+#include "vault.h"
 
 #include <GLFW/glfw3.h> // For window operations (e.g., exit)
 #include "imgui.h"
-#include "imgui_stdlib.h" // For using std::string with ImGui::InputTextMultiline
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <cstdio>    // For std::snprintf
+#include <cstring>   // For std::strchr
+#include <cfloat>    // For FLT_MAX
+#include <iomanip>   // For std::setprecision
+#include <chrono>    // For std::chrono::seconds (future polling)
 #include <algorithm> // For std::clamp
 
 namespace {
@@ -32,6 +38,47 @@ namespace {
 
         std::streambuf* old_cerr_buf;
     };
+
+    // Formats the ranked peg candidates for the message area, e.g. "7 (next: 3, 12)"
+    std::string describe_peg_candidates(const PegRecoveryResult& recovery) {
+        std::ostringstream ss;
+        ss << "Most likely pegs: " << recovery.candidates.front().pegs;
+        if (recovery.candidates.size() > 1) {
+            ss << " (next:";
+            for (size_t i = 1; i < recovery.candidates.size() && i < 3; ++i) {
+                ss << (i > 1 ? ", " : " ") << recovery.candidates[i].pegs;
+            }
+            ss << ")";
+        }
+        ss << ". " << recovery.bytes_examined << " bytes examined" << (recovery.sampled ? " (sampled)." : ".");
+        return ss.str();
+    }
+
+    // "1.50 GiB" style sizes for the statistics tab
+    std::string format_byte_count(unsigned long long bytes) {
+        static const char* const UNITS[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+        double value = static_cast<double>(bytes);
+        size_t unit = 0;
+        while (value >= 1024.0 && unit + 1 < sizeof(UNITS) / sizeof(UNITS[0])) {
+            value /= 1024.0;
+            unit++;
+        }
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), unit == 0 ? "%.0f %s" : "%.2f %s", value, UNITS[unit]);
+        return buffer;
+    }
+
+    std::string format_duration(unsigned long long duration_us) {
+        char buffer[32];
+        if (duration_us < 1000) {
+            std::snprintf(buffer, sizeof(buffer), "%llu us", duration_us);
+        } else if (duration_us < 1000000) {
+            std::snprintf(buffer, sizeof(buffer), "%.2f ms", static_cast<double>(duration_us) / 1000.0);
+        } else {
+            std::snprintf(buffer, sizeof(buffer), "%.2f s", static_cast<double>(duration_us) / 1000000.0);
+        }
+        return buffer;
+    }
 } // namespace
 
 UIManager::UIManager()
@@ -42,12 +89,42 @@ UIManager::UIManager()
       gui_message("Welcome to Cipher GUI!"),
       gui_message_color(MSG_COLOR_INFO),
       pegs_value(MIN_PEG),
-      compare_modal_pegs_value(MIN_PEG)
+      compare_modal_pegs_value(MIN_PEG),
+      get_item_move_out(false),
+      history_selection_anchor(-1),
+      history_selection_end(-1),
+      history_scroll_to_end(false),
+      history_showing_search(false),
+      history_search_op_index(0),
+      history_search_pegs(0),
+      history_stats_ready(false),
+      history_older_loaded(0),
+      history_tail(HISTORY_FILE),
+      history_live_follow(false),
+      peg_job_for_compare(false),
+      diff_pegs_value(MIN_PEG),
+      diff_report_pegs(MIN_PEG),
+      diff_selected_range(-1),
+      line_diff_job_range(-1)
 {
     clear_all_persistent_state();
     go_to_screen(Screen::MainMenu);
 }
 
+UIManager::~UIManager() {
+    // Ask a running verification to stop; the future's destructor then joins it
+    if (verify_progress) {
+        verify_progress->cancel_requested = true;
+    }
+    if (diff_progress) {
+        diff_progress->cancel_requested = true;
+    }
+    if (sweep_progress) {
+        sweep_progress->cancel_requested = true;
+    }
+    cancel_history_search();
+}
+
 bool UIManager::is_modal_active() const noexcept {
     return current_modal != Modal::None;
 }
@@ -61,18 +138,46 @@ void UIManager::clear_all_persistent_state() {
     admin_password_buf[0] = '\0';
     compare_modal_vault_filename_buf[0] = '\0';
     compare_modal_external_enc_filepath_buf[0] = '\0';
+    diff_vault_filename_buf[0] = '\0';
+    diff_external_filepath_buf[0] = '\0';
+    history_search_text_buf[0] = '\0';
+    history_search_path_buf[0] = '\0';
+    history_search_from_buf[0] = '\0';
+    history_search_to_buf[0] = '\0';
+    history_search_op_index = 0;
+    history_search_pegs = 0;
 
     pegs_value = MIN_PEG;
     compare_modal_pegs_value = MIN_PEG;
-    history_content_buf.clear();
+    diff_pegs_value = MIN_PEG;
+    history_text.clear();
+    history_selection_anchor = history_selection_end = -1;
+    history_tail.stop_watch();
+    cancel_history_search();
+    history_search_results.clear();
+    history_showing_search = false;
+    history_live_follow = false;
+    diff_report = DiffReport{};
+    diff_first_excerpt = TextCompareExcerpt{};
+    diff_selected_range = -1;
+    diff_selected_lines.clear();
+    line_diff_job_range = -1;
 }
 
 std::pair<ImVec2, float> UIManager::draw_ui(GLFWwindow* window) {
+    poll_verify_job();
+    poll_peg_job();
+    poll_diff_job();
+    poll_line_diff_job();
+    poll_sweep_job();
+    poll_history_search();
+
     // --- Handle Modals ---
     if (current_modal == Modal::AdminPasswordPrompt) {
         std::string prompt_msg = "Admin privileges required.";
         if (screen_requiring_password == Screen::History) prompt_msg = "Access to Operation History requires Admin password.";
         else if (screen_requiring_password == Screen::GetItem) prompt_msg = "Access to Retrieve Original File requires Admin password.";
+        else if (screen_requiring_password == Screen::Compare) prompt_msg = "Showing differences against vault originals requires Admin password.";
         draw_admin_password_prompt_modal(prompt_msg);
     } else if (current_modal == Modal::CompareFilesPrompt) {
         draw_compare_files_modal();
@@ -120,16 +225,42 @@ std::pair<ImVec2, float> UIManager::draw_ui(GLFWwindow* window) {
             };
             AdminRestrictedMenuItem("Retrieve Original File", Screen::GetItem, "Cmd+R");
             AdminRestrictedMenuItem("View History", Screen::History, "Cmd+H");
+            AdminRestrictedMenuItem("Show Differences", Screen::Compare); // Shows vault originals' plaintext
             ImGui::EndMenu();
         }
         if (ImGui::BeginMenu("Admin")) {
             if (admin_access_granted) {
+                if (ImGui::MenuItem("Verify Whole Vault", nullptr, false, !sweep_job.valid())) {
+                    sweep_progress = std::make_shared<SweepProgress>();
+                    std::shared_ptr<SweepProgress> progress = sweep_progress;
+                    sweep_job = std::async(std::launch::async, [progress]() {
+                        return sweep_vault(VaultSweepOptions{}, progress.get());
+                    });
+                    set_main_gui_message("Vault sweep started...", MSG_COLOR_INFO);
+                }
+                const bool deduplicating = Vault::instance().content_addressed();
+                if (ImGui::MenuItem("Deduplicate Vault Storage", nullptr, deduplicating)) {
+                    if (Vault::instance().set_content_addressed(!deduplicating)) {
+                        set_main_gui_message(deduplicating ? "New vault entries will be stored by name."
+                                                           : "New vault entries will be stored once per distinct content.",
+                                             MSG_COLOR_INFO);
+                    } else {
+                        set_main_gui_message("Could not change the vault storage mode.", MSG_COLOR_ERROR);
+                    }
+                }
                 if (ImGui::MenuItem("Logout Admin")) {
                     admin_access_granted = false;
                     set_main_gui_message("Admin logged out.", MSG_COLOR_INFO);
-                    if (current_screen == Screen::History || current_screen == Screen::GetItem) {
+                    if (current_screen == Screen::History || current_screen == Screen::GetItem || current_screen == Screen::Compare) {
                         go_to_screen(Screen::MainMenu);
                     }
+                    // The diff viewer holds vault plaintext; drop it with the access
+                    diff_report = DiffReport{};
+                    diff_first_excerpt = TextCompareExcerpt{};
+                    diff_report_vault_file.reset();
+                    diff_selected_range = -1;
+                    diff_selected_lines.clear();
+                    line_diff_job_range = -1;
                 }
             } else {
                 if (ImGui::MenuItem("Login Admin", "Cmd+L")) {
@@ -172,10 +303,7 @@ std::pair<ImVec2, float> UIManager::draw_ui(GLFWwindow* window) {
                 content_size = draw_get_item_screen();
                 break;
             case Screen::Compare:
-                // This screen is now effectively just a placeholder, as a modal is used
-                ImGui::TextWrapped("File comparison is handled via the modal dialog under 'Navigation -> Verify Encrypted File'.");
-                if (ImGui::Button("Back to Main Menu")) { go_to_screen(Screen::MainMenu); }
-                content_size = { 400, 100 };
+                content_size = draw_compare_files_screen();
                 break;
             case Screen::History:
                 content_size = draw_history_screen();
@@ -209,6 +337,7 @@ void UIManager::go_to_screen(Screen screen) {
         case Screen::GetItem:
             get_item_filename_buf[0] = '\0';
             get_item_destination_buf[0] = '\0';
+            get_item_move_out = false;
             break;
         case Screen::History:
             if (admin_access_granted) {
@@ -230,19 +359,350 @@ void UIManager::set_main_gui_message(const std::string& message, const ImVec4& c
 }
 
 void UIManager::load_history_content() {
-    std::ifstream ifs(HISTORY_FILE);
+    HistoryLogger::instance().flush(); // Make sure queued records are on disk first
+    // Only the active segment is read; older ones are loaded on request
+    history_segments = load_history_manifest();
+    history_older_loaded = 0;
+    history_text.clear();
+    history_selection_anchor = history_selection_end = -1;
+    history_stats_taken = {}; // The Stats tab takes a fresh snapshot on its next frame
+    std::ifstream ifs(HISTORY_FILE, std::ios::binary);
     if (ifs) {
         std::stringstream ss;
         ss << ifs.rdbuf();
-        history_content_buf = ss.str();
-        if (history_content_buf.empty()) {
-            history_content_buf = "History is empty.";
+        std::string content = ss.str();
+        history_tail.reset(content.size()); // Later refreshes read only what follows
+        // The line index is built on a worker; rows appear once poll_history_loads() sees it
+        history_text.prepend_async([content = std::move(content)](std::string& out) mutable {
+            out = std::move(content);
+            return true;
+        });
+    } else {
+        history_tail.reset(0);
+    }
+}
+
+size_t UIManager::refresh_history_tail(bool flush_logger) {
+    if (flush_logger) {
+        HistoryLogger::instance().flush();
+    }
+    std::string appended;
+    if (history_tail.read_new(appended) == 0) {
+        return 0;
+    }
+    history_text.append(appended);
+    history_scroll_to_end = true;
+    // A rotation archives text that is already on screen, so it counts as loaded
+    const size_t previous_segment_count = history_segments.size();
+    history_segments = load_history_manifest();
+    if (history_segments.size() > previous_segment_count) {
+        history_older_loaded += history_segments.size() - previous_segment_count;
+    }
+    return appended.size();
+}
+
+void UIManager::load_older_history_segment() {
+    if (history_older_loaded >= history_segments.size()) {
+        return;
+    }
+    const HistorySegmentInfo segment = history_segments[history_segments.size() - 1 - history_older_loaded];
+    if (!history_text.prepend_async([segment](std::string& out) { return read_history_segment(segment, out); })) {
+        return; // Another load is still being indexed
+    }
+    history_older_loaded++;
+    set_main_gui_message("Loading history from " + format_history_timestamp(segment.first_timestamp_ms) + " to " +
+                         format_history_timestamp(segment.last_timestamp_ms) + "...", MSG_COLOR_INFO);
+}
+
+void UIManager::poll_history_loads() {
+    if (history_text.poll()) {
+        // Line indices shift once older lines are spliced in front
+        history_selection_anchor = history_selection_end = -1;
+    }
+    if (history_text.take_load_failure()) {
+        history_older_loaded--; // The segment can be requested again
+        set_main_gui_message("Error: Could not read an older history segment.", MSG_COLOR_ERROR);
+    }
+}
+
+void UIManager::copy_history_selection() {
+    if (history_selection_anchor < 0) {
+        return;
+    }
+    size_t first = static_cast<size_t>(std::min(history_selection_anchor, history_selection_end));
+    size_t last = static_cast<size_t>(std::max(history_selection_anchor, history_selection_end));
+    if (last - first + 1 > MAX_HISTORY_COPY_LINES) {
+        last = first + MAX_HISTORY_COPY_LINES - 1;
+        set_main_gui_message("Copied the first " + std::to_string(MAX_HISTORY_COPY_LINES) + " selected lines.", MSG_COLOR_WARNING);
+    } else {
+        set_main_gui_message("Copied " + std::to_string(last - first + 1) + " line(s).", MSG_COLOR_INFO);
+    }
+    ImGui::SetClipboardText(visible_history_lines().join_lines(first, last).c_str());
+}
+
+const HistoryText& UIManager::visible_history_lines() const {
+    return history_showing_search ? history_search_results : history_text;
+}
+
+void UIManager::start_history_search() {
+    HistorySearchQuery query;
+    query.text = history_search_text_buf;
+    query.path = history_search_path_buf;
+    if (history_search_op_index > 0) {
+        query.op = HISTORY_SEARCH_OPS[history_search_op_index];
+    }
+    query.pegs = history_search_pegs;
+    if (history_search_from_buf[0] != '\0' && !parse_history_timestamp(history_search_from_buf, query.from_ms)) {
+        set_main_gui_message("Error: 'From' must be YYYY-MM-DD or YYYY-MM-DD HH:MM:SS.", MSG_COLOR_ERROR);
+        return;
+    }
+    if (history_search_to_buf[0] != '\0') {
+        if (!parse_history_timestamp(history_search_to_buf, query.to_ms)) {
+            set_main_gui_message("Error: 'To' must be YYYY-MM-DD or YYYY-MM-DD HH:MM:SS.", MSG_COLOR_ERROR);
+            return;
+        }
+        // The end bound is inclusive: a bare date covers that whole day, a time that whole second
+        query.to_ms += (std::strchr(history_search_to_buf, ':') == nullptr) ? 24LL * 60 * 60 * 1000 - 1 : 999;
+    }
+
+    cancel_history_search();
+    history_search_results.clear();
+    history_selection_anchor = history_selection_end = -1;
+    if (history_search_query_is_empty(query)) {
+        history_showing_search = false; // Nothing to filter by: back to the full log
+        set_main_gui_message("Showing the full history.", MSG_COLOR_INFO);
+        return;
+    }
+    history_showing_search = true;
+    history_search_stream = std::make_shared<HistorySearchStream>();
+    auto stream = history_search_stream;
+    history_search_job = std::async(std::launch::async, [query, stream]() {
+        return search_history(query, *stream);
+    });
+}
+
+void UIManager::cancel_history_search() {
+    if (history_search_stream) {
+        history_search_stream->cancel_requested = true;
+    }
+}
+
+void UIManager::poll_history_search() {
+    if (!history_search_job.valid()) {
+        return;
+    }
+    // Check for completion before draining so no batch published before the end is missed
+    const bool finished = history_search_job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    std::string matches;
+    if (history_search_stream->take(matches) > 0) {
+        history_search_results.append(matches);
+    }
+    if (!finished) {
+        unsigned long long total = history_search_stream->bytes_total;
+        unsigned long long done = history_search_stream->bytes_done;
+        std::ostringstream progress_ss;
+        progress_ss << "Searching history... " << (total > 0 ? done * 100 / total : 0) << "% ("
+                    << history_search_stream->match_count << " matches so far)";
+        set_main_gui_message(progress_ss.str(), MSG_COLOR_INFO);
+        return;
+    }
+
+    HistorySearchSummary summary = history_search_job.get();
+    history_search_stream.reset();
+    std::ostringstream summary_ss;
+    if (!summary.log_readable) {
+        set_main_gui_message("Error: Could not open the structured history log (" + HISTORY_LOG_FILE + ").", MSG_COLOR_ERROR);
+        return;
+    }
+    if (summary.cancelled) {
+        summary_ss << "Search cancelled after " << summary.match_count << " match(es).";
+    } else if (summary.truncated) {
+        summary_ss << "Showing the first " << summary.match_count << " matches; narrow the search to see the rest.";
+    } else {
+        summary_ss << "Found " << summary.match_count << " matching record(s) in "
+                   << std::fixed << std::setprecision(1) << (static_cast<double>(summary.bytes_scanned) / (1024.0 * 1024.0))
+                   << " MB of history" << (summary.used_time_index ? " (date range located via the time index)." : ".");
+    }
+    set_main_gui_message(summary_ss.str(), (summary.cancelled || summary.truncated || summary.match_count == 0) ? MSG_COLOR_WARNING : MSG_COLOR_SUCCESS);
+}
+
+void UIManager::draw_history_lines(float bottom_elements_height) {
+    ImGui::BeginChild("##HistoryLines", {-1, -bottom_elements_height}, ImGuiChildFlags_Borders, ImGuiWindowFlags_HorizontalScrollbar);
+    const HistoryText& lines = visible_history_lines();
+    const size_t line_count = lines.line_count();
+    if (line_count == 0) {
+        if (history_showing_search) {
+            ImGui::TextUnformatted(history_search_job.valid() ? "Searching..." : "No matching records.");
+        } else {
+            ImGui::TextUnformatted(history_text.loading() ? "Loading history..." : "History is empty.");
+        }
+    }
+
+    // Only the rows in view are submitted, so cost per frame is independent of log size
+    const bool was_at_bottom = ImGui::GetScrollY() >= ImGui::GetScrollMaxY();
+    const long long selection_first = std::min(history_selection_anchor, history_selection_end);
+    const long long selection_last = std::max(history_selection_anchor, history_selection_end);
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    const ImU32 text_color = ImGui::GetColorU32(ImGuiCol_Text);
+    int first_visible = -1;
+    int last_visible = -1;
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(line_count));
+    while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+            const std::string_view text = lines.line(static_cast<size_t>(i));
+            const char* text_end = text.data() + text.size();
+            const bool selected = history_selection_anchor >= 0 && i >= selection_first && i <= selection_last;
+            const ImVec2 row_pos = ImGui::GetCursorScreenPos();
+            const float row_width = std::max(ImGui::GetContentRegionAvail().x, ImGui::CalcTextSize(text.data(), text_end).x);
+
+            ImGui::PushID(i);
+            if (ImGui::Selectable("##HistoryRow", selected, ImGuiSelectableFlags_None, {row_width, ImGui::GetTextLineHeight()})) {
+                if (ImGui::GetIO().KeyShift && history_selection_anchor >= 0) {
+                    history_selection_end = i;
+                } else {
+                    history_selection_anchor = history_selection_end = i;
+                }
+            }
+            ImGui::PopID();
+            draw_list->AddText(row_pos, text_color, text.data(), text_end);
+
+            if (ImGui::IsItemVisible()) {
+                if (first_visible < 0) first_visible = i;
+                last_visible = i;
+            }
         }
+    }
+
+    if (ImGui::IsWindowFocused()) {
+        if (ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_A) && first_visible >= 0) {
+            history_selection_anchor = first_visible;
+            history_selection_end = last_visible;
+        }
+        if (ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_C)) {
+            copy_history_selection();
+        }
+    }
+    if (history_scroll_to_end && was_at_bottom && !history_showing_search) {
+        ImGui::SetScrollHereY(1.0f); // Keep following new lines unless the user scrolled up
+    }
+    history_scroll_to_end = false;
+    ImGui::EndChild();
+}
+
+void UIManager::poll_verify_job() {
+    if (!verify_job.valid()) {
+        return;
+    }
+    if (verify_job.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        unsigned long long total = verify_progress->bytes_total;
+        unsigned long long done = verify_progress->bytes_done;
+        std::ostringstream progress_ss;
+        progress_ss << "Verifying full files... " << (total > 0 ? done * 100 / total : 0) << "%";
+        set_main_gui_message(progress_ss.str(), MSG_COLOR_INFO);
+        return;
+    }
+
+    StreamVerifyResult res = verify_job.get();
+    verify_progress.reset();
+    if (!res.files_readable || res.cancelled) {
+        set_main_gui_message("Verification failed: " + res.error_message, MSG_COLOR_ERROR);
+        return;
+    }
+
+    std::ostringstream result_ss;
+    result_ss.precision(2);
+    result_ss << "Verification Result: Match: " << std::fixed << res.match_percentage << "%.";
+    if (res.first_diff_offset != -1) {
+        result_ss << " First diff at offset: " << res.first_diff_offset << ".";
+        result_ss << " Mismatched bytes: " << res.mismatch_count << " of " << std::max(res.plain_size, res.cipher_size) << ".";
+        result_ss << " Use 'Navigation -> Show Differences' to list them.";
     } else {
-        history_content_buf = "Error: Could not open history file: " + HISTORY_FILE;
+        result_ss << " Contents are identical (" << res.cipher_size << " bytes).";
+    }
+    set_main_gui_message(result_ss.str(), (res.mismatch_count == 0) ? MSG_COLOR_SUCCESS : MSG_COLOR_WARNING);
+}
+
+void UIManager::poll_peg_job() {
+    if (!peg_job.valid() || peg_job.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    PegRecoveryResult recovery = peg_job.get();
+    if (!recovery.success) {
+        set_main_gui_message("Peg detection failed: " + recovery.error_message, MSG_COLOR_ERROR);
+        return;
+    }
+    (peg_job_for_compare ? compare_modal_pegs_value : pegs_value) = recovery.candidates.front().pegs;
+    set_main_gui_message(describe_peg_candidates(recovery), MSG_COLOR_INFO);
+}
+
+void UIManager::poll_diff_job() {
+    if (!diff_job.valid() || diff_job.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    diff_report = diff_job.get();
+    diff_progress.reset();
+    if (!admin_access_granted) { // Logged out while it ran
+        diff_report = DiffReport{};
+        diff_report_vault_file.reset();
+        return;
+    }
+    diff_selected_range = -1;
+    diff_selected_lines.clear();
+    line_diff_job_range = -1; // A line diff still running belongs to the previous report
+    if (!diff_report.files_readable || diff_report.cancelled) {
+        set_main_gui_message("Diff failed: " + diff_report.error_message, MSG_COLOR_ERROR);
+    } else if (diff_report.mismatch_count == 0) {
+        set_main_gui_message("No differences found.", MSG_COLOR_SUCCESS);
+    } else {
+        if (!diff_report.ranges.empty()) {
+            diff_first_excerpt = diff_excerpt_at(diff_report_vault_file->path(), diff_report_path2, diff_report_pegs,
+                                                 diff_report.ranges.front().offset);
+        }
+        set_main_gui_message("Differences found. Select a range to see its line diff.", MSG_COLOR_WARNING);
+    }
+}
+
+// Reads and diffs the selected range on a worker; a range click only records the selection
+void UIManager::start_line_diff_job() {
+    const MismatchRange range = diff_report.ranges[static_cast<size_t>(diff_selected_range)];
+    std::shared_ptr<VaultEntryFile> vault_file = diff_report_vault_file;
+    std::string external_path = diff_report_path2;
+    int pegs = diff_report_pegs;
+    line_diff_job_range = diff_selected_range;
+    line_diff_job = std::async(std::launch::async, [vault_file, external_path, pegs, range]() {
+        return line_diff_for_range(vault_file->path(), external_path, pegs, range);
+    });
+}
+
+void UIManager::poll_line_diff_job() {
+    if (!line_diff_job.valid() || line_diff_job.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    std::vector<LineDiffLine> lines = line_diff_job.get();
+    if (line_diff_job_range == diff_selected_range) {
+        diff_selected_lines = std::move(lines);
+    } else if (diff_selected_range >= 0) {
+        start_line_diff_job(); // The selection moved on while this one ran
     }
 }
 
+void UIManager::poll_sweep_job() {
+    if (!sweep_job.valid()) {
+        return;
+    }
+    if (sweep_job.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        std::ostringstream progress_ss;
+        progress_ss << "Verifying vault... " << sweep_progress->entries_done << " of " << sweep_progress->entries_total << " files.";
+        set_main_gui_message(progress_ss.str(), MSG_COLOR_INFO);
+        return;
+    }
+    VaultSweepReport report = sweep_job.get();
+    sweep_progress.reset();
+    bool clean = !report.cancelled && report.mismatched == 0 && report.missing == 0 && report.errors == 0;
+    set_main_gui_message(format_sweep_report(report), clean ? MSG_COLOR_SUCCESS : MSG_COLOR_WARNING);
+}
+
 void UIManager::request_admin_access_for_screen(Screen target_screen) {
     screen_requiring_password = target_screen;
     current_modal = Modal::AdminPasswordPrompt;
@@ -269,6 +729,7 @@ ImVec2 UIManager::draw_main_menu_screen() {
         {"Decrypt File",           Screen::Decrypt,  Modal::None,                false},
         {"Retrieve Original File", Screen::GetItem,  Modal::None,                true},
         {"Verify Encrypted File",  Screen::MainMenu, Modal::CompareFilesPrompt,  false},
+        {"Show Differences",       Screen::Compare,  Modal::None,                true},
         {"View History",           Screen::History,  Modal::None,                true}
     };
 
@@ -310,6 +771,18 @@ ImVec2 UIManager::draw_encrypt_decrypt_screen(bool is_encrypt_mode) {
     pegs_value = std::clamp(pegs_value, MIN_PEG, MAX_PEG);
     ImGui::PopItemWidth();
 
+    if (!is_encrypt_mode) {
+        ImGui::BeginDisabled(peg_job.valid());
+        if (ImGui::Button(peg_job.valid() ? "Detecting Pegs..." : "Detect Pegs From Input File")) {
+            // One histogram pass over the ciphertext scores every candidate shift; poll_peg_job() applies it
+            std::string cipher_path(input_file_path_buf);
+            peg_job_for_compare = false;
+            peg_job = std::async(std::launch::async, [cipher_path]() { return recover_pegs(cipher_path); });
+            set_main_gui_message("Detecting pegs...", MSG_COLOR_INFO);
+        }
+        ImGui::EndDisabled();
+    }
+
     ImGui::Dummy({0, 10.0f});
 
     float button_width = (ImGui::GetContentRegionAvail().x - ImGui::GetStyle().ItemSpacing.x) / 2.0f;
@@ -351,6 +824,7 @@ ImVec2 UIManager::draw_get_item_screen() {
     ImGui::InputTextWithHint("##GetItemFilename", "Filename in Vault (e.g., original.txt)", get_item_filename_buf, sizeof(get_item_filename_buf));
     ImGui::InputTextWithHint("##GetItemDest", "Full Destination Path (e.g., C:\\Users\\user\\Desktop\\retrieved.txt)", get_item_destination_buf, sizeof(get_item_destination_buf));
     ImGui::PopItemWidth();
+    ImGui::Checkbox("Move out of the vault (no copy is kept)", &get_item_move_out);
     ImGui::Dummy({0, 10.0f});
 
     float button_width = (ImGui::GetContentRegionAvail().x - ImGui::GetStyle().ItemSpacing.x) / 2.0f;
@@ -361,7 +835,7 @@ ImVec2 UIManager::draw_get_item_screen() {
         } else {
             std::ostringstream captured_output;
             CerrRedirect redirect(captured_output.rdbuf());
-            bool success = retrieve_from_vault(get_item_filename_buf, get_item_destination_buf);
+            bool success = retrieve_from_vault(get_item_filename_buf, get_item_destination_buf, !get_item_move_out);
             std::string op_msg = captured_output.str();
             if (success) {
                 set_main_gui_message("File retrieval successful!" + (op_msg.empty() ? "" : "\nLog:\n" + op_msg), MSG_COLOR_SUCCESS);
@@ -384,20 +858,315 @@ ImVec2 UIManager::draw_history_screen() {
     ImGui::TextUnformatted("Operation History");
     ImGui::Separator();
 
+    if (ImGui::BeginTabBar("##HistoryTabs")) {
+        if (ImGui::BeginTabItem("Log")) {
+            draw_history_log_tab();
+            ImGui::EndTabItem();
+        }
+        if (ImGui::BeginTabItem("Stats")) {
+            draw_history_stats_tab();
+            ImGui::EndTabItem();
+        }
+        ImGui::EndTabBar();
+    }
+
+    return {HISTORY_MIN_CONTENT_WIDTH, std::max(HISTORY_MIN_CONTENT_HEIGHT, ImGui::GetCursorPosY())};
+}
+
+void UIManager::draw_history_log_tab() {
+    // Search and filter: the scan runs on a worker and matches stream into the viewer below
+    const float search_button_width = 90.0f;
+    ImGui::PushItemWidth(-(2.0f * search_button_width + 2.0f * ImGui::GetStyle().ItemSpacing.x));
+    bool search_submitted = ImGui::InputTextWithHint("##HistorySearchText", "Search text (case-sensitive)", history_search_text_buf,
+                                                     sizeof(history_search_text_buf), ImGuiInputTextFlags_EnterReturnsTrue);
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    if (history_search_job.valid()) {
+        if (ImGui::Button("Cancel", {search_button_width, 0})) {
+            cancel_history_search();
+        }
+    } else if (ImGui::Button("Search", {search_button_width, 0})) {
+        search_submitted = true;
+    }
+    ImGui::SameLine();
+    ImGui::BeginDisabled(!history_showing_search);
+    if (ImGui::Button("Show All", {search_button_width, 0})) {
+        cancel_history_search();
+        history_showing_search = false;
+        history_selection_anchor = history_selection_end = -1;
+    }
+    ImGui::EndDisabled();
+
+    ImGui::SetNextItemWidth(HISTORY_SEARCH_OP_WIDTH);
+    ImGui::Combo("##HistorySearchOp", &history_search_op_index, HISTORY_SEARCH_OPS, IM_ARRAYSIZE(HISTORY_SEARCH_OPS));
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(HISTORY_SEARCH_FIELD_WIDTH);
+    ImGui::InputInt("Pegs##HistorySearchPegs", &history_search_pegs);
+    ImGui::SetItemTooltip("0 matches any peg count");
+    history_search_pegs = std::clamp(history_search_pegs, 0, MAX_PEG);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(HISTORY_SEARCH_FIELD_WIDTH);
+    search_submitted |= ImGui::InputTextWithHint("##HistorySearchFrom", "From YYYY-MM-DD", history_search_from_buf,
+                                                 sizeof(history_search_from_buf), ImGuiInputTextFlags_EnterReturnsTrue);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(HISTORY_SEARCH_FIELD_WIDTH);
+    search_submitted |= ImGui::InputTextWithHint("##HistorySearchTo", "To YYYY-MM-DD", history_search_to_buf,
+                                                 sizeof(history_search_to_buf), ImGuiInputTextFlags_EnterReturnsTrue);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(-1);
+    search_submitted |= ImGui::InputTextWithHint("##HistorySearchPath", "Path contains", history_search_path_buf,
+                                                 sizeof(history_search_path_buf), ImGuiInputTextFlags_EnterReturnsTrue);
+    if (search_submitted) {
+        start_history_search();
+    }
+
+    // Live follow: append whatever the logger wrote since the last frame that saw a change
+    poll_history_loads();
+    if (history_live_follow && history_tail.poll_changed()) {
+        refresh_history_tail(false);
+    }
+
     float bottom_elements_height = ImGui::GetFrameHeightWithSpacing() + ImGui::GetStyle().ItemSpacing.y;
-    ImGui::InputTextMultiline("##HistoryContent", &history_content_buf, {-1, -bottom_elements_height}, ImGuiInputTextFlags_ReadOnly);
+    draw_history_lines(bottom_elements_height);
 
-    float button_width = (ImGui::GetContentRegionAvail().x - ImGui::GetStyle().ItemSpacing.x) / 2.0f;
+    if (ImGui::Checkbox("Live Follow", &history_live_follow)) {
+        if (history_live_follow) {
+            history_tail.start_watch();
+            refresh_history_tail(true); // Catch up on anything logged before the watch existed
+        } else {
+            history_tail.stop_watch();
+        }
+    }
+    ImGui::SameLine();
+    float button_width = (ImGui::GetContentRegionAvail().x - 3.0f * ImGui::GetStyle().ItemSpacing.x) / 4.0f;
     if (ImGui::Button("Refresh History", {button_width, 0})) {
-        load_history_content();
-        set_main_gui_message("History refreshed.", MSG_COLOR_INFO);
+        size_t new_bytes = refresh_history_tail(true);
+        set_main_gui_message("History refreshed (" + std::to_string(new_bytes) + " new bytes).", MSG_COLOR_INFO);
+    }
+    ImGui::SameLine();
+    ImGui::BeginDisabled(history_older_loaded >= history_segments.size() || history_text.loading());
+    if (ImGui::Button("Load Older", {button_width, 0})) {
+        load_older_history_segment();
+    }
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    ImGui::BeginDisabled(history_selection_anchor < 0);
+    if (ImGui::Button("Copy Selection", {button_width, 0})) {
+        copy_history_selection();
     }
+    ImGui::EndDisabled();
     ImGui::SameLine();
     if (ImGui::Button("Back to Main Menu", {button_width, 0})) {
         go_to_screen(Screen::MainMenu);
     }
+}
 
-    return {HISTORY_MIN_CONTENT_WIDTH, std::max(HISTORY_MIN_CONTENT_HEIGHT, ImGui::GetCursorPosY())};
+void UIManager::draw_history_stats_tab() {
+    // The logger keeps the aggregates up to date; this only copies a fixed-size snapshot
+    const auto now = std::chrono::steady_clock::now();
+    if (now - history_stats_taken >= HISTORY_STATS_REFRESH_INTERVAL) {
+        history_stats_ready = HistoryLogger::instance().stats_snapshot(history_stats);
+        history_stats_taken = now;
+    }
+    const HistoryStats& stats = history_stats;
+
+    float bottom_elements_height = ImGui::GetFrameHeightWithSpacing() + ImGui::GetStyle().ItemSpacing.y;
+    ImGui::BeginChild("##HistoryStats", {-1, -bottom_elements_height}, ImGuiChildFlags_Borders);
+    if (!history_stats_ready) {
+        ImGui::TextColored(MSG_COLOR_WARNING, "Still reading older history; figures are incomplete.");
+    }
+    ImGui::Text("Records: %llu", stats.record_count);
+    ImGui::Text("Encrypted: %llu file(s), %s", stats.encrypt_count, format_byte_count(stats.bytes_encrypted).c_str());
+    ImGui::Text("Decrypted: %llu file(s), %s", stats.decrypt_count, format_byte_count(stats.bytes_decrypted).c_str());
+
+    ImGui::SeparatorText("Operations per day (UTC)");
+    float ops_per_day[HISTORY_STATS_PLOT_DAYS] = {};
+    float peak = 0.0f;
+    const long long latest_day = stats.latest_day();
+    for (size_t i = 0; i < HISTORY_STATS_PLOT_DAYS && latest_day >= 0; ++i) {
+        const HistoryDayStats* day = stats.day_stats(latest_day - static_cast<long long>(HISTORY_STATS_PLOT_DAYS - 1 - i));
+        ops_per_day[i] = day ? static_cast<float>(day->operations) : 0.0f;
+        peak = std::max(peak, ops_per_day[i]);
+    }
+    char overlay[64];
+    std::snprintf(overlay, sizeof(overlay), "last %zu days, peak %.0f", HISTORY_STATS_PLOT_DAYS, peak);
+    ImGui::PlotHistogram("##OpsPerDay", ops_per_day, static_cast<int>(HISTORY_STATS_PLOT_DAYS), 0, overlay, 0.0f, FLT_MAX,
+                         {-1, HISTORY_STATS_PLOT_HEIGHT});
+
+    ImGui::SeparatorText("Durations");
+    if (ImGui::BeginTable("##HistoryDurations", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Operation");
+        ImGui::TableSetupColumn("Samples");
+        ImGui::TableSetupColumn("p50");
+        ImGui::TableSetupColumn("p95");
+        ImGui::TableSetupColumn("p99");
+        ImGui::TableHeadersRow();
+        const std::pair<const char*, HistoryStatsKind> rows[] = {
+            {"ENCRYPT", HistoryStatsKind::Encrypt}, {"DECRYPT", HistoryStatsKind::Decrypt}, {"Other", HistoryStatsKind::Other}};
+        for (const auto& row : rows) {
+            const HistoryDurationHistogram& histogram = stats.histogram(row.second);
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(row.first);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", histogram.samples);
+            for (double fraction : {0.50, 0.95, 0.99}) {
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(histogram.samples > 0 ? format_duration(histogram.percentile_us(fraction)).c_str() : "-");
+            }
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::SeparatorText("Throughput of recent encryptions and decryptions (MB/s)");
+    if (stats.throughput_count > 0) {
+        const bool ring_full = stats.throughput_count == HistoryStats::THROUGHPUT_SAMPLES;
+        const size_t newest = (stats.throughput_next + HistoryStats::THROUGHPUT_SAMPLES - 1) % HistoryStats::THROUGHPUT_SAMPLES;
+        std::snprintf(overlay, sizeof(overlay), "latest %.1f MB/s", stats.throughput_mb_s[newest]);
+        ImGui::PlotLines("##Throughput", stats.throughput_mb_s.data(), static_cast<int>(stats.throughput_count),
+                         ring_full ? static_cast<int>(stats.throughput_next) : 0, overlay, 0.0f, FLT_MAX,
+                         {-1, HISTORY_STATS_PLOT_HEIGHT});
+    } else {
+        ImGui::TextUnformatted("No timed operations yet.");
+    }
+
+    ImGui::SeparatorText("Largest files");
+    std::vector<const HistoryLargestFile*> largest;
+    for (const HistoryLargestFile& entry : stats.largest_files) {
+        if (entry.bytes > 0) largest.push_back(&entry);
+    }
+    std::sort(largest.begin(), largest.end(), [](const HistoryLargestFile* a, const HistoryLargestFile* b) { return a->bytes > b->bytes; });
+    if (largest.empty()) {
+        ImGui::TextUnformatted("No file sizes recorded yet.");
+    } else if (ImGui::BeginTable("##HistoryLargestFiles", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Size", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableSetupColumn("Operation", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableSetupColumn("When", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableSetupColumn("Path");
+        ImGui::TableHeadersRow();
+        for (const HistoryLargestFile* entry : largest) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(format_byte_count(entry->bytes).c_str());
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(entry->op);
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(format_history_timestamp(entry->timestamp_ms).c_str());
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(entry->path);
+        }
+        ImGui::EndTable();
+    }
+    ImGui::EndChild();
+
+    if (ImGui::Button("Back to Main Menu", {-1, 0})) {
+        go_to_screen(Screen::MainMenu);
+    }
+}
+
+ImVec2 UIManager::draw_compare_files_screen() {
+    ImGui::TextUnformatted("Differences Between Vault Original and Encrypted File");
+    ImGui::Separator();
+
+    ImGui::PushItemWidth(-1);
+    ImGui::InputTextWithHint("##DiffVaultFile", "Filename in Vault (e.g., original.txt)", diff_vault_filename_buf, sizeof(diff_vault_filename_buf));
+    ImGui::InputTextWithHint("##DiffExternalFile", "Path to External Encrypted File", diff_external_filepath_buf, sizeof(diff_external_filepath_buf));
+    ImGui::InputInt("Pegs Used for Encryption", &diff_pegs_value);
+    diff_pegs_value = std::clamp(diff_pegs_value, MIN_PEG, MAX_PEG);
+    ImGui::PopItemWidth();
+
+    float button_width = (ImGui::GetContentRegionAvail().x - ImGui::GetStyle().ItemSpacing.x) / 2.0f;
+    const bool diff_running = diff_job.valid();
+    ImGui::BeginDisabled(diff_running);
+    if (ImGui::Button(diff_running ? "Scanning..." : "Find Differences", {button_width, 0})) {
+        gui_message.clear();
+        std::shared_ptr<VaultEntryFile> vault_file = std::make_shared<VaultEntryFile>();
+        std::string external_path(diff_external_filepath_buf);
+        if (diff_vault_filename_buf[0] == '\0' || external_path.empty()) {
+            set_main_gui_message("Error: All fields must be provided.", MSG_COLOR_ERROR);
+        } else if (!Vault::instance().entry_info(diff_vault_filename_buf).is_regular || !is_regular_file(external_path)) {
+            set_main_gui_message("Error: Vault file or external file not found.", MSG_COLOR_ERROR);
+        } else if (!Vault::instance().entry_file(diff_vault_filename_buf, *vault_file)) {
+            set_main_gui_message("Error: Could not read the vault file.", MSG_COLOR_ERROR);
+        } else {
+            diff_report = DiffReport{};
+            diff_first_excerpt = TextCompareExcerpt{};
+            diff_report_vault_file = vault_file;
+            diff_report_path2 = external_path;
+            diff_report_pegs = diff_pegs_value;
+            diff_progress = std::make_shared<VerifyProgress>();
+            std::shared_ptr<VerifyProgress> progress = diff_progress;
+            int pegs = diff_pegs_value;
+            diff_job = std::async(std::launch::async, [vault_file, external_path, pegs, progress]() {
+                return diff_files_stream(vault_file->path(), external_path, pegs, progress.get());
+            });
+        }
+    }
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    if (ImGui::Button("Back to Main Menu", {button_width, 0})) {
+        go_to_screen(Screen::MainMenu);
+    }
+    ImGui::Separator();
+
+    // --- Summary ---
+    if (diff_running) {
+        unsigned long long total = diff_progress->bytes_total;
+        unsigned long long done = diff_progress->bytes_done;
+        ImGui::ProgressBar(total > 0 ? static_cast<float>(done) / static_cast<float>(total) : 0.0f, {-1, 0});
+    } else if (diff_report.files_readable) {
+        ImGui::Text("%llu byte(s) differ in %zu%s range(s). Sizes: %llu / %llu bytes.",
+                    diff_report.mismatch_count, diff_report.ranges.size(), diff_report.truncated ? "+" : "",
+                    diff_report.size1, diff_report.size2);
+        if (!diff_first_excerpt.content1.empty() || !diff_first_excerpt.content2.empty()) {
+            // One line per side; control characters would break the row, so show them as '.'
+            auto printable = [](std::string text) {
+                std::replace_if(text.begin(), text.end(), [](char c) { return static_cast<unsigned char>(c) < 0x20; }, '.');
+                return text;
+            };
+            ImGui::Text("First difference (from offset %zu):", diff_first_excerpt.offset);
+            ImGui::TextColored(MSG_COLOR_ERROR, "- %s", printable(diff_first_excerpt.content1).c_str());
+            ImGui::TextColored(MSG_COLOR_SUCCESS, "+ %s", printable(diff_first_excerpt.content2).c_str());
+        }
+    } else {
+        ImGui::TextUnformatted("No differences computed yet.");
+    }
+
+    // --- Mismatch Ranges (virtualized: only visible rows are submitted) ---
+    ImGui::BeginChild("##DiffRanges", {0, DIFF_RANGE_LIST_HEIGHT}, ImGuiChildFlags_Borders);
+    ImGuiListClipper range_clipper;
+    range_clipper.Begin(static_cast<int>(diff_report.ranges.size()));
+    while (range_clipper.Step()) {
+        for (int i = range_clipper.DisplayStart; i < range_clipper.DisplayEnd; ++i) {
+            const MismatchRange& range = diff_report.ranges[static_cast<size_t>(i)];
+            char label[96];
+            std::snprintf(label, sizeof(label), "Offset %llu: %llu byte(s)##DiffRange%d", range.offset, range.length, i);
+            if (ImGui::Selectable(label, diff_selected_range == i) && diff_selected_range != i) {
+                diff_selected_range = i;
+                diff_selected_lines.clear();
+                if (!line_diff_job.valid()) start_line_diff_job(); // Otherwise poll_line_diff_job() starts it
+            }
+        }
+    }
+    ImGui::EndChild();
+
+    // --- Line Diff of the Selected Range ---
+    ImGui::BeginChild("##DiffLines", {0, DIFF_LINES_HEIGHT}, ImGuiChildFlags_Borders, ImGuiWindowFlags_HorizontalScrollbar);
+    if (line_diff_job.valid()) ImGui::TextUnformatted("Reading range...");
+    ImGuiListClipper line_clipper;
+    line_clipper.Begin(static_cast<int>(diff_selected_lines.size()));
+    while (line_clipper.Step()) {
+        for (int i = line_clipper.DisplayStart; i < line_clipper.DisplayEnd; ++i) {
+            const LineDiffLine& line = diff_selected_lines[static_cast<size_t>(i)];
+            const bool colored = (line.op == '-' || line.op == '+');
+            if (colored) ImGui::PushStyleColor(ImGuiCol_Text, line.op == '-' ? MSG_COLOR_ERROR : MSG_COLOR_SUCCESS);
+            ImGui::Text("%c %.*s", line.op, static_cast<int>(line.text.size()), line.text.c_str());
+            if (colored) ImGui::PopStyleColor();
+        }
+    }
+    ImGui::EndChild();
+
+    return {DIFF_MIN_CONTENT_WIDTH, std::max(DIFF_MIN_CONTENT_HEIGHT, ImGui::GetCursorPosY())};
 }
 
 void UIManager::draw_admin_password_prompt_modal(const std::string& prompt_message) {
@@ -454,6 +1223,25 @@ void UIManager::draw_compare_files_modal() {
         ImGui::InputInt("Pegs Used for Encryption", &compare_modal_pegs_value);
         compare_modal_pegs_value = std::clamp(compare_modal_pegs_value, MIN_PEG, MAX_PEG);
         ImGui::PopItemWidth();
+        ImGui::BeginDisabled(peg_job.valid());
+        if (ImGui::Button(peg_job.valid() ? "Detecting Pegs..." : "Detect Pegs From Vault Original")) {
+            // Extracting a packed original and scoring both files both run on the worker
+            std::string vault_name(compare_modal_vault_filename_buf);
+            std::string cipher_path(compare_modal_external_enc_filepath_buf);
+            peg_job_for_compare = true;
+            peg_job = std::async(std::launch::async, [vault_name, cipher_path]() {
+                VaultEntryFile vault_file;
+                PegRecoveryResult recovery;
+                if (Vault::instance().entry_file(vault_name, vault_file)) {
+                    recovery = recover_pegs(cipher_path, vault_file.path());
+                } else {
+                    recovery.error_message = "Could not read the vault file.";
+                }
+                return recovery;
+            });
+            set_main_gui_message("Detecting pegs...", MSG_COLOR_INFO);
+        }
+        ImGui::EndDisabled();
         
         ImGui::Separator();
         ImGui::Dummy({0, 5.0f});
@@ -467,12 +1255,11 @@ void UIManager::draw_compare_files_modal() {
             if (vault_filename.empty() || external_enc_path.empty()) {
                 set_main_gui_message("Error: All fields must be provided.", MSG_COLOR_ERROR);
             } else {
-                // Use our own path helpers instead of std::filesystem
-                std::string vault_file_full_path = path_join(PRIVATE_VAULT_DIR, vault_filename);
+                std::shared_ptr<VaultEntryFile> vault_file = std::make_shared<VaultEntryFile>();
                 std::string error_msg;
                 bool problem = false;
 
-                if (!is_regular_file(vault_file_full_path)) {
+                if (!Vault::instance().entry_info(vault_filename).is_regular) {
                     error_msg += "Error: Vault file not found. ";
                     problem = true;
                 }
@@ -483,22 +1270,23 @@ void UIManager::draw_compare_files_modal() {
 
                 if (problem) {
                     set_main_gui_message(error_msg, MSG_COLOR_ERROR);
+                } else if (verify_job.valid()) {
+                    set_main_gui_message("A verification is already running. Please wait for it to finish.", MSG_COLOR_WARNING);
+                } else if (!Vault::instance().entry_file(vault_filename, *vault_file)) {
+                    set_main_gui_message("Error: Could not read the vault file.", MSG_COLOR_ERROR);
                 } else {
-                    std::string vault_content = load_file_content_to_string(vault_file_full_path, MAX_TEXT_COMPARE_DISPLAY_CHARS);
-                    std::string external_enc_content = load_file_content_to_string(external_enc_path, MAX_TEXT_COMPARE_DISPLAY_CHARS);
-                    
-                    std::string in_memory_encrypted_content = process_content_caesar(vault_content, compare_modal_pegs_value, true);
-                    TextCompareResult res = compare_string_contents(in_memory_encrypted_content, external_enc_content);
-                    
-                    std::ostringstream result_ss;
-                    result_ss.precision(2);
-                    result_ss << "Verification Result: Match: " << std::fixed << res.match_percentage << "%.";
-                    if (res.first_diff_offset != -1) {
-                        result_ss << " First diff at offset: " << res.first_diff_offset << ".";
-                    } else if (res.match_percentage >= 99.99f) {
-                        result_ss << " Contents appear identical.";
-                    }
-                    set_main_gui_message(result_ss.str(), (res.match_percentage >= 99.99f) ? MSG_COLOR_SUCCESS : MSG_COLOR_WARNING);
+                    // Walk both files end to end on a worker thread; poll_verify_job() picks up the result
+                    verify_progress = std::make_shared<VerifyProgress>();
+                    std::shared_ptr<VerifyProgress> progress = verify_progress;
+                    int pegs = compare_modal_pegs_value;
+                    // Prefill the difference viewer so a failed verification can be inspected
+                    std::snprintf(diff_vault_filename_buf, sizeof(diff_vault_filename_buf), "%s", compare_modal_vault_filename_buf);
+                    std::snprintf(diff_external_filepath_buf, sizeof(diff_external_filepath_buf), "%s", compare_modal_external_enc_filepath_buf);
+                    diff_pegs_value = pegs;
+                    verify_job = std::async(std::launch::async, [vault_file, external_enc_path, pegs, progress]() {
+                        return verify_encrypted_file_stream(vault_file->path(), external_enc_path, pegs, progress.get());
+                    });
+                    set_main_gui_message("Verifying full files...", MSG_COLOR_INFO);
                 }
             }
             current_modal = Modal::None;
@@ -2,9 +2,20 @@
 
 #include <string>
 #include <utility> // For std::pair
+#include <vector>
+#include <future>  // For std::future (background verification)
+#include <memory>  // For std::shared_ptr
+#include <chrono>
 
 #include "imgui.h"
 #include "cipher_utils.h" // For constants like MAX_FILENAME_BUFFER_SIZE
+#include "verifier.h"     // For StreamVerifyResult, VerifyProgress
+#include "history_segments.h" // For HistorySegmentInfo
+#include "history_tail.h"     // For HistoryTailFollower
+#include "history_text.h"     // For HistoryText
+#include "history_search.h"   // For HistorySearchStream, HistorySearchSummary
+#include "history_stats.h"    // For HistoryStats
+#include "vault.h"            // For VaultEntryFile
 
 // Forward-declare GLFWwindow to avoid including the GLFW header here
 struct GLFWwindow;
@@ -12,6 +23,7 @@ struct GLFWwindow;
 class UIManager {
 public:
     UIManager();
+    ~UIManager();
 
     // Draws the entire UI and returns the required content size and a scaling factor
     std::pair<ImVec2, float> draw_ui(GLFWwindow* window);
@@ -28,14 +40,31 @@ private:
     void go_to_screen(Screen new_screen);
     void set_main_gui_message(const std::string& message, const ImVec4& color);
     void load_history_content();
+    void load_older_history_segment();
+    size_t refresh_history_tail(bool flush_logger);
+    void poll_history_loads();
+    void draw_history_lines(float bottom_elements_height);
+    void copy_history_selection();
+    const HistoryText& visible_history_lines() const;
+    void start_history_search();
+    void cancel_history_search();
+    void poll_history_search();
     void request_admin_access_for_screen(Screen target_screen);
     void clear_all_persistent_state();
+    void poll_verify_job();
+    void poll_peg_job();
+    void poll_diff_job();
+    void start_line_diff_job();
+    void poll_line_diff_job();
+    void poll_sweep_job();
 
     // --- UI Drawing Methods (one for each major component) ---
     ImVec2 draw_main_menu_screen();
     ImVec2 draw_encrypt_decrypt_screen(bool is_encrypt_mode);
     ImVec2 draw_get_item_screen();
     ImVec2 draw_history_screen();
+    void draw_history_log_tab();
+    void draw_history_stats_tab();
     ImVec2 draw_compare_files_screen();
     void draw_admin_password_prompt_modal(const std::string& prompt_message);
     void draw_compare_files_modal();
@@ -63,7 +92,58 @@ private:
     char admin_password_buf[128];
     int pegs_value;
     int compare_modal_pegs_value;
-    std::string history_content_buf;
+    bool get_item_move_out;                           // Retrieve by moving the entry out instead of copying it
+    HistoryText history_text;                         // Virtualized History viewer contents
+    long long history_selection_anchor;               // Selected line range, -1 when nothing is selected
+    long long history_selection_end;
+    bool history_scroll_to_end;
+    HistoryText history_search_results;               // Matches of the current search
+    bool history_showing_search;                      // The viewer shows the matches instead of the log
+    char history_search_text_buf[MAX_PATH_LEN];
+    char history_search_path_buf[MAX_PATH_LEN];
+    char history_search_from_buf[32];
+    char history_search_to_buf[32];
+    int history_search_op_index;                      // Into HISTORY_SEARCH_OPS; 0 matches any op
+    int history_search_pegs;                          // 0 matches any peg count
+    HistoryStats history_stats;                       // Last snapshot from the logger
+    bool history_stats_ready;
+    std::chrono::steady_clock::time_point history_stats_taken;
+    std::vector<HistorySegmentInfo> history_segments; // Closed segments, oldest first
+    size_t history_older_loaded;                      // How many of them are prepended to the view
+    HistoryTailFollower history_tail;                 // Read position in the active segment
+    bool history_live_follow;
+
+    // Background verification job started from the compare modal
+    std::shared_ptr<VerifyProgress> verify_progress;
+    std::future<StreamVerifyResult> verify_job;
+
+    // Peg detection started from the Decrypt screen or the compare modal
+    std::future<PegRecoveryResult> peg_job;
+    bool peg_job_for_compare; // Result goes to compare_modal_pegs_value rather than pegs_value
+
+    // Whole-vault verification sweep started from the Admin menu
+    std::shared_ptr<SweepProgress> sweep_progress;
+    std::future<VaultSweepReport> sweep_job;
+
+    // History search; matches stream into history_search_results while it runs
+    std::shared_ptr<HistorySearchStream> history_search_stream;
+    std::future<HistorySearchSummary> history_search_job;
+
+    // Difference viewer (Screen::Compare)
+    char diff_vault_filename_buf[MAX_PATH_LEN];
+    char diff_external_filepath_buf[MAX_PATH_LEN];
+    int diff_pegs_value;
+    std::shared_ptr<VerifyProgress> diff_progress;
+    std::future<DiffReport> diff_job;
+    DiffReport diff_report;
+    TextCompareExcerpt diff_first_excerpt; // Both sides around diff_report's first range
+    std::shared_ptr<VaultEntryFile> diff_report_vault_file; // Vault side of diff_report, kept while it is shown
+    std::string diff_report_path2;
+    int diff_report_pegs;
+    int diff_selected_range;
+    std::vector<LineDiffLine> diff_selected_lines;
+    std::future<std::vector<LineDiffLine>> line_diff_job;
+    int line_diff_job_range; // Range line_diff_job is reading; -1 once its report was replaced
 
     // --- UI Configuration Constants (C++17 inline lets us define them here) ---
     inline static constexpr ImVec4 MSG_COLOR_INFO    = {0.6f, 0.8f, 1.0f, 1.0f}; // Light Blue
@@ -75,10 +155,25 @@ private:
     inline static constexpr float MAIN_MENU_MIN_CONTENT_HEIGHT      = 250.0f;
     inline static constexpr float ENCRYPT_DECRYPT_MIN_CONTENT_WIDTH = 450.0f;
     inline static constexpr float ENCRYPT_DECRYPT_MIN_CONTENT_HEIGHT= 200.0f;
-    inline static constexpr float HISTORY_MIN_CONTENT_WIDTH         = 500.0f;
+    inline static constexpr float HISTORY_MIN_CONTENT_WIDTH         = 640.0f;
     inline static constexpr float HISTORY_MIN_CONTENT_HEIGHT        = 400.0f;
+    inline static constexpr float HISTORY_SEARCH_OP_WIDTH           = 150.0f;
+    inline static constexpr float HISTORY_SEARCH_FIELD_WIDTH        = 110.0f;
+    inline static constexpr float HISTORY_STATS_PLOT_HEIGHT         = 80.0f;
     inline static constexpr float GET_ITEM_MIN_CONTENT_WIDTH        = 450.0f;
     inline static constexpr float GET_ITEM_MIN_CONTENT_HEIGHT       = 180.0f;
+    inline static constexpr float DIFF_MIN_CONTENT_WIDTH            = 600.0f;
+    inline static constexpr float DIFF_MIN_CONTENT_HEIGHT           = 520.0f;
+    inline static constexpr float DIFF_RANGE_LIST_HEIGHT            = 150.0f;
+    inline static constexpr float DIFF_LINES_HEIGHT                 = 200.0f;
     
     inline static constexpr size_t MAX_TEXT_COMPARE_DISPLAY_CHARS = 5000;
+    inline static constexpr size_t MAX_HISTORY_COPY_LINES         = 100000;
+    inline static constexpr size_t HISTORY_STATS_PLOT_DAYS        = 30;
+    inline static constexpr std::chrono::milliseconds HISTORY_STATS_REFRESH_INTERVAL{1000};
+
+    inline static constexpr const char* HISTORY_SEARCH_OPS[] = {
+        "Any operation", "ENCRYPT", "DECRYPT", "VAULT_STORE", "VAULT_RETRIEVE", "VAULT_SWEEP", "COMPARE_BINARY",
+        "COMPARE_STRINGS", "VERIFY_STREAM", "DIFF_STREAM", "PEG_RECOVERY", "ENCRYPT_FAIL", "RETRIEVE_FAIL", "HASH_ERROR"
+    };
 };
\ No newline at end of file
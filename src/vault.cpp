@@ -0,0 +1,1234 @@
+#include "vault.h"
+#include "op_metrics.h" // For IO_BACKEND_*
+#include "hash_service.h" // For HashService, Sha256Digest
+#include "file_view.h"    // For FileView
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <algorithm> // For std::stable_partition
+#include <cerrno>
+#include <cstddef> // For offsetof
+#include <cstring> // For std::memcpy, std::memcmp
+#include <unordered_map>
+#include <cstdio> // For renameat2 (glibc), std::remove
+#include <cstdlib> // For std::strtol
+#include <utility> // For std::exchange
+
+#if defined(_WIN32) || defined(_WIN64)
+    #include <windows.h> // For MoveFileExA, CopyFileA
+#else
+    #include <fcntl.h>    // For openat, AT_FDCWD
+    #include <unistd.h>   // For read, write, close, copy_file_range
+    #include <sys/stat.h> // For fstatat, mkdirat
+    #include <dirent.h>   // For fdopendir
+    #include <signal.h>   // For kill
+    #if defined(__linux__)
+        #include <sys/ioctl.h>    // For ioctl
+        #include <sys/sendfile.h> // For sendfile
+        #include <linux/fs.h>     // For FICLONE
+    #endif
+#endif
+
+// --- Definitions for Global Constants ---
+const std::string VAULT_OBJECTS_DIR = ".objects";
+const std::string VAULT_PACKS_DIR = ".packs";
+const std::string VAULT_UNPACKED_DIR = ".unpacked";
+
+// --- Anonymous Namespace for INTERNAL (File-Local) Helper Functions ---
+namespace {
+
+    long long now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    bool is_reserved_name(const std::string& name) {
+        return name == VAULT_INDEX_FILE || name == VAULT_LOCK_FILE || name == VAULT_INDEX_FILE + ".tmp" ||
+               name == VAULT_INDEX_BACKUP_FILE ||
+               name == VAULT_OBJECTS_DIR || name == VAULT_PACKS_DIR || name == VAULT_UNPACKED_DIR;
+    }
+
+    // Two directory levels named by one hex byte each: a million entries leave ~15 per leaf
+    std::string shard_location(unsigned char first, unsigned char second, const std::string& file) {
+        static constexpr char HEX[] = "0123456789abcdef";
+        const std::string outer = {HEX[first >> 4], HEX[first & 15]};
+        const std::string inner = {HEX[second >> 4], HEX[second & 15]};
+        return path_join(path_join(outer, inner), file);
+    }
+
+    // Entries stored by name are sharded by a hash of the name
+    std::string name_location(const std::string& name) {
+        const FastDigest hash = HashService::fast_hash_buffer(name.data(), name.size());
+        return shard_location(static_cast<unsigned char>(hash >> 56), static_cast<unsigned char>(hash >> 48), name);
+    }
+
+    // Objects are sharded by the leading bytes of their digest, which their name already shows
+    std::string object_location(const Sha256Digest& digest) {
+        return path_join(VAULT_OBJECTS_DIR, shard_location(digest.bytes[0], digest.bytes[1], digest.to_hex()));
+    }
+
+    // Where an object was kept before the vault was sharded
+    std::string flat_object_location(const Sha256Digest& digest) {
+        return path_join(VAULT_OBJECTS_DIR, digest.to_hex());
+    }
+
+    int hex_value(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    }
+
+    bool is_shard_name(const std::string& name) {
+        return name.size() == 2 && hex_value(name[0]) >= 0 && hex_value(name[1]) >= 0;
+    }
+
+    // Packfiles are named by their id as written by pack_location()
+    bool parse_pack_name(const std::string& name, unsigned int& out_pack_id) {
+        if (name.size() != 13 || name.compare(8, 5, ".pack") != 0) return false;
+        unsigned int pack_id = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            const int digit = hex_value(name[i]);
+            if (digit < 0) return false;
+            pack_id = pack_id * 16 + static_cast<unsigned int>(digit);
+        }
+        out_pack_id = pack_id;
+        return pack_id != 0;
+    }
+
+    // --- Packfiles ---
+    // A packfile is PACK_MAGIC followed by records, each a PackRecordHeader, the entry name and
+    // the original's bytes, padded to 8 bytes. The index locates a record by pack id and offset;
+    // the names make a pack readable on its own when the index has to be rebuilt.
+    constexpr char PACK_MAGIC[8] = {'C', 'G', 'V', 'P', 'A', 'C', 'K', '1'};
+    constexpr char PACK_RECORD_MAGIC[4] = {'C', 'G', 'P', 'R'};
+    constexpr unsigned int PACK_RECORD_REMOVED = 1; // The entry left the vault; garbage until repacked
+
+    struct PackRecordHeader {
+        char magic[4];
+        unsigned int flags;
+        unsigned long long size;
+        long long modified_ms;
+        unsigned int name_length;
+        unsigned int reserved;
+    };
+
+    unsigned long long align8(unsigned long long value) {
+        return (value + 7) & ~7ull;
+    }
+
+    unsigned long long pack_record_length(size_t name_length, unsigned long long size) {
+        return align8(sizeof(PackRecordHeader) + name_length + size);
+    }
+
+    unsigned long long pack_data_offset(const VaultEntry& entry) {
+        return entry.pack_offset + sizeof(PackRecordHeader) + entry.name.size();
+    }
+
+    std::string pack_location(unsigned int pack_id) {
+        char name[16];
+        std::snprintf(name, sizeof(name), "%08x.pack", pack_id);
+        return path_join(VAULT_PACKS_DIR, name);
+    }
+
+    // Object files are named by the lowercase hex digest written by Sha256Digest::write_hex
+    bool parse_object_name(const std::string& name, Sha256Digest& out_digest) {
+        if (name.size() != Sha256Digest::HEX_LENGTH) return false;
+        for (size_t i = 0; i < Sha256Digest::SIZE; ++i) {
+            const int high = hex_value(name[2 * i]);
+            const int low = hex_value(name[2 * i + 1]);
+            if (high < 0 || low < 0) return false;
+            out_digest.bytes[i] = static_cast<unsigned char>(high * 16 + low);
+        }
+        return true;
+    }
+
+#if !defined(_WIN32) && !defined(_WIN64)
+    constexpr size_t COPY_BUFFER_SIZE = 256 * 1024;
+
+    FileInfo file_info_from_stat(const struct stat& st) {
+        FileInfo info;
+        info.exists = true;
+        info.is_regular = S_ISREG(st.st_mode);
+        info.is_directory = S_ISDIR(st.st_mode);
+        info.size = static_cast<unsigned long long>(st.st_size);
+        info.device = static_cast<unsigned long long>(st.st_dev);
+        info.inode = static_cast<unsigned long long>(st.st_ino);
+        info.modified_ms = static_cast<long long>(st.st_mtime) * 1000;
+        return info;
+    }
+
+    // Rename that fails with EEXIST instead of replacing an existing target. Sets errno to
+    // ENOSYS where the platform (or EINVAL where the filesystem) has no such rename.
+    int rename_no_replace(int from_dir, const char* from, int to_dir, const char* to) {
+    #if defined(__APPLE__) && defined(RENAME_EXCL)
+        return renameatx_np(from_dir, from, to_dir, to, RENAME_EXCL);
+    #elif defined(__linux__) && defined(RENAME_NOREPLACE)
+        return renameat2(from_dir, from, to_dir, to, RENAME_NOREPLACE);
+    #else
+        (void)from_dir; (void)from; (void)to_dir; (void)to;
+        errno = ENOSYS;
+        return -1;
+    #endif
+    }
+
+    bool sync_data(int fd) {
+    #if defined(__APPLE__)
+        return ::fsync(fd) == 0;
+    #else
+        return ::fdatasync(fd) == 0;
+    #endif
+    }
+
+    // Outcome of one copy strategy. The strategies all advance the descriptors' file offsets, so
+    // when one turns out to be unsupported part way through, the next continues where it stopped.
+    enum class CopyStep { Done, Unsupported, Failed };
+
+    constexpr unsigned long long COPY_TO_END = ~0ull;   // Copy limit meaning "until end of file"
+    constexpr size_t KERNEL_COPY_CHUNK = 1u << 30; // Per call; the kernel caps a single transfer anyway
+
+    size_t next_chunk(unsigned long long limit, unsigned long long copied, size_t chunk) {
+        return static_cast<size_t>(std::min<unsigned long long>(chunk, limit - copied));
+    }
+
+    bool is_unsupported_copy(int error) {
+        return error == ENOSYS || error == EXDEV || error == EINVAL || error == EOPNOTSUPP || error == ENOTTY;
+    }
+
+    // Shares the source's blocks with the destination (btrfs, XFS, ...): metadata only. Whole
+    // files only; a range would need FICLONERANGE's block alignment.
+    CopyStep clone_file(int from, int to, unsigned long long limit, unsigned long long& out_bytes) {
+    #if defined(__linux__) && defined(FICLONE)
+        if (limit != COPY_TO_END || out_bytes != 0) return CopyStep::Unsupported;
+        struct stat st;
+        if (fstat(from, &st) != 0) return CopyStep::Failed;
+        if (ioctl(to, FICLONE, from) != 0) return CopyStep::Unsupported; // No reflinks here, or across filesystems
+        out_bytes = static_cast<unsigned long long>(st.st_size);
+        return CopyStep::Done;
+    #else
+        (void)from; (void)to; (void)limit; (void)out_bytes;
+        return CopyStep::Unsupported;
+    #endif
+    }
+
+    CopyStep copy_range(int from, int to, unsigned long long limit, unsigned long long& out_bytes) {
+    #if defined(__linux__)
+        while (out_bytes < limit) {
+            const ssize_t copied = copy_file_range(from, nullptr, to, nullptr, next_chunk(limit, out_bytes, KERNEL_COPY_CHUNK), 0);
+            if (copied > 0) {
+                out_bytes += static_cast<unsigned long long>(copied);
+                continue;
+            }
+            if (copied == 0) return CopyStep::Done;
+            if (errno == EINTR) continue;
+            return is_unsupported_copy(errno) ? CopyStep::Unsupported : CopyStep::Failed;
+        }
+        return CopyStep::Done;
+    #else
+        (void)from; (void)to; (void)limit; (void)out_bytes;
+        return CopyStep::Unsupported;
+    #endif
+    }
+
+    CopyStep send_file(int from, int to, unsigned long long limit, unsigned long long& out_bytes) {
+    #if defined(__linux__)
+        while (out_bytes < limit) {
+            const ssize_t sent = sendfile(to, from, nullptr, next_chunk(limit, out_bytes, KERNEL_COPY_CHUNK));
+            if (sent > 0) {
+                out_bytes += static_cast<unsigned long long>(sent);
+                continue;
+            }
+            if (sent == 0) return CopyStep::Done;
+            if (errno == EINTR) continue;
+            return is_unsupported_copy(errno) ? CopyStep::Unsupported : CopyStep::Failed;
+        }
+        return CopyStep::Done;
+    #else
+        (void)from; (void)to; (void)limit; (void)out_bytes;
+        return CopyStep::Unsupported;
+    #endif
+    }
+
+    CopyStep copy_loop(int from, int to, unsigned long long limit, unsigned long long& out_bytes) {
+        std::vector<unsigned char> buffer(static_cast<size_t>(std::min<unsigned long long>(COPY_BUFFER_SIZE, limit - out_bytes)));
+        while (out_bytes < limit) {
+            const ssize_t got = ::read(from, buffer.data(), next_chunk(limit, out_bytes, buffer.size()));
+            if (got < 0) {
+                if (errno == EINTR) continue;
+                return CopyStep::Failed;
+            }
+            if (got == 0) return CopyStep::Done;
+            if (!write_all(to, buffer.data(), static_cast<size_t>(got))) return CopyStep::Failed;
+            out_bytes += static_cast<unsigned long long>(got);
+        }
+        return CopyStep::Done;
+    }
+
+    struct CopyStrategy {
+        CopyStep (*copy)(int from, int to, unsigned long long limit, unsigned long long& out_bytes);
+        const char* io_backend;
+    };
+
+    // Cheapest first; the user-space loop always works
+    constexpr CopyStrategy COPY_STRATEGIES[] = {
+        {clone_file, IO_BACKEND_CLONE},
+        {copy_range, IO_BACKEND_COPY_RANGE},
+        {send_file, IO_BACKEND_SENDFILE},
+        {copy_loop, IO_BACKEND_READ},
+    };
+
+    // Copies up to 'limit' bytes from the current offset of 'from' to that of 'to'
+    bool copy_descriptor(int from, int to, unsigned long long limit, unsigned long long& out_bytes,
+                         const char*& out_io_backend) {
+        CopyStep step = CopyStep::Unsupported;
+        for (const CopyStrategy& strategy : COPY_STRATEGIES) {
+            out_io_backend = strategy.io_backend;
+            step = strategy.copy(from, to, limit, out_bytes);
+            if (step != CopyStep::Unsupported) break;
+        }
+        return step == CopyStep::Done;
+    }
+
+    // Opens the destination of a copy out of 'source' and only then truncates it, refusing the
+    // source itself (the same path, or a hard link to it), which the truncation would empty
+    int open_copy_destination(const std::string& destination_path, int source) {
+        const int to = ::open(destination_path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0666);
+        if (to < 0) return -1;
+        struct stat to_st, from_st;
+        if (fstat(to, &to_st) != 0 || fstat(source, &from_st) != 0 ||
+            (to_st.st_dev == from_st.st_dev && to_st.st_ino == from_st.st_ino) || ftruncate(to, 0) != 0) {
+            ::close(to);
+            return -1;
+        }
+        return to;
+    }
+#endif
+
+} // End anonymous namespace
+
+// --- VaultEntryFile ---
+
+VaultEntryFile::~VaultEntryFile() noexcept {
+    close();
+}
+
+VaultEntryFile::VaultEntryFile(VaultEntryFile&& other) noexcept
+    : file_path(std::move(other.file_path)),
+      temporary(std::exchange(other.temporary, false))
+{
+    other.file_path.clear();
+}
+
+VaultEntryFile& VaultEntryFile::operator=(VaultEntryFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        file_path = std::move(other.file_path);
+        temporary = std::exchange(other.temporary, false);
+        other.file_path.clear();
+    }
+    return *this;
+}
+
+void VaultEntryFile::close() noexcept {
+    if (temporary) std::remove(file_path.c_str());
+    file_path.clear();
+    temporary = false;
+}
+
+// --- Vault ---
+
+Vault& Vault::instance() {
+    static Vault vault;
+    return vault;
+}
+
+Vault::~Vault() {
+    stopping.store(true, std::memory_order_relaxed);
+    if (maintenance.joinable()) maintenance.join();
+#if !defined(_WIN32) && !defined(_WIN64)
+    if (dir_handle >= 0) ::close(dir_handle);
+#endif
+}
+
+bool Vault::is_valid_entry_name(const std::string& name) {
+    return !name.empty() && name != "." && name != ".." && name.find_first_of("/\\") == std::string::npos &&
+           !is_reserved_name(name);
+}
+
+bool Vault::entry_file(const std::string& name, VaultEntryFile& out_file) {
+    out_file.close();
+    if (!is_valid_entry_name(name) || !open()) return false;
+    VaultEntry entry;
+    if (index.find(name, entry) && entry.pack_id != 0) {
+        // A repack may move the record between the lookup and the copy
+        if (extract_packed(entry, out_file)) return true;
+        if (index.find(name, entry) && entry.pack_id != 0 && extract_packed(entry, out_file)) return true;
+        std::cerr << "Error (Vault): Could not extract packed entry '" << name << "'.\n";
+        return false;
+    }
+    if (entry.name.empty()) entry.name = name;
+    out_file.file_path = path_join(PRIVATE_VAULT_DIR, data_location(entry));
+    return true;
+}
+
+std::string Vault::data_location(const std::string& name) {
+    VaultEntry entry;
+    if (!index.find(name, entry)) entry.name = name;
+    return data_location(entry);
+}
+
+std::string Vault::data_location(const VaultEntry& entry) {
+    if (entry.content_addressed && entry.has_digest) {
+        return resolve_location(object_location(entry.digest), flat_object_location(entry.digest));
+    }
+    return resolve_location(name_location(entry.name), entry.name);
+}
+
+// Data belongs at its sharded location. Until the flat layout has been migrated it may still be
+// at 'flat', which is only checked when nothing is at the sharded one.
+std::string Vault::resolve_location(const std::string& sharded, const std::string& flat) {
+    if (!flat_layout.load(std::memory_order_acquire) || location_info(sharded).exists || !location_info(flat).exists) {
+        return sharded;
+    }
+    return flat;
+}
+
+void Vault::configure(const VaultConfig& new_config) {
+    std::lock_guard<std::mutex> lock(config_mutex);
+    config = new_config;
+}
+
+VaultConfig Vault::current_config() {
+    std::lock_guard<std::mutex> lock(config_mutex);
+    return config;
+}
+
+bool Vault::content_addressed() {
+    return open() && index.is_open() && (index.options() & VAULT_OPTION_CONTENT_ADDRESSED) != 0;
+}
+
+bool Vault::set_content_addressed(bool enabled) {
+    if (!open() || !index.is_open()) return false;
+    const unsigned long long options = index.options();
+    return index.set_options(enabled ? (options | VAULT_OPTION_CONTENT_ADDRESSED)
+                                     : (options & ~VAULT_OPTION_CONTENT_ADDRESSED));
+}
+
+bool Vault::open() {
+    if (opened.load(std::memory_order_acquire)) return true;
+    std::lock_guard<std::mutex> lock(open_mutex);
+    if (opened.load(std::memory_order_relaxed)) return true;
+
+#if defined(_WIN32) || defined(_WIN64)
+    const FileInfo info = get_file_info(PRIVATE_VAULT_DIR);
+    if (!info.is_directory) {
+        if (info.exists) {
+            std::cerr << "Error: Vault path '" << PRIVATE_VAULT_DIR << "' exists but is not a directory.\n";
+            return false;
+        }
+        if (!create_directory(PRIVATE_VAULT_DIR)) {
+            std::cerr << "Error: Could not create private vault directory '" << PRIVATE_VAULT_DIR << "'.\n";
+            return false;
+        }
+        std::cout << "Info: Private vault directory created: '" << PRIVATE_VAULT_DIR << "'\n";
+    }
+#else
+    // Opening first answers "exists and is a directory" without a separate stat()
+    int fd = ::open(PRIVATE_VAULT_DIR.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0 && errno == ENOENT) {
+        if (!create_directory(PRIVATE_VAULT_DIR) && errno != EEXIST) {
+            std::cerr << "Error: Could not create private vault directory '" << PRIVATE_VAULT_DIR << "'.\n";
+            return false;
+        }
+        std::cout << "Info: Private vault directory created: '" << PRIVATE_VAULT_DIR << "'\n";
+        fd = ::open(PRIVATE_VAULT_DIR.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    if (fd < 0) {
+        if (errno == ENOTDIR) {
+            std::cerr << "Error: Vault path '" << PRIVATE_VAULT_DIR << "' exists but is not a directory.\n";
+        } else {
+            std::cerr << "Error: Could not open private vault directory '" << PRIVATE_VAULT_DIR << "'.\n";
+        }
+        return false;
+    }
+    dir_handle = fd;
+#endif
+
+#if defined(_WIN32) || defined(_WIN64)
+    const int index_dir_handle = -1;
+#else
+    const int index_dir_handle = dir_handle;
+#endif
+    bool index_created = false;
+    if (!index.open(PRIVATE_VAULT_DIR, index_dir_handle, index_created)) {
+        std::cerr << "Warning: Could not open the vault index; vault listings will be unavailable.\n";
+    } else if (index_created) {
+        rebuild_index();
+    }
+
+    if (index.is_open() && (index.options() & VAULT_OPTION_SHARDED) != 0) {
+        flat_layout.store(false, std::memory_order_release);
+    }
+    // Before any entry operation can extract into it
+    clear_unpacked();
+    opened.store(true, std::memory_order_release);
+    maintenance = std::thread(&Vault::run_maintenance, this);
+    return true;
+}
+
+// Background work after open; the vault stays usable throughout
+void Vault::run_maintenance() {
+    // A vault from before sharding is migrated first
+    if (flat_layout.load(std::memory_order_acquire)) migrate_flat_layout();
+    repack_packs();
+}
+
+// Indexes whatever is in the directory, with the metadata a stat can provide. The names bound to
+// objects were only recorded in the lost index, so each object comes back under its digest.
+void Vault::rebuild_index() {
+    size_t indexed = 0;
+    for (const std::string& location : entry_locations()) {
+        const FileInfo info = location_info(location);
+        if (!info.is_regular) continue;
+        VaultEntry entry;
+        entry.name = path_get_filename(location);
+        entry.size = info.size;
+        entry.modified_ms = info.modified_ms;
+        entry.stored_ms = info.modified_ms;
+        if (index.put(entry)) indexed++;
+    }
+    for (const std::string& location : object_locations()) {
+        VaultEntry entry;
+        entry.name = path_get_filename(location);
+        if (!parse_object_name(entry.name, entry.digest)) continue;
+        const FileInfo info = location_info(location);
+        if (!info.is_regular) continue;
+        entry.size = info.size;
+        entry.modified_ms = info.modified_ms;
+        entry.stored_ms = info.modified_ms;
+        entry.has_digest = true;
+        entry.content_addressed = true;
+        if (index.bind_content(entry, [](bool) { return true; }, nullptr)) indexed++;
+    }
+    for (const std::string& name : scan_directory(VAULT_PACKS_DIR, false)) {
+        unsigned int pack_id = 0;
+        if (parse_pack_name(name, pack_id)) indexed += index_pack(pack_id);
+    }
+    if (indexed > 0) {
+        std::cout << "Info: Vault index rebuilt from " << indexed << " file(s).\n";
+    }
+}
+
+// Moves every file still at its pre-sharding location into its shard. Each move is one rename
+// that refuses to replace anything, and lookups fall back to the flat location until the
+// migration is recorded as finished, so entries stay reachable throughout.
+void Vault::migrate_flat_layout() {
+    size_t moved = 0;
+    bool complete = true;
+    // A file named like a shard directory ("3f") would block that shard, so those go first
+    std::vector<std::string> names = scan_directory("", false);
+    std::stable_partition(names.begin(), names.end(), is_shard_name);
+    for (const std::string& name : names) {
+        if (stopping.load(std::memory_order_relaxed)) return;
+        if (is_reserved_name(name)) continue;
+        if (move_in(name, name_location(name), true) == VaultStoreResult::Stored) {
+            moved++;
+        } else {
+            complete = false;
+        }
+    }
+    for (const std::string& name : scan_directory(VAULT_OBJECTS_DIR, false)) {
+        if (stopping.load(std::memory_order_relaxed)) return;
+        Sha256Digest digest;
+        if (!parse_object_name(name, digest)) continue;
+        if (move_in(flat_object_location(digest), object_location(digest), true) == VaultStoreResult::Stored) {
+            moved++;
+        } else {
+            complete = false;
+        }
+    }
+    if (!complete) {
+        std::cerr << "Warning (Vault): Some files could not be moved to the sharded layout; retrying next time.\n";
+        return;
+    }
+    if (index.is_open()) index.set_options(index.options() | VAULT_OPTION_SHARDED);
+    flat_layout.store(false, std::memory_order_release);
+    if (moved > 0) {
+        std::cout << "Info: Moved " << moved << " vault file(s) to the sharded layout.\n";
+    }
+}
+
+FileInfo Vault::entry_info(const std::string& name) {
+    if (!is_valid_entry_name(name) || !open()) return FileInfo{};
+    VaultEntry entry;
+    if (index.find(name, entry) && entry.pack_id != 0) {
+        // A packed entry is a range of its pack; the index has everything a stat would say
+        FileInfo info;
+        info.exists = true;
+        info.is_regular = true;
+        info.size = entry.size;
+        info.modified_ms = entry.modified_ms;
+        return info;
+    }
+    const FileInfo info = location_info(data_location(name));
+    // The migration may have moved the file between the lookup and the stat
+    if (!info.exists && flat_layout.load(std::memory_order_acquire)) return location_info(data_location(name));
+    return info;
+}
+
+FileInfo Vault::location_info(const std::string& location) {
+#if defined(_WIN32) || defined(_WIN64)
+    return get_file_info(path_join(PRIVATE_VAULT_DIR, location));
+#else
+    struct stat st;
+    if (fstatat(dir_handle, location.c_str(), &st, 0) != 0) return FileInfo{};
+    return file_info_from_stat(st);
+#endif
+}
+
+// Creates the shard directories leading to 'location'
+bool Vault::make_parent_dirs(const std::string& location) {
+    for (size_t separator = location.find_first_of("/\\"); separator != std::string::npos;
+         separator = location.find_first_of("/\\", separator + 1)) {
+        const std::string directory = location.substr(0, separator);
+    #if defined(_WIN32) || defined(_WIN64)
+        const std::string path = path_join(PRIVATE_VAULT_DIR, directory);
+        if (!create_directory(path) && !get_file_info(path).is_directory) return false;
+    #else
+        if (mkdirat(dir_handle, directory.c_str(), 0700) != 0 && errno != EEXIST) return false;
+    #endif
+    }
+    return true;
+}
+
+// Moves 'source' (a path, or with 'source_in_vault' a location inside the vault) to 'location'
+// unless something is already there. Missing shard directories are created on the way.
+VaultStoreResult Vault::move_in(const std::string& source, const std::string& location, bool source_in_vault) {
+#if defined(_WIN32) || defined(_WIN64)
+    const std::string from = source_in_vault ? path_join(PRIVATE_VAULT_DIR, source) : source;
+    if (!make_parent_dirs(location)) return VaultStoreResult::Failed;
+    // Without MOVEFILE_REPLACE_EXISTING the move itself refuses an existing target
+    if (!MoveFileExA(from.c_str(), path_join(PRIVATE_VAULT_DIR, location).c_str(), 0)) {
+        const DWORD error = GetLastError();
+        return (error == ERROR_ALREADY_EXISTS || error == ERROR_FILE_EXISTS) ? VaultStoreResult::NameTaken
+                                                                             : VaultStoreResult::Failed;
+    }
+#else
+    const int from_dir = source_in_vault ? dir_handle : AT_FDCWD;
+    int result = rename_no_replace(from_dir, source.c_str(), dir_handle, location.c_str());
+    // Shard directories are only created when a rename first needs them
+    if (result != 0 && errno == ENOENT && make_parent_dirs(location)) {
+        result = rename_no_replace(from_dir, source.c_str(), dir_handle, location.c_str());
+    }
+    if (result != 0) {
+        if (errno == EEXIST) return VaultStoreResult::NameTaken;
+        if (errno != ENOSYS && errno != EINVAL && errno != ENOTSUP) return VaultStoreResult::Failed;
+
+        // No atomic variant here: check, then rename (a concurrent store can still slip in between)
+        struct stat st;
+        if (fstatat(dir_handle, location.c_str(), &st, AT_SYMLINK_NOFOLLOW) == 0) return VaultStoreResult::NameTaken;
+        if (!make_parent_dirs(location) || renameat(from_dir, source.c_str(), dir_handle, location.c_str()) != 0) {
+            return VaultStoreResult::Failed;
+        }
+    }
+#endif
+    return VaultStoreResult::Stored;
+}
+
+VaultStoreResult Vault::store(const std::string& source_path, VaultEntry entry) {
+    const std::string& name = entry.name;
+    if (!is_valid_entry_name(name) || !open()) return VaultStoreResult::Failed;
+    if (content_addressed()) return store_content(source_path, std::move(entry));
+
+    // A content-addressed entry has no file under its name, so the rename alone cannot see it;
+    // neither can it see a name that has not been migrated out of the flat layout yet
+    VaultEntry existing;
+    if (index.find(name, existing) && (existing.content_addressed || existing.pack_id != 0)) return VaultStoreResult::NameTaken;
+    if (flat_layout.load(std::memory_order_acquire) && location_info(name).exists) return VaultStoreResult::NameTaken;
+#if !defined(_WIN32) && !defined(_WIN64)
+    if (index.is_open() && entry.size < current_config().pack_threshold) return store_packed(source_path, std::move(entry));
+#endif
+    const VaultStoreResult moved = move_in(source_path, name_location(name));
+    if (moved != VaultStoreResult::Stored) return moved;
+
+    // The file is in place first, so the index never lists an entry that was not stored
+    entry.stored_ms = now_ms();
+    if (index.is_open() && !index.put(entry)) {
+        std::cerr << "Warning (Vault): '" << name << "' was stored but could not be added to the vault index.\n";
+    }
+    return VaultStoreResult::Stored;
+}
+
+VaultStoreResult Vault::store_content(const std::string& source_path, VaultEntry entry) {
+    if (!entry.has_digest) {
+        if (!HashService::instance().sha256_file(source_path, entry.digest)) return VaultStoreResult::Failed;
+        entry.has_digest = true;
+    }
+    // Entries stored by name (as files or packed) keep their name
+    VaultEntry existing;
+    if (index.find(entry.name, existing) && existing.pack_id != 0) return VaultStoreResult::NameTaken;
+    if (location_info(resolve_location(name_location(entry.name), entry.name)).exists) return VaultStoreResult::NameTaken;
+
+    const Sha256Digest digest = entry.digest;
+    bool deduplicated = false;
+    // Runs under the index's exclusive lock, so no other store or release races the object
+    const auto place_object = [&](bool object_indexed) {
+        if (!object_indexed || !location_info(resolve_location(object_location(digest), flat_object_location(digest))).is_regular) {
+            const VaultStoreResult moved = move_in(source_path, object_location(digest));
+            if (moved == VaultStoreResult::Failed) return false;
+            if (moved == VaultStoreResult::Stored) return true;
+            // NameTaken: an object left behind by an interrupted store holds the same content
+        }
+        deduplicated = (std::remove(source_path.c_str()) == 0);
+        return deduplicated;
+    };
+    const auto release_object = [this](const Sha256Digest& released) {
+        const std::string location = resolve_location(object_location(released), flat_object_location(released));
+        std::remove(path_join(PRIVATE_VAULT_DIR, location).c_str());
+    };
+
+    entry.content_addressed = true;
+    entry.stored_ms = now_ms();
+    if (!index.bind_content(entry, place_object, release_object)) return VaultStoreResult::Failed;
+    return deduplicated ? VaultStoreResult::Deduplicated : VaultStoreResult::Stored;
+}
+
+bool Vault::lookup(const std::string& name, VaultEntry& out_entry) {
+    return is_valid_entry_name(name) && open() && index.find(name, out_entry);
+}
+
+std::vector<VaultEntry> Vault::list() {
+    if (!open()) return {};
+    if (index.is_open()) return index.list();
+
+    // Without an index, fall back to what the directory itself can tell
+    std::vector<VaultEntry> entries;
+    for (const std::string& location : entry_locations()) {
+        const FileInfo info = location_info(location);
+        if (!info.is_regular) continue;
+        VaultEntry entry;
+        entry.name = path_get_filename(location);
+        entry.size = info.size;
+        entry.modified_ms = info.modified_ms;
+        entries.push_back(std::move(entry));
+    }
+    return entries;
+}
+
+std::vector<std::string> Vault::scan_entries() {
+    std::vector<std::string> names;
+    for (const std::string& location : entry_locations()) {
+        names.push_back(path_get_filename(location));
+    }
+    return names;
+}
+
+// Locations of the files stored by name: every shard, plus the top level until it is migrated
+std::vector<std::string> Vault::entry_locations() {
+    std::vector<std::string> locations = scan_shards("");
+    for (const std::string& name : scan_directory("", false)) {
+        if (!is_reserved_name(name)) locations.push_back(name);
+    }
+    return locations;
+}
+
+std::vector<std::string> Vault::object_locations() {
+    std::vector<std::string> locations = scan_shards(VAULT_OBJECTS_DIR);
+    for (const std::string& name : scan_directory(VAULT_OBJECTS_DIR, false)) {
+        locations.push_back(path_join(VAULT_OBJECTS_DIR, name));
+    }
+    return locations;
+}
+
+// Locations of the regular files in the two shard levels below 'base' ("" is the vault itself)
+std::vector<std::string> Vault::scan_shards(const std::string& base) {
+    std::vector<std::string> locations;
+    for (const std::string& outer : scan_directory(base, true)) {
+        if (!is_shard_name(outer)) continue;
+        const std::string outer_location = path_join(base, outer);
+        for (const std::string& inner : scan_directory(outer_location, true)) {
+            if (!is_shard_name(inner)) continue;
+            const std::string shard = path_join(outer_location, inner);
+            for (const std::string& name : scan_directory(shard, false)) {
+                locations.push_back(path_join(shard, name));
+            }
+        }
+    }
+    return locations;
+}
+
+// Names of the regular files (or with 'directories', the subdirectories) in 'relative_dir'. The
+// directory must already be open; open() itself calls this before publishing 'opened'.
+std::vector<std::string> Vault::scan_directory(const std::string& relative_dir, bool directories) {
+    std::vector<std::string> names;
+#if defined(_WIN32) || defined(_WIN64)
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA(path_join(path_join(PRIVATE_VAULT_DIR, relative_dir), "*").c_str(), &entry);
+    if (find == INVALID_HANDLE_VALUE) return names;
+    do {
+        const std::string name = entry.cFileName;
+        if (name == "." || name == "..") continue;
+        if (((entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) == directories) names.push_back(name);
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+    return names;
+#else
+    // fdopendir takes ownership of its descriptor, so it gets a fresh one positioned at the start
+    const int fd = openat(dir_handle, relative_dir.empty() ? "." : relative_dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return names;
+    DIR* dir = fdopendir(fd);
+    if (!dir) {
+        ::close(fd);
+        return names;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        if (name == "." || name == "..") continue;
+    #if defined(DT_REG) && defined(DT_DIR) && defined(DT_UNKNOWN)
+        if (entry->d_type != DT_UNKNOWN) {
+            if (entry->d_type == (directories ? DT_DIR : DT_REG)) names.push_back(name);
+            continue;
+        }
+    #endif
+        struct stat st;
+        if (fstatat(dirfd(dir), name.c_str(), &st, 0) == 0 && (directories ? S_ISDIR(st.st_mode) : S_ISREG(st.st_mode))) {
+            names.push_back(name);
+        }
+    }
+    closedir(dir);
+    return names;
+#endif
+}
+
+bool Vault::copy_out(const std::string& name, const std::string& destination_path,
+                     unsigned long long& out_bytes, const char*& out_io_backend) {
+    out_bytes = 0;
+    out_io_backend = IO_BACKEND_READ;
+    if (!is_valid_entry_name(name) || !open() || destination_in_vault(destination_path)) return false;
+    const auto copy_once = [&]() {
+        out_bytes = 0;
+        VaultEntry entry;
+        if (!index.find(name, entry)) entry.name = name;
+        if (entry.pack_id != 0) return copy_packed(entry, destination_path, out_bytes, out_io_backend);
+        return copy_location(data_location(entry), destination_path, out_bytes, out_io_backend);
+    };
+    // The migration or a repack may have moved the data between the lookup and the open
+    if (!copy_once() && !copy_once()) return false;
+    index.mark_retrieved(name, now_ms());
+    return true;
+}
+
+bool Vault::move_out(const std::string& name, const std::string& destination_path,
+                     unsigned long long& out_bytes, const char*& out_io_backend) {
+    out_bytes = 0;
+    out_io_backend = IO_BACKEND_RENAME;
+    if (!is_valid_entry_name(name) || !open() || destination_in_vault(destination_path)) return false;
+
+    VaultEntry entry;
+    if (!index.find(name, entry)) {
+        // Not indexed (no index, or the file predates it): the file under its name is the entry
+        return move_location(data_location(name), destination_path, out_bytes, out_io_backend);
+    }
+    // Data shared with other names stays in the vault; they still need it
+    return index.take(name, [&](const VaultEntry& taken, bool sole_owner) {
+        // A packed record cannot be renamed out of its pack; it is copied and left as garbage
+        if (taken.pack_id != 0) {
+            return copy_packed(taken, destination_path, out_bytes, out_io_backend) && mark_pack_record_removed(taken);
+        }
+        const std::string location = data_location(taken);
+        return sole_owner ? move_location(location, destination_path, out_bytes, out_io_backend)
+                          : copy_location(location, destination_path, out_bytes, out_io_backend);
+    });
+}
+
+// Whether 'destination_path' would land inside the vault directory (or any directory below it),
+// where writing could overwrite an entry's data, a pack or the index. Directories are compared
+// by identity, so other spellings and symlinked paths are caught too.
+bool Vault::destination_in_vault(const std::string& destination_path) {
+    bool inside = false;
+#if defined(_WIN32) || defined(_WIN64)
+    char vault_full[MAX_PATH], destination_full[MAX_PATH];
+    const DWORD vault_length = GetFullPathNameA(PRIVATE_VAULT_DIR.c_str(), MAX_PATH, vault_full, nullptr);
+    const DWORD destination_length = GetFullPathNameA(destination_path.c_str(), MAX_PATH, destination_full, nullptr);
+    inside = vault_length == 0 || vault_length >= MAX_PATH || destination_length == 0 || destination_length >= MAX_PATH ||
+             (destination_length > vault_length && _strnicmp(vault_full, destination_full, vault_length) == 0 &&
+              (destination_full[vault_length] == '\\' || destination_full[vault_length] == '/'));
+#else
+    struct stat vault_st;
+    int dir = ::open(path_get_parent(destination_path).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir < 0 || fstat(dir_handle, &vault_st) != 0) {
+        if (dir >= 0) ::close(dir);
+        return false; // The copy itself then fails on the missing directory
+    }
+    // Walk up to the root, checking every ancestor against the vault directory
+    for (;;) {
+        struct stat dir_st, parent_st;
+        if (fstat(dir, &dir_st) != 0) break;
+        if (dir_st.st_dev == vault_st.st_dev && dir_st.st_ino == vault_st.st_ino) {
+            inside = true;
+            break;
+        }
+        const int parent = openat(dir, "..", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (parent < 0) break;
+        const bool at_root = fstat(parent, &parent_st) == 0 && parent_st.st_dev == dir_st.st_dev && parent_st.st_ino == dir_st.st_ino;
+        ::close(dir);
+        dir = parent;
+        if (at_root) break;
+    }
+    ::close(dir);
+#endif
+    if (inside) std::cerr << "Error (Vault): Destination '" << destination_path << "' is inside the vault.\n";
+    return inside;
+}
+
+bool Vault::copy_location(const std::string& location, const std::string& destination_path,
+                          unsigned long long& out_bytes, const char*& out_io_backend) {
+    out_bytes = 0;
+#if defined(_WIN32) || defined(_WIN64)
+    // CopyFile copies inside the system (block cloning on ReFS) instead of through this process
+    out_io_backend = IO_BACKEND_COPY_RANGE;
+    if (!CopyFileA(path_join(PRIVATE_VAULT_DIR, location).c_str(), destination_path.c_str(), FALSE)) return false;
+    out_bytes = get_file_info(destination_path).size;
+    return true;
+#else
+    const int from = openat(dir_handle, location.c_str(), O_RDONLY | O_CLOEXEC);
+    if (from < 0) return false;
+    const int to = open_copy_destination(destination_path, from);
+    if (to < 0) {
+        ::close(from);
+        return false;
+    }
+    bool ok = copy_descriptor(from, to, COPY_TO_END, out_bytes, out_io_backend);
+    ok = (::close(to) == 0) && ok;
+    ::close(from);
+    return ok;
+#endif
+}
+
+// Moves the data at 'location' out of the vault, by rename when the destination is on the same
+// filesystem and by copy and delete otherwise
+bool Vault::move_location(const std::string& location, const std::string& destination_path,
+                          unsigned long long& out_bytes, const char*& out_io_backend) {
+    const FileInfo info = location_info(location);
+    if (!info.is_regular) return false;
+    out_io_backend = IO_BACKEND_RENAME;
+#if defined(_WIN32) || defined(_WIN64)
+    if (!MoveFileExA(path_join(PRIVATE_VAULT_DIR, location).c_str(), destination_path.c_str(),
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED)) {
+        return false;
+    }
+#else
+    if (renameat(dir_handle, location.c_str(), AT_FDCWD, destination_path.c_str()) != 0) {
+        if (errno != EXDEV) return false;
+        if (!copy_location(location, destination_path, out_bytes, out_io_backend)) return false;
+        if (unlinkat(dir_handle, location.c_str(), 0) != 0) {
+            std::cerr << "Warning (Vault): '" << location << "' was copied out but could not be removed from the vault.\n";
+        }
+        return true;
+    }
+#endif
+    out_bytes = info.size;
+    return true;
+}
+
+// --- Packfiles ---
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+VaultStoreResult Vault::store_packed(const std::string& source_path, VaultEntry entry) {
+    const int source = ::open(source_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (source < 0) return VaultStoreResult::Failed;
+    struct stat st;
+    if (fstat(source, &st) != 0) {
+        ::close(source);
+        return VaultStoreResult::Failed;
+    }
+    entry.size = static_cast<unsigned long long>(st.st_size);
+    entry.stored_ms = now_ms();
+    const bool sync = current_config().sync_packs;
+    bool name_taken = false;
+    const bool stored = index.put_new(entry, [&](VaultEntry& placed) {
+        // A file stored under the name before packing (or unknown to the index) still holds it
+        if (location_info(resolve_location(name_location(placed.name), placed.name)).exists) {
+            name_taken = true;
+            return false;
+        }
+        return append_pack_record(placed.name, placed.modified_ms, source, placed.size, sync, placed.pack_id, placed.pack_offset);
+    }, name_taken);
+    ::close(source);
+    if (name_taken) return VaultStoreResult::NameTaken;
+    if (!stored) return VaultStoreResult::Failed;
+
+    // The original goes only once its bytes are in the pack
+    if (std::remove(source_path.c_str()) != 0) {
+        std::cerr << "Warning (Vault): '" << entry.name << "' was packed but the original could not be removed.\n";
+    }
+    return VaultStoreResult::Stored;
+}
+
+// Appends a record for 'name' with 'size' bytes read from the current offset of 'source' to the
+// active packfile, starting a new one when it is full. Runs under the index's exclusive lock,
+// which is what keeps appends from several threads or processes apart.
+bool Vault::append_pack_record(const std::string& name, long long modified_ms, int source, unsigned long long size,
+                               bool sync, unsigned int& out_pack_id, unsigned long long& out_offset) {
+    const unsigned long long max_bytes = current_config().pack_max_bytes;
+    const unsigned long long length = pack_record_length(name.size(), size);
+    if (active_pack == 0) active_pack = std::max(1u, highest_pack_id());
+
+    int pack = -1;
+    unsigned long long offset = 0;
+    for (;;) {
+        const std::string location = pack_location(active_pack);
+        pack = openat(dir_handle, location.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (pack < 0 && errno == ENOENT && make_parent_dirs(location)) {
+            pack = openat(dir_handle, location.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        }
+        if (pack < 0) return false;
+        struct stat st;
+        if (fstat(pack, &st) != 0) {
+            ::close(pack);
+            return false;
+        }
+        offset = align8(static_cast<unsigned long long>(st.st_size));
+        if (offset == 0) {
+            if (!write_all(pack, reinterpret_cast<const unsigned char*>(PACK_MAGIC), sizeof(PACK_MAGIC))) {
+                ::close(pack);
+                return false;
+            }
+            offset = sizeof(PACK_MAGIC);
+        }
+        // A record larger than a whole pack still gets a pack of its own
+        if (offset == sizeof(PACK_MAGIC) || offset + length <= max_bytes) break;
+        ::close(pack);
+        active_pack++;
+    }
+
+    PackRecordHeader header{};
+    std::memcpy(header.magic, PACK_RECORD_MAGIC, sizeof(header.magic));
+    header.size = size;
+    header.modified_ms = modified_ms;
+    header.name_length = static_cast<unsigned int>(name.size());
+    std::vector<unsigned char> head(sizeof(header) + name.size());
+    std::memcpy(head.data(), &header, sizeof(header));
+    std::memcpy(head.data() + sizeof(header), name.data(), name.size());
+
+    static constexpr unsigned char PADDING[8] = {};
+    unsigned long long copied = 0;
+    const char* io_backend = nullptr;
+    bool ok = lseek(pack, static_cast<off_t>(offset), SEEK_SET) >= 0 && write_all(pack, head.data(), head.size()) &&
+              copy_descriptor(source, pack, size, copied, io_backend) && copied == size &&
+              write_all(pack, PADDING, static_cast<size_t>(length - head.size() - size)) &&
+              (!sync || sync_data(pack));
+    if (!ok && ftruncate(pack, static_cast<off_t>(offset)) != 0) {
+        std::cerr << "Warning (Vault): A failed append left a partial record in '" << pack_location(active_pack) << "'.\n";
+    }
+    ::close(pack);
+    if (!ok) return false;
+    out_pack_id = active_pack;
+    out_offset = offset;
+    return true;
+}
+
+// Checks that the record the index points at is still the entry's, so a lookup that raced a
+// repack fails (and is retried) instead of returning some other bytes
+bool Vault::copy_packed(const VaultEntry& entry, const std::string& destination_path,
+                        unsigned long long& out_bytes, const char*& out_io_backend) {
+    out_bytes = 0;
+    const int pack = openat(dir_handle, pack_location(entry.pack_id).c_str(), O_RDONLY | O_CLOEXEC);
+    if (pack < 0) return false;
+    std::vector<char> head(sizeof(PackRecordHeader) + entry.name.size());
+    PackRecordHeader header{};
+    bool ok = pread(pack, head.data(), head.size(), static_cast<off_t>(entry.pack_offset)) == static_cast<ssize_t>(head.size());
+    if (ok) {
+        std::memcpy(&header, head.data(), sizeof(header));
+        ok = std::memcmp(header.magic, PACK_RECORD_MAGIC, sizeof(header.magic)) == 0 && header.size == entry.size &&
+             header.name_length == entry.name.size() && !(header.flags & PACK_RECORD_REMOVED) &&
+             std::memcmp(head.data() + sizeof(header), entry.name.data(), entry.name.size()) == 0;
+    }
+    if (!ok) {
+        ::close(pack);
+        return false;
+    }
+    const int to = open_copy_destination(destination_path, pack);
+    if (to < 0) {
+        ::close(pack);
+        return false;
+    }
+    ok = lseek(pack, static_cast<off_t>(pack_data_offset(entry)), SEEK_SET) >= 0 &&
+         copy_descriptor(pack, to, entry.size, out_bytes, out_io_backend) && out_bytes == entry.size;
+    ok = (::close(to) == 0) && ok;
+    ::close(pack);
+    return ok;
+}
+
+// Flags the record so a rebuilt index does not bring the entry back; the bytes stay until a repack
+bool Vault::mark_pack_record_removed(const VaultEntry& entry) {
+    const int pack = openat(dir_handle, pack_location(entry.pack_id).c_str(), O_WRONLY | O_CLOEXEC);
+    if (pack < 0) return false;
+    const unsigned int flags = PACK_RECORD_REMOVED;
+    const bool ok = pwrite(pack, &flags, sizeof(flags), static_cast<off_t>(entry.pack_offset + offsetof(PackRecordHeader, flags))) ==
+                    static_cast<ssize_t>(sizeof(flags));
+    ::close(pack);
+    return ok;
+}
+
+// Every call gets a file of its own, named "<pid>-<n>" so clear_unpacked() can tell the copies
+// of running processes from those a crash left behind
+bool Vault::extract_packed(const VaultEntry& entry, VaultEntryFile& out_file) {
+    const std::string prefix = std::to_string(getpid()) + "-";
+    VaultEntryFile file;
+    for (int attempt = 0; attempt < 8 && !file.is_open(); ++attempt) {
+        const std::string location = path_join(VAULT_UNPACKED_DIR, prefix + std::to_string(extracted++));
+        int fd = openat(dir_handle, location.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if (fd < 0 && errno == ENOENT && make_parent_dirs(location)) {
+            fd = openat(dir_handle, location.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        }
+        if (fd < 0) {
+            if (errno == EEXIST) continue; // Left by an earlier process with the same pid
+            return false;
+        }
+        ::close(fd);
+        file.file_path = path_join(PRIVATE_VAULT_DIR, location);
+        file.temporary = true;
+    }
+    unsigned long long bytes = 0;
+    const char* io_backend = nullptr;
+    // On failure 'file' deletes the partial copy
+    if (!file.is_open() || !copy_packed(entry, file.file_path, bytes, io_backend)) return false;
+    out_file = std::move(file);
+    return true;
+}
+
+// Indexes the live records of one packfile, for rebuild_index()
+size_t Vault::index_pack(unsigned int pack_id) {
+    FileView view;
+    if (!view.open(path_join(PRIVATE_VAULT_DIR, pack_location(pack_id))) || view.size() < sizeof(PACK_MAGIC) ||
+        std::memcmp(view.bytes(), PACK_MAGIC, sizeof(PACK_MAGIC)) != 0) {
+        return 0;
+    }
+    size_t indexed = 0;
+    unsigned long long offset = sizeof(PACK_MAGIC);
+    while (offset + sizeof(PackRecordHeader) <= view.size()) {
+        PackRecordHeader header;
+        std::memcpy(&header, view.bytes() + offset, sizeof(header));
+        const bool valid = std::memcmp(header.magic, PACK_RECORD_MAGIC, sizeof(header.magic)) == 0 &&
+                           header.size <= view.size() && header.name_length <= view.size() &&
+                           offset + pack_record_length(header.name_length, header.size) <= view.size();
+        if (!valid) {
+            // Left by an append a crash interrupted; the next record starts at a later 8-byte boundary
+            offset += 8;
+            continue;
+        }
+        if (!(header.flags & PACK_RECORD_REMOVED)) {
+            VaultEntry entry;
+            entry.name.assign(reinterpret_cast<const char*>(view.bytes() + offset + sizeof(header)), header.name_length);
+            entry.size = header.size;
+            entry.modified_ms = header.modified_ms;
+            entry.stored_ms = header.modified_ms;
+            entry.pack_id = pack_id;
+            entry.pack_offset = offset;
+            if (is_valid_entry_name(entry.name) && index.put(entry)) indexed++;
+        }
+        offset += pack_record_length(header.name_length, header.size);
+    }
+    return indexed;
+}
+
+unsigned int Vault::highest_pack_id() {
+    unsigned int highest = 0;
+    for (const std::string& name : scan_directory(VAULT_PACKS_DIR, false)) {
+        unsigned int pack_id = 0;
+        if (parse_pack_name(name, pack_id)) highest = std::max(highest, pack_id);
+    }
+    return highest;
+}
+
+// Rewrites the packfiles that are mostly records of entries no longer in the vault
+void Vault::repack_packs() {
+    if (!index.is_open()) return;
+    const double garbage_ratio = current_config().repack_garbage_ratio;
+    std::unordered_map<unsigned int, unsigned long long> live_bytes;
+    for (const VaultEntry& entry : index.list()) {
+        if (entry.pack_id != 0) live_bytes[entry.pack_id] += pack_record_length(entry.name.size(), entry.size);
+    }
+    size_t repacked = 0;
+    for (const std::string& name : scan_directory(VAULT_PACKS_DIR, false)) {
+        if (stopping.load(std::memory_order_relaxed)) return;
+        unsigned int pack_id = 0;
+        if (!parse_pack_name(name, pack_id)) continue;
+        const unsigned long long size = location_info(pack_location(pack_id)).size;
+        const unsigned long long live = sizeof(PACK_MAGIC) + live_bytes[pack_id];
+        if (size <= live || static_cast<double>(size - live) < garbage_ratio * static_cast<double>(size)) continue;
+        if (repack(pack_id)) repacked++;
+    }
+    if (repacked > 0) {
+        std::cout << "Info: Repacked " << repacked << " vault packfile(s).\n";
+    }
+}
+
+// Moves the live records of 'pack_id' into a fresh pack, repoints the index, then deletes the old pack
+bool Vault::repack(unsigned int pack_id) {
+    const bool sync = current_config().sync_packs;
+    const bool moved = index.repack(pack_id, [&](std::vector<VaultEntry>& entries) {
+        if (entries.empty()) return true;
+        const int old_pack = openat(dir_handle, pack_location(pack_id).c_str(), O_RDONLY | O_CLOEXEC);
+        if (old_pack < 0) return false;
+        // Never append to the pack being emptied
+        active_pack = std::max(highest_pack_id(), pack_id) + 1;
+        bool ok = true;
+        std::vector<unsigned int> written;
+        for (VaultEntry& entry : entries) {
+            ok = lseek(old_pack, static_cast<off_t>(pack_data_offset(entry)), SEEK_SET) >= 0 &&
+                 append_pack_record(entry.name, entry.modified_ms, old_pack, entry.size, false, entry.pack_id, entry.pack_offset);
+            if (!ok) break;
+            if (written.empty() || written.back() != entry.pack_id) written.push_back(entry.pack_id);
+        }
+        ::close(old_pack);
+        // One sync per pack written rather than one per record, before the index points at them
+        for (unsigned int written_id : written) {
+            if (!ok || !sync) break;
+            const int pack = openat(dir_handle, pack_location(written_id).c_str(), O_RDONLY | O_CLOEXEC);
+            ok = pack >= 0 && sync_data(pack);
+            if (pack >= 0) ::close(pack);
+        }
+        return ok;
+    });
+    return moved && unlinkat(dir_handle, pack_location(pack_id).c_str(), 0) == 0;
+}
+
+// Removes the copies left by processes that ended without closing their VaultEntryFiles. Those of
+// other running processes may still be open and stay.
+void Vault::clear_unpacked() {
+    const pid_t self = getpid();
+    for (const std::string& name : scan_directory(VAULT_UNPACKED_DIR, false)) {
+        const pid_t owner = static_cast<pid_t>(std::strtol(name.c_str(), nullptr, 10));
+        if (owner > 0 && owner != self && (kill(owner, 0) == 0 || errno == EPERM)) continue;
+        unlinkat(dir_handle, path_join(VAULT_UNPACKED_DIR, name).c_str(), 0);
+    }
+}
+
+#else
+
+// Packfiles are POSIX-only; a Windows vault never creates one, so there is nothing to read
+bool Vault::copy_packed(const VaultEntry&, const std::string&, unsigned long long& out_bytes, const char*&) {
+    out_bytes = 0;
+    return false;
+}
+
+bool Vault::mark_pack_record_removed(const VaultEntry&) {
+    return false;
+}
+
+bool Vault::extract_packed(const VaultEntry&, VaultEntryFile&) {
+    return false;
+}
+
+size_t Vault::index_pack(unsigned int) {
+    return 0;
+}
+
+void Vault::repack_packs() {}
+
+void Vault::clear_unpacked() {}
+
+#endif
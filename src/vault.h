@@ -0,0 +1,216 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cipher_utils.h" // For FileInfo, PRIVATE_VAULT_DIR
+#include "vault_index.h"  // For VaultIndex, VaultEntry
+
+// --- Files ---
+// Object store of content-addressed entries, one file per distinct content named by its SHA-256
+extern const std::string VAULT_OBJECTS_DIR; // .objects (inside PRIVATE_VAULT_DIR)
+// Packfiles holding small originals back to back
+extern const std::string VAULT_PACKS_DIR;    // .packs (inside PRIVATE_VAULT_DIR)
+// Temporary copies of packed entries for code that needs a path (see VaultEntryFile)
+extern const std::string VAULT_UNPACKED_DIR; // .unpacked (inside PRIVATE_VAULT_DIR)
+
+// --- Configuration ---
+
+struct VaultConfig {
+    // Originals smaller than this are appended to a packfile instead of becoming a file of their
+    // own (0 disables packing). Content-addressed vaults never pack.
+    unsigned long long pack_threshold = 64 * 1024;
+    unsigned long long pack_max_bytes = 64ull * 1024 * 1024; // A new packfile is started past this
+    bool sync_packs = true;           // fdatasync each append before the original is removed
+    double repack_garbage_ratio = 0.5; // Packfiles at least this much garbage are rewritten
+};
+
+// --- Structures ---
+
+enum class VaultStoreResult {
+    Stored,
+    Deduplicated, // Content-addressed: the content was already stored, so the source was removed
+    NameTaken, // An entry with that name already exists; nothing was moved
+    Failed
+};
+
+// --- Entry Files ---
+
+// Path to one entry's data for code that opens vault files by path (verification, diffs, peg
+// recovery). A packed entry has no file of its own, so it is copied to a temporary file in
+// VAULT_UNPACKED_DIR that belongs to this handle alone and is deleted with it; keep the handle
+// for as long as the path is in use. Move-only.
+class VaultEntryFile {
+public:
+    VaultEntryFile() noexcept = default;
+    ~VaultEntryFile() noexcept;
+
+    VaultEntryFile(VaultEntryFile&& other) noexcept;
+    VaultEntryFile& operator=(VaultEntryFile&& other) noexcept;
+
+    const std::string& path() const noexcept { return file_path; }
+    bool is_open() const noexcept { return !file_path.empty(); }
+    void close() noexcept;
+
+    // Disable copy operations; a temporary copy is deleted exactly once
+    VaultEntryFile(const VaultEntryFile&) = delete;
+    VaultEntryFile& operator=(const VaultEntryFile&) = delete;
+
+private:
+    friend class Vault;
+
+    std::string file_path;
+    bool temporary = false; // file_path is an extracted copy, removed by close()
+};
+
+// --- Vault ---
+
+// Handle to PRIVATE_VAULT_DIR. The directory is opened (and created if missing) once per
+// process; every entry operation after that is resolved relative to the open directory with
+// openat/fstatat/renameat, so it costs a single name lookup and keeps working if the working
+// directory is renamed underneath the process. Windows has no directory descriptors, so there
+// the same operations fall back to full paths.
+//
+// Entries are sharded over two directory levels named by hex bytes (<aa>/<bb>/<name>, from a hash
+// of the name; objects use the leading bytes of their digest), so no directory grows past a few
+// entries per 65536 stored. Vaults from before sharding kept every file at the top level; they
+// are migrated by a background thread the first time they are opened, and lookups fall back to
+// the old location until the migration is recorded in the index.
+//
+// Entry names are bare filenames; names containing a path separator (or "." / "..") are
+// rejected, so an entry operation can never reach outside the vault. The vault's own files
+// (VAULT_INDEX_FILE and its backup, VAULT_LOCK_FILE, VAULT_OBJECTS_DIR, VAULT_PACKS_DIR,
+// VAULT_UNPACKED_DIR) are reserved names.
+//
+// Stores and retrievals also maintain a VaultIndex, so entries can be looked up and listed with
+// their metadata without touching the directory. If the index is missing when the vault is
+// opened it is rebuilt from the directory (sizes and times only).
+//
+// Originals below VaultConfig::pack_threshold are appended to packfiles in VAULT_PACKS_DIR
+// instead, each record located by its pack and offset in the index, which saves an inode and a
+// directory entry per small file. Removed records stay in their pack as garbage until the
+// background pass that runs when the vault opens rewrites packs holding mostly garbage.
+// Packfiles are read and written with POSIX descriptors; on Windows every entry is a file.
+//
+// When the vault is content-addressed, an entry's data is stored once per distinct content in
+// VAULT_OBJECTS_DIR and the index binds the entry name to it, counting references, so storing
+// the same original under several names keeps one copy. Entries stored before the switch stay
+// where they are; every operation below resolves a name to wherever its data lives.
+class Vault {
+public:
+    // Returns the process-wide vault (nothing is opened until first use)
+    static Vault& instance();
+
+    // Opens the vault directory (creating it if needed) and its index. Cheap once it has succeeded.
+    bool open();
+
+    void configure(const VaultConfig& new_config);
+
+    // Whether new entries are stored content-addressed. Kept in the index, so the choice is shared
+    // by every process using the vault; without an index it is always off.
+    bool content_addressed();
+    bool set_content_addressed(bool enabled);
+
+    // One fstatat() of the entry's data; 'exists' is false for unknown or invalid names
+    FileInfo entry_info(const std::string& name);
+
+    // Moves 'source_path' into the vault as 'entry.name', then indexes 'entry' (stored_ms is
+    // set here; the caller fills in what it knows). The name check and the move are one atomic
+    // rename where the platform supports it (renameat2 RENAME_NOREPLACE, renameatx_np).
+    // Content-addressed, the digest is computed if the caller has none, and a name that is
+    // already content-addressed is rebound to the new content instead of being reported taken.
+    VaultStoreResult store(const std::string& source_path, VaultEntry entry);
+
+    // Index lookup; does not touch the vault directory
+    bool lookup(const std::string& name, VaultEntry& out_entry);
+
+    // Every indexed entry with its metadata, in the order they were stored
+    std::vector<VaultEntry> list();
+
+    // Copies entry 'name' to 'destination_path' (created or truncated). 'out_bytes' receives
+    // the bytes copied and 'out_io_backend' the IO_BACKEND_* constant describing how: a reflink
+    // clone where the filesystem supports it, else copy_file_range, else sendfile, and only then
+    // a read/write loop.
+    bool copy_out(const std::string& name, const std::string& destination_path,
+                  unsigned long long& out_bytes, const char*& out_io_backend);
+
+    // Moves entry 'name' out of the vault to 'destination_path' (replacing it) and forgets the
+    // entry: a rename where possible, so nothing is copied. Data that other names still share
+    // (content-addressed) is copied out instead and stays in the vault.
+    bool move_out(const std::string& name, const std::string& destination_path,
+                  unsigned long long& out_bytes, const char*& out_io_backend);
+
+    // Names of the files stored by name in the vault, unordered. A full scan of every shard; use
+    // list() unless the directory itself is in question.
+    std::vector<std::string> scan_entries();
+
+    // Opens 'out_file' on entry 'name''s data for code that opens vault files by path. Returns
+    // false (with an error on stderr) for an invalid name or a packed entry that could not be
+    // extracted; a missing entry stored by name shows up when the path is opened.
+    bool entry_file(const std::string& name, VaultEntryFile& out_file);
+
+    static bool is_valid_entry_name(const std::string& name);
+
+    // Disable copy and move operations; there is exactly one vault handle
+    Vault(const Vault&) = delete;
+    Vault& operator=(const Vault&) = delete;
+    Vault(Vault&&) = delete;
+    Vault& operator=(Vault&&) = delete;
+
+private:
+    Vault() noexcept = default;
+    ~Vault();
+
+    void rebuild_index();
+    void run_maintenance();
+    void migrate_flat_layout();
+    // Where the data of entry 'name' lives, relative to the vault directory
+    std::string data_location(const std::string& name);
+    std::string data_location(const VaultEntry& entry);
+    std::string resolve_location(const std::string& sharded, const std::string& flat);
+    FileInfo location_info(const std::string& location);
+    bool make_parent_dirs(const std::string& location);
+    bool destination_in_vault(const std::string& destination_path);
+    bool copy_location(const std::string& location, const std::string& destination_path,
+                       unsigned long long& out_bytes, const char*& out_io_backend);
+    bool move_location(const std::string& location, const std::string& destination_path,
+                       unsigned long long& out_bytes, const char*& out_io_backend);
+    VaultStoreResult move_in(const std::string& source, const std::string& location, bool source_in_vault = false);
+    VaultStoreResult store_content(const std::string& source_path, VaultEntry entry);
+    VaultConfig current_config();
+
+    // --- Packfiles ---
+    VaultStoreResult store_packed(const std::string& source_path, VaultEntry entry);
+    bool append_pack_record(const std::string& name, long long modified_ms, int source, unsigned long long size,
+                            bool sync, unsigned int& out_pack_id, unsigned long long& out_offset);
+    bool copy_packed(const VaultEntry& entry, const std::string& destination_path,
+                     unsigned long long& out_bytes, const char*& out_io_backend);
+    bool mark_pack_record_removed(const VaultEntry& entry);
+    bool extract_packed(const VaultEntry& entry, VaultEntryFile& out_file);
+    size_t index_pack(unsigned int pack_id);
+    unsigned int highest_pack_id();
+    void repack_packs();
+    bool repack(unsigned int pack_id);
+    void clear_unpacked();
+    std::vector<std::string> entry_locations();
+    std::vector<std::string> object_locations();
+    std::vector<std::string> scan_shards(const std::string& base);
+    std::vector<std::string> scan_directory(const std::string& relative_dir, bool directories);
+
+    std::mutex open_mutex; // Guards the first open only; entry operations need no lock
+    std::atomic<bool> opened{false}; // Set once the directory and index are ready for entry operations
+    VaultIndex index;
+    std::atomic<bool> flat_layout{true}; // Files may still be at their pre-sharding locations
+    std::atomic<bool> stopping{false};   // Asks the maintenance thread to stop early
+    std::thread maintenance;             // Layout migration and repacking after open
+    std::mutex config_mutex;
+    VaultConfig config;
+    unsigned int active_pack = 0;        // Packfile taking appends; only used under the index lock
+    std::atomic<unsigned int> extracted{0}; // Names this process's VaultEntryFile copies
+#if !defined(_WIN32) && !defined(_WIN64)
+    int dir_handle = -1;
+#endif
+};
@@ -0,0 +1,793 @@
+#include "vault_index.h"
+#include "cipher_utils.h" // For path_join
+
+#include <algorithm> // For std::max
+#include <cstring>   // For std::memcpy, std::memcmp, std::memset
+#include <cerrno>
+#include <iostream>
+
+#if defined(_WIN32) || defined(_WIN64)
+    #include <windows.h> // For CreateFileMappingA, MapViewOfFile, LockFileEx
+#else
+    #include <fcntl.h>    // For openat
+    #include <unistd.h>   // For ftruncate, write, fsync, close
+    #include <sys/file.h> // For flock
+    #include <sys/mman.h> // For mmap, munmap
+    #include <sys/stat.h> // For fstat
+    #include <cstdio>     // For renameat
+#endif
+
+// --- Definitions for Global Constants ---
+const std::string VAULT_INDEX_FILE = ".vault_index";
+const std::string VAULT_LOCK_FILE = ".vault_lock";
+const std::string VAULT_INDEX_BACKUP_FILE = ".vault_index.old";
+
+// --- Anonymous Namespace for INTERNAL (File-Local) Helper Functions ---
+namespace {
+
+    const std::string VAULT_INDEX_TEMP_FILE = VAULT_INDEX_FILE + ".tmp";
+
+    constexpr unsigned long long align8(unsigned long long value) noexcept { return (value + 7) & ~7ull; }
+
+    unsigned long long record_length(const VaultIndexRecord& record) noexcept {
+        return align8(sizeof(VaultIndexRecord) + record.name_length + record.original_length + record.encrypted_length);
+    }
+
+    unsigned long long name_hash(const std::string& name) noexcept {
+        return HashService::fast_hash_buffer(name.data(), name.size());
+    }
+
+    unsigned long long table_end(unsigned long long bucket_count) noexcept {
+        return sizeof(VaultIndexHeader) + bucket_count * sizeof(unsigned long long);
+    }
+
+    // Offsets are published with a release store so a reader that sees one also sees the
+    // record it points to
+    void publish(unsigned long long* slot, unsigned long long value) noexcept {
+        __atomic_store_n(slot, value, __ATOMIC_RELEASE);
+    }
+
+    const char* record_text(const VaultIndexRecord* record) noexcept {
+        return reinterpret_cast<const char*>(record) + sizeof(VaultIndexRecord);
+    }
+
+    VaultEntry decode_record(const VaultIndexRecord* record) {
+        VaultEntry entry;
+        const char* text = record_text(record);
+        entry.name.assign(text, record->name_length);
+        entry.original_path.assign(text + record->name_length, record->original_length);
+        entry.encrypted_path.assign(text + record->name_length + record->original_length, record->encrypted_length);
+        entry.size = record->size;
+        entry.modified_ms = record->modified_ms;
+        entry.stored_ms = record->stored_ms;
+        entry.retrieved_ms = record->retrieved_ms;
+        entry.pegs = record->pegs;
+        entry.has_digest = (record->flags & VAULT_RECORD_HAS_DIGEST) != 0;
+        entry.content_addressed = (record->flags & VAULT_RECORD_CONTENT) != 0;
+        entry.pack_id = record->pack_id;
+        entry.pack_offset = record->pack_offset;
+        std::memcpy(entry.digest.bytes.data(), record->digest, sizeof(record->digest));
+        return entry;
+    }
+
+    // Writes 'entry' as a record at 'out' (which has record_length() bytes of room)
+    void encode_record(const VaultEntry& entry, unsigned long long hash, unsigned char* out) {
+        VaultIndexRecord record{};
+        record.name_hash = hash;
+        record.size = entry.size;
+        record.modified_ms = entry.modified_ms;
+        record.stored_ms = entry.stored_ms;
+        record.retrieved_ms = entry.retrieved_ms;
+        record.pegs = entry.pegs;
+        record.flags = entry.has_digest ? VAULT_RECORD_HAS_DIGEST : 0;
+        record.pack_id = entry.pack_id;
+        record.pack_offset = entry.pack_offset;
+        std::memcpy(record.digest, entry.digest.bytes.data(), sizeof(record.digest));
+        record.name_length = static_cast<unsigned short>(entry.name.size());
+        record.original_length = static_cast<unsigned short>(entry.original_path.size());
+        record.encrypted_length = static_cast<unsigned short>(entry.encrypted_path.size());
+        std::memcpy(out, &record, sizeof(record));
+        unsigned char* text = out + sizeof(record);
+        std::memcpy(text, entry.name.data(), entry.name.size());
+        std::memcpy(text + entry.name.size(), entry.original_path.data(), entry.original_path.size());
+        std::memcpy(text + entry.name.size() + entry.original_path.size(), entry.encrypted_path.data(), entry.encrypted_path.size());
+    }
+
+    // --- Earlier Formats ---
+    // The header has not changed since CGVIDX1. Records gained the reference count in CGVIDX2 and
+    // the pack fields in CGVIDX3; an index in an earlier format is converted when it is opened.
+    struct VaultIndexRecordV1 {
+        unsigned long long next;
+        unsigned long long name_hash;
+        unsigned long long size;
+        long long modified_ms;
+        long long stored_ms;
+        long long retrieved_ms;
+        int pegs;
+        unsigned int flags;
+        unsigned char digest[32];
+        unsigned short name_length;
+        unsigned short original_length;
+        unsigned short encrypted_length;
+        unsigned short reserved;
+    };
+
+    struct VaultIndexRecordV2 {
+        unsigned long long next;
+        unsigned long long name_hash;
+        unsigned long long size;
+        long long modified_ms;
+        long long stored_ms;
+        long long retrieved_ms;
+        unsigned long long refcount;
+        int pegs;
+        unsigned int flags;
+        unsigned char digest[32];
+        unsigned short name_length;
+        unsigned short original_length;
+        unsigned short encrypted_length;
+        unsigned short reserved;
+    };
+
+    unsigned long long legacy_refcount(const VaultIndexRecordV1&) noexcept { return 0; } // No objects before CGVIDX2
+    unsigned long long legacy_refcount(const VaultIndexRecordV2& record) noexcept { return record.refcount; }
+
+    // Appends the live records of an earlier-format heap to 'image' (which holds a zeroed header
+    // and bucket table for 'bucket_count' buckets) as current records, linking each into its bucket
+    template <typename LegacyRecord>
+    void convert_records(const unsigned char* data, const VaultIndexHeader& header, unsigned long long bucket_count,
+                         std::vector<unsigned char>& image, unsigned long long& out_live, unsigned long long& out_objects) {
+        unsigned long long offset = align8(table_end(header.bucket_count));
+        while (offset + sizeof(LegacyRecord) <= header.used_bytes) {
+            LegacyRecord old_record;
+            std::memcpy(&old_record, data + offset, sizeof(old_record));
+            const size_t text_length = static_cast<size_t>(old_record.name_length) + old_record.original_length +
+                                       old_record.encrypted_length;
+            const unsigned long long length = align8(sizeof(LegacyRecord) + text_length);
+            if (offset + length > header.used_bytes) break;
+            if (!(old_record.flags & VAULT_RECORD_DEAD)) {
+                const unsigned char* text = data + offset + sizeof(LegacyRecord);
+                VaultIndexRecord record{};
+                record.name_hash = HashService::fast_hash_buffer(text, old_record.name_length);
+                record.size = old_record.size;
+                record.modified_ms = old_record.modified_ms;
+                record.stored_ms = old_record.stored_ms;
+                record.retrieved_ms = old_record.retrieved_ms;
+                record.refcount = legacy_refcount(old_record);
+                record.pegs = old_record.pegs;
+                record.flags = old_record.flags;
+                std::memcpy(record.digest, old_record.digest, sizeof(record.digest));
+                record.name_length = old_record.name_length;
+                record.original_length = old_record.original_length;
+                record.encrypted_length = old_record.encrypted_length;
+
+                const size_t new_offset = image.size();
+                image.resize(new_offset + static_cast<size_t>(align8(sizeof(record) + text_length)));
+                auto* new_buckets = reinterpret_cast<unsigned long long*>(image.data() + sizeof(VaultIndexHeader));
+                unsigned long long& head = new_buckets[record.name_hash & (bucket_count - 1)];
+                record.next = head;
+                head = new_offset;
+                std::memcpy(image.data() + new_offset, &record, sizeof(record));
+                std::memcpy(image.data() + new_offset + sizeof(record), text, text_length);
+                out_live++;
+                if (record.flags & VAULT_RECORD_OBJECT) out_objects++;
+            }
+            offset += length;
+        }
+    }
+
+    bool fits_record(const VaultEntry& entry) noexcept {
+        constexpr size_t limit = 0xFFFF;
+        return entry.name.size() <= limit && entry.original_path.size() <= limit && entry.encrypted_path.size() <= limit;
+    }
+
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE open_shared_file(const std::string& path) {
+        return CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    }
+
+    unsigned long long handle_length(void* handle) {
+        LARGE_INTEGER size;
+        return GetFileSizeEx(static_cast<HANDLE>(handle), &size) ? static_cast<unsigned long long>(size.QuadPart) : 0;
+    }
+#else
+    unsigned long long handle_length(int fd) {
+        struct stat st;
+        return (fstat(fd, &st) == 0) ? static_cast<unsigned long long>(st.st_size) : 0;
+    }
+#endif
+
+} // End anonymous namespace
+
+// --- Locking ---
+
+// Holds the in-process mutex and the cross-process file lock for one index operation
+class VaultIndex::Lock {
+public:
+    Lock(VaultIndex& index, bool exclusive) : guard(index.mutex), index(index) {
+    #if defined(_WIN32) || defined(_WIN64)
+        OVERLAPPED overlapped{};
+        locked = LockFileEx(static_cast<HANDLE>(index.lock_handle), exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0,
+                            0, 1, 0, &overlapped) != 0;
+    #else
+        while (!(locked = (flock(index.lock_handle, exclusive ? LOCK_EX : LOCK_SH) == 0)) && errno == EINTR) {}
+    #endif
+    }
+
+    ~Lock() {
+        if (!locked) return;
+    #if defined(_WIN32) || defined(_WIN64)
+        OVERLAPPED overlapped{};
+        UnlockFileEx(static_cast<HANDLE>(index.lock_handle), 0, 1, 0, &overlapped);
+    #else
+        flock(index.lock_handle, LOCK_UN);
+    #endif
+    }
+
+    bool held() const noexcept { return locked; }
+
+    Lock(const Lock&) = delete;
+    Lock& operator=(const Lock&) = delete;
+
+private:
+    std::lock_guard<std::mutex> guard;
+    VaultIndex& index;
+    bool locked = false;
+};
+
+// --- VaultIndex ---
+
+VaultIndex::~VaultIndex() noexcept {
+    close();
+}
+
+void VaultIndex::close() noexcept {
+    opened = false;
+    unmap();
+#if defined(_WIN32) || defined(_WIN64)
+    if (file_handle) CloseHandle(static_cast<HANDLE>(file_handle));
+    if (lock_handle) CloseHandle(static_cast<HANDLE>(lock_handle));
+    file_handle = lock_handle = nullptr;
+#else
+    if (file_handle >= 0) ::close(file_handle);
+    if (lock_handle >= 0) ::close(lock_handle);
+    file_handle = lock_handle = -1;
+#endif
+}
+
+bool VaultIndex::open(const std::string& vault_dir, int dir_handle, bool& out_created) {
+    out_created = false;
+    close();
+    directory = vault_dir;
+    directory_handle = dir_handle;
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE lock_file = open_shared_file(path_join(directory, VAULT_LOCK_FILE));
+    if (lock_file == INVALID_HANDLE_VALUE) return false;
+    lock_handle = lock_file;
+#else
+    lock_handle = openat(directory_handle, VAULT_LOCK_FILE.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lock_handle < 0) return false;
+#endif
+    Lock lock(*this, true);
+    if (!lock.held() || !open_index_file(out_created)) {
+        close();
+        return false;
+    }
+    opened = true;
+    return true;
+}
+
+// Opens VAULT_INDEX_FILE and maps it, starting it afresh if it is missing or invalid and
+// converting it if it is in an earlier format. Must be called with the exclusive lock held.
+bool VaultIndex::open_index_file(bool& out_created) {
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE file = open_shared_file(path_join(directory, VAULT_INDEX_FILE));
+    if (file == INVALID_HANDLE_VALUE) return false;
+    file_handle = file;
+#else
+    file_handle = openat(directory_handle, VAULT_INDEX_FILE.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (file_handle < 0) return false;
+#endif
+    const unsigned long long length = handle_length(file_handle);
+    if (length >= sizeof(VaultIndexHeader) && map(length)) {
+        VaultIndexHeader* header = header_view();
+        const unsigned long long buckets_count = header->bucket_count;
+        const bool valid = std::memcmp(header->magic, VAULT_INDEX_MAGIC, sizeof(header->magic)) == 0 &&
+                           buckets_count >= 1 && (buckets_count & (buckets_count - 1)) == 0 &&
+                           header->used_bytes >= table_end(buckets_count) && header->used_bytes <= length;
+        if (valid) {
+            if (header->replaced) header->replaced = 0; // Only set here if a rewrite failed to rename its file
+            return true;
+        }
+        // An index of another version holds metadata a rebuild cannot recover, so it is converted
+        // or left alone, never started afresh
+        if (std::memcmp(header->magic, VAULT_INDEX_MAGIC, sizeof(header->magic) - 2) == 0) {
+            const char version = header->magic[sizeof(header->magic) - 2];
+            const bool convertible = (version == '1' || version == '2') && buckets_count >= 1 &&
+                                     (buckets_count & (buckets_count - 1)) == 0 &&
+                                     header->used_bytes >= table_end(buckets_count) && header->used_bytes <= length;
+            if (convertible && upgrade(version)) return true;
+            std::cerr << "Error (Vault): The vault index '" << VAULT_INDEX_FILE << "' (format " << version
+                      << ") could not be converted and was left unchanged.\n";
+            return false;
+        }
+        unmap();
+    }
+
+    // Start an empty index: header plus bucket table, with room to grow
+    const unsigned long long initial_length = align8(table_end(INITIAL_BUCKETS)) + GROWTH_STEP;
+#if !defined(_WIN32) && !defined(_WIN64)
+    if (ftruncate(file_handle, 0) != 0 || ftruncate(file_handle, static_cast<off_t>(initial_length)) != 0) return false;
+#endif
+    if (!map(initial_length)) return false;
+    std::memset(data, 0, static_cast<size_t>(table_end(INITIAL_BUCKETS)));
+    VaultIndexHeader* header = header_view();
+    header->bucket_count = INITIAL_BUCKETS;
+    header->used_bytes = align8(table_end(INITIAL_BUCKETS));
+    std::memcpy(header->magic, VAULT_INDEX_MAGIC, sizeof(header->magic)); // Last, so a torn start stays invalid
+    out_created = true;
+    return true;
+}
+
+bool VaultIndex::map(unsigned long long length) {
+    unmap();
+#if defined(_WIN32) || defined(_WIN64)
+    // A mapping larger than the file extends the file
+    HANDLE mapping = CreateFileMappingA(static_cast<HANDLE>(file_handle), nullptr, PAGE_READWRITE,
+                                       static_cast<DWORD>(length >> 32), static_cast<DWORD>(length), nullptr);
+    if (!mapping) return false;
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<SIZE_T>(length));
+    if (!view) {
+        CloseHandle(mapping);
+        return false;
+    }
+    mapping_handle = mapping;
+    data = view;
+#else
+    void* view = mmap(nullptr, static_cast<size_t>(length), PROT_READ | PROT_WRITE, MAP_SHARED, file_handle, 0);
+    if (view == MAP_FAILED) return false;
+    data = view;
+#endif
+    mapped_length = length;
+    return true;
+}
+
+void VaultIndex::unmap() noexcept {
+    if (!data) return;
+#if defined(_WIN32) || defined(_WIN64)
+    UnmapViewOfFile(data);
+    CloseHandle(static_cast<HANDLE>(mapping_handle));
+    mapping_handle = nullptr;
+#else
+    munmap(data, static_cast<size_t>(mapped_length));
+#endif
+    data = nullptr;
+    mapped_length = 0;
+}
+
+// Picks up changes made by other processes since this one last held the lock
+bool VaultIndex::refresh() {
+    if (!data) return false;
+    if (header_view()->replaced) {
+        // Another process rewrote the index; the new file is at the path now
+        unmap();
+    #if defined(_WIN32) || defined(_WIN64)
+        CloseHandle(static_cast<HANDLE>(file_handle));
+        file_handle = nullptr;
+    #else
+        ::close(file_handle);
+        file_handle = -1;
+    #endif
+        bool created = false;
+        if (!open_index_file(created)) return false;
+    }
+    if (header_view()->used_bytes > mapped_length) {
+        return map(handle_length(file_handle));
+    }
+    return true;
+}
+
+// Makes sure 'extra_bytes' past used_bytes are mapped, growing the file if needed
+bool VaultIndex::reserve(unsigned long long extra_bytes) {
+    const unsigned long long needed = header_view()->used_bytes + extra_bytes;
+    if (needed <= mapped_length) return true;
+    unsigned long long length = handle_length(file_handle);
+    if (length < needed) {
+        length = std::max(needed, std::max(length * 2, length + GROWTH_STEP));
+    #if !defined(_WIN32) && !defined(_WIN64)
+        if (ftruncate(file_handle, static_cast<off_t>(length)) != 0) return false;
+    #endif
+    }
+    return map(length);
+}
+
+// Finds the live entry-name record (or, with 'object', the object record) keyed 'key'.
+// 'out_link' receives the slot that points to it, for unlinking.
+unsigned long long VaultIndex::find_offset(const std::string& key, bool object, unsigned long long** out_link) {
+    const VaultIndexHeader* header = header_view();
+    const unsigned long long hash = name_hash(key);
+    const unsigned int kind = object ? VAULT_RECORD_OBJECT : 0;
+    const unsigned long long first_record = table_end(header->bucket_count);
+    unsigned long long* link = &buckets()[hash & (header->bucket_count - 1)];
+    // The step bound stops a damaged chain from looping forever
+    for (unsigned long long steps = header->used_bytes / sizeof(VaultIndexRecord); steps > 0; --steps) {
+        const unsigned long long offset = __atomic_load_n(link, __ATOMIC_ACQUIRE);
+        if (offset < first_record || offset + sizeof(VaultIndexRecord) > header->used_bytes) return 0;
+        VaultIndexRecord* record = record_at(offset);
+        if (record->name_hash == hash && record->name_length == key.size() &&
+            (record->flags & (VAULT_RECORD_DEAD | VAULT_RECORD_OBJECT)) == kind &&
+            std::memcmp(record_text(record), key.data(), key.size()) == 0) {
+            if (out_link) *out_link = link;
+            return offset;
+        }
+        link = &record->next;
+    }
+    return 0;
+}
+
+// Makes room for 'record_count' more records: keeps chains short and the heap mostly live.
+// Done before any insert of an operation, since a rewrite moves every record.
+bool VaultIndex::prepare_insert(unsigned long long record_count) {
+    const VaultIndexHeader* header = header_view();
+    if ((header->live_count + record_count) * 4 > header->bucket_count * 3) {
+        rewrite(header->bucket_count * 2);
+    } else if (header->dead_bytes > GROWTH_STEP && header->dead_bytes * 2 > header->used_bytes) {
+        rewrite(header->bucket_count);
+    }
+    return data != nullptr; // A failed rewrite only costs lookup speed
+}
+
+// Appends a record for 'entry' and publishes it, replacing a live record with the same key
+bool VaultIndex::insert_record(const VaultEntry& entry, unsigned int flags, unsigned long long refcount) {
+    const unsigned long long length = align8(sizeof(VaultIndexRecord) + entry.name.size() +
+                                             entry.original_path.size() + entry.encrypted_path.size());
+    if (!reserve(length)) return false;
+
+    VaultIndexHeader* header = header_view();
+    const unsigned long long hash = name_hash(entry.name);
+    unsigned long long* old_link = nullptr;
+    const unsigned long long old_offset = find_offset(entry.name, (flags & VAULT_RECORD_OBJECT) != 0, &old_link);
+
+    // Write the record, extend the used area, then publish it at the head of its chain
+    const unsigned long long offset = header->used_bytes;
+    encode_record(entry, hash, static_cast<unsigned char*>(data) + offset);
+    VaultIndexRecord* record = record_at(offset);
+    record->flags |= flags;
+    record->refcount = refcount;
+    unsigned long long* head = &buckets()[hash & (header->bucket_count - 1)];
+    record->next = *head;
+    publish(&header->used_bytes, offset + length);
+    publish(head, offset);
+
+    header->live_count++;
+    if (flags & VAULT_RECORD_OBJECT) header->object_count++;
+    if (old_offset != 0) {
+        // The replaced record now sits behind the new one
+        unlink_record(old_offset, (old_link == head) ? &record->next : old_link);
+    }
+    return true;
+}
+
+void VaultIndex::unlink_record(unsigned long long offset, unsigned long long* link) {
+    VaultIndexRecord* record = record_at(offset);
+    publish(link, record->next);
+    record->flags |= VAULT_RECORD_DEAD;
+    VaultIndexHeader* header = header_view();
+    header->live_count--;
+    if (record->flags & VAULT_RECORD_OBJECT) header->object_count--;
+    header->dead_bytes += record_length(*record);
+}
+
+void VaultIndex::drop_reference(const Sha256Digest& digest, const ReleaseObject& release_object) {
+    unsigned long long* link = nullptr;
+    const unsigned long long offset = find_offset(digest.to_hex(), true, &link);
+    if (offset == 0) return;
+    VaultIndexRecord* object = record_at(offset);
+    if (object->refcount > 1) {
+        object->refcount--;
+        return;
+    }
+    unlink_record(offset, link);
+    if (release_object) release_object(digest);
+}
+
+bool VaultIndex::put(const VaultEntry& entry) {
+    if (!is_open() || entry.name.empty() || !fits_record(entry)) return false;
+    Lock lock(*this, true);
+    if (!lock.held() || !refresh() || !prepare_insert(1)) return false;
+    const unsigned int flags = entry.content_addressed ? VAULT_RECORD_CONTENT : 0;
+    return insert_record(entry, flags, 0);
+}
+
+bool VaultIndex::put_new(const VaultEntry& entry, const std::function<bool(VaultEntry& placed)>& place_data,
+                         bool& out_name_taken) {
+    out_name_taken = false;
+    if (!is_open() || entry.name.empty() || !fits_record(entry)) return false;
+    Lock lock(*this, true);
+    if (!lock.held() || !refresh() || !prepare_insert(1)) return false;
+    if (find_offset(entry.name, false, nullptr) != 0) {
+        out_name_taken = true;
+        return false;
+    }
+    VaultEntry placed = entry;
+    if (!place_data(placed)) return false;
+    const unsigned int flags = placed.content_addressed ? VAULT_RECORD_CONTENT : 0;
+    return insert_record(placed, flags, 0);
+}
+
+bool VaultIndex::bind_content(const VaultEntry& entry, const std::function<bool(bool object_indexed)>& place_object,
+                              const ReleaseObject& release_object) {
+    if (!is_open() || entry.name.empty() || !entry.has_digest || !fits_record(entry)) return false;
+    Lock lock(*this, true);
+    if (!lock.held() || !refresh() || !prepare_insert(2)) return false;
+
+    const std::string object_key = entry.digest.to_hex();
+    const bool object_indexed = find_offset(object_key, true, nullptr) != 0;
+    if (!place_object(object_indexed)) return false;
+
+    // The name's previous binding, if it was to a different object, is released afterwards
+    VaultEntry previous;
+    const unsigned long long previous_offset = find_offset(entry.name, false, nullptr);
+    if (previous_offset != 0) previous = decode_record(record_at(previous_offset));
+    const bool previous_is_other_object = previous_offset != 0 && previous.content_addressed && previous.digest != entry.digest;
+    const bool already_referenced = previous_offset != 0 && previous.content_addressed && previous.digest == entry.digest;
+
+    if (!object_indexed) {
+        VaultEntry object;
+        object.name = object_key;
+        object.size = entry.size;
+        object.stored_ms = entry.stored_ms;
+        object.has_digest = true;
+        object.digest = entry.digest;
+        if (!insert_record(object, VAULT_RECORD_OBJECT, 1)) return false;
+    } else if (!already_referenced) {
+        record_at(find_offset(object_key, true, nullptr))->refcount++;
+    }
+    if (!insert_record(entry, VAULT_RECORD_CONTENT, 0)) return false;
+    if (previous_is_other_object) drop_reference(previous.digest, release_object);
+    return true;
+}
+
+bool VaultIndex::remove(const std::string& name, const ReleaseObject& release_object) {
+    if (!is_open()) return false;
+    Lock lock(*this, true);
+    if (!lock.held() || !refresh()) return false;
+    unsigned long long* link = nullptr;
+    const unsigned long long offset = find_offset(name, false, &link);
+    if (offset == 0) return false;
+    const VaultEntry entry = decode_record(record_at(offset));
+    unlink_record(offset, link);
+    if (entry.content_addressed) drop_reference(entry.digest, release_object);
+    return true;
+}
+
+bool VaultIndex::take(const std::string& name, const std::function<bool(const VaultEntry& entry, bool sole_owner)>& take_data) {
+    if (!is_open()) return false;
+    Lock lock(*this, true);
+    if (!lock.held() || !refresh()) return false;
+    unsigned long long* link = nullptr;
+    const unsigned long long offset = find_offset(name, false, &link);
+    if (offset == 0) return false;
+    const VaultEntry entry = decode_record(record_at(offset));
+    bool sole_owner = true;
+    if (entry.content_addressed) {
+        const unsigned long long object = find_offset(entry.digest.to_hex(), true, nullptr);
+        sole_owner = (object == 0) || record_at(object)->refcount <= 1;
+    }
+    if (!take_data(entry, sole_owner)) return false;
+    unlink_record(offset, link);
+    if (entry.content_addressed) drop_reference(entry.digest, nullptr);
+    return true;
+}
+
+bool VaultIndex::find(const std::string& name, VaultEntry& out_entry) {
+    if (!is_open()) return false;
+    Lock lock(*this, false);
+    if (!lock.held() || !refresh()) return false;
+    const unsigned long long offset = find_offset(name, false, nullptr);
+    if (offset == 0) return false;
+    out_entry = decode_record(record_at(offset));
+    return true;
+}
+
+bool VaultIndex::repack(unsigned int pack_id, const std::function<bool(std::vector<VaultEntry>& entries)>& move_entries) {
+    if (!is_open() || pack_id == 0) return false;
+    Lock lock(*this, true);
+    if (!lock.held() || !refresh()) return false;
+    const VaultIndexHeader* header = header_view();
+    std::vector<unsigned long long> offsets;
+    std::vector<VaultEntry> entries;
+    unsigned long long offset = align8(table_end(header->bucket_count));
+    while (offset + sizeof(VaultIndexRecord) <= header->used_bytes) {
+        const VaultIndexRecord* record = record_at(offset);
+        const unsigned long long length = record_length(*record);
+        if (offset + length > header->used_bytes) break;
+        if (!(record->flags & (VAULT_RECORD_DEAD | VAULT_RECORD_OBJECT)) && record->pack_id == pack_id) {
+            offsets.push_back(offset);
+            entries.push_back(decode_record(record));
+        }
+        offset += length;
+    }
+    if (!move_entries(entries) || entries.size() != offsets.size()) return false;
+    // Readers hold the shared lock, so the two fields never change under one of them
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        VaultIndexRecord* record = record_at(offsets[i]);
+        record->pack_id = entries[i].pack_id;
+        record->pack_offset = entries[i].pack_offset;
+    }
+    return true;
+}
+
+unsigned long long VaultIndex::object_references(const Sha256Digest& digest) {
+    if (!is_open()) return 0;
+    Lock lock(*this, false);
+    if (!lock.held() || !refresh()) return 0;
+    const unsigned long long offset = find_offset(digest.to_hex(), true, nullptr);
+    return (offset != 0) ? record_at(offset)->refcount : 0;
+}
+
+bool VaultIndex::mark_retrieved(const std::string& name, long long retrieved_ms) {
+    if (!is_open()) return false;
+    Lock lock(*this, true);
+    if (!lock.held() || !refresh()) return false;
+    const unsigned long long offset = find_offset(name, false, nullptr);
+    if (offset == 0) return false;
+    record_at(offset)->retrieved_ms = retrieved_ms;
+    return true;
+}
+
+std::vector<VaultEntry> VaultIndex::list() {
+    std::vector<VaultEntry> entries;
+    if (!is_open()) return entries;
+    Lock lock(*this, false);
+    if (!lock.held() || !refresh()) return entries;
+    const VaultIndexHeader* header = header_view();
+    entries.reserve(static_cast<size_t>(header->live_count - header->object_count));
+    unsigned long long offset = align8(table_end(header->bucket_count));
+    while (offset + sizeof(VaultIndexRecord) <= header->used_bytes) {
+        const VaultIndexRecord* record = record_at(offset);
+        const unsigned long long length = record_length(*record);
+        if (offset + length > header->used_bytes) break;
+        if (!(record->flags & (VAULT_RECORD_DEAD | VAULT_RECORD_OBJECT))) entries.push_back(decode_record(record));
+        offset += length;
+    }
+    return entries;
+}
+
+size_t VaultIndex::entry_count() {
+    if (!is_open()) return 0;
+    Lock lock(*this, false);
+    if (!lock.held() || !refresh()) return 0;
+    return static_cast<size_t>(header_view()->live_count - header_view()->object_count);
+}
+
+unsigned long long VaultIndex::options() {
+    if (!is_open()) return 0;
+    Lock lock(*this, false);
+    if (!lock.held() || !refresh()) return 0;
+    return header_view()->options;
+}
+
+bool VaultIndex::set_options(unsigned long long new_options) {
+    if (!is_open()) return false;
+    Lock lock(*this, true);
+    if (!lock.held() || !refresh()) return false;
+    header_view()->options = new_options;
+    return true;
+}
+
+// Writes the live records into a new file with 'bucket_count' buckets and renames it over the
+// index. Must be called with the exclusive lock held. On failure the current file stays in use.
+bool VaultIndex::rewrite(unsigned long long bucket_count) {
+    const VaultIndexHeader* header = header_view();
+    const unsigned long long first_record = align8(table_end(bucket_count));
+    std::vector<unsigned char> image(static_cast<size_t>(first_record));
+    auto* new_buckets = reinterpret_cast<unsigned long long*>(image.data() + sizeof(VaultIndexHeader));
+    unsigned long long live = 0;
+    unsigned long long objects = 0;
+    unsigned long long offset = align8(table_end(header->bucket_count));
+    while (offset + sizeof(VaultIndexRecord) <= header->used_bytes) {
+        const VaultIndexRecord* record = record_at(offset);
+        const unsigned long long length = record_length(*record);
+        if (offset + length > header->used_bytes) break;
+        if (!(record->flags & VAULT_RECORD_DEAD)) {
+            const size_t new_offset = image.size();
+            image.insert(image.end(), reinterpret_cast<const unsigned char*>(record),
+                         reinterpret_cast<const unsigned char*>(record) + length);
+            // Re-resolve after the insert; it may have reallocated
+            new_buckets = reinterpret_cast<unsigned long long*>(image.data() + sizeof(VaultIndexHeader));
+            unsigned long long& head = new_buckets[record->name_hash & (bucket_count - 1)];
+            reinterpret_cast<VaultIndexRecord*>(image.data() + new_offset)->next = head;
+            head = new_offset;
+            live++;
+            if (record->flags & VAULT_RECORD_OBJECT) objects++;
+        }
+        offset += length;
+    }
+    VaultIndexHeader new_header{};
+    std::memcpy(new_header.magic, VAULT_INDEX_MAGIC, sizeof(new_header.magic));
+    new_header.used_bytes = image.size();
+    new_header.bucket_count = bucket_count;
+    new_header.live_count = live;
+    new_header.object_count = objects;
+    new_header.options = header->options;
+    std::memcpy(image.data(), &new_header, sizeof(new_header));
+    image.resize(image.size() + GROWTH_STEP); // Room to grow, like a fresh index
+
+    const bool ok = replace_file(image, false);
+    // Either the new file or (after a failure) the old one, whose 'replaced' flag is cleared on open
+    bool created = false;
+    return open_index_file(created) && ok;
+}
+
+// Converts the mapped index, written in format 'version' (the digit in its magic), to the
+// current format with every record's metadata intact. The old file is kept as
+// VAULT_INDEX_BACKUP_FILE. Must be called with the exclusive lock held.
+bool VaultIndex::upgrade(char version) {
+    const VaultIndexHeader* header = header_view();
+    const unsigned long long bucket_count = header->bucket_count;
+    std::vector<unsigned char> image(static_cast<size_t>(align8(table_end(bucket_count))));
+    unsigned long long live = 0;
+    unsigned long long objects = 0;
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    if (version == '1') {
+        convert_records<VaultIndexRecordV1>(bytes, *header, bucket_count, image, live, objects);
+    } else {
+        convert_records<VaultIndexRecordV2>(bytes, *header, bucket_count, image, live, objects);
+    }
+    VaultIndexHeader new_header{};
+    std::memcpy(new_header.magic, VAULT_INDEX_MAGIC, sizeof(new_header.magic));
+    new_header.used_bytes = image.size();
+    new_header.bucket_count = bucket_count;
+    new_header.live_count = live;
+    new_header.object_count = objects;
+    new_header.options = (version == '1') ? 0 : header->options; // Reserved (zero) in CGVIDX1
+    std::memcpy(image.data(), &new_header, sizeof(new_header));
+    image.resize(image.size() + GROWTH_STEP);
+
+    if (!replace_file(image, true)) return false;
+    bool created = false;
+    if (!open_index_file(created)) return false;
+    std::cout << "Info: Vault index converted to the current format (" << live << " record(s)); the old one was kept as '"
+              << VAULT_INDEX_BACKUP_FILE << "'.\n";
+    return true;
+}
+
+// Writes 'image' to a temporary file and renames it over VAULT_INDEX_FILE, optionally keeping the
+// old file as VAULT_INDEX_BACKUP_FILE. Leaves the index unmapped and closed either way.
+bool VaultIndex::replace_file(const std::vector<unsigned char>& image, bool keep_backup) {
+    // Other processes reopen once they see 'replaced'; it is cleared again if the rename fails
+    header_view()->replaced = 1;
+    unmap();
+#if defined(_WIN32) || defined(_WIN64)
+    const std::string temp_path = path_join(directory, VAULT_INDEX_TEMP_FILE);
+    const std::string index_path = path_join(directory, VAULT_INDEX_FILE);
+    HANDLE temp = CreateFileA(temp_path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    DWORD written = 0;
+    bool ok = temp != INVALID_HANDLE_VALUE &&
+              WriteFile(temp, image.data(), static_cast<DWORD>(image.size()), &written, nullptr) &&
+              written == image.size() && FlushFileBuffers(temp);
+    if (temp != INVALID_HANDLE_VALUE) CloseHandle(temp);
+    ok = ok && (!keep_backup || CopyFileA(index_path.c_str(), path_join(directory, VAULT_INDEX_BACKUP_FILE).c_str(), FALSE));
+    // Windows cannot replace a file that is still open, so the old handle goes first
+    CloseHandle(static_cast<HANDLE>(file_handle));
+    file_handle = nullptr;
+    ok = ok && MoveFileExA(temp_path.c_str(), index_path.c_str(), MOVEFILE_REPLACE_EXISTING);
+    if (!ok) DeleteFileA(temp_path.c_str());
+#else
+    const int temp = openat(directory_handle, VAULT_INDEX_TEMP_FILE.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    bool ok = temp >= 0 && write_all(temp, image.data(), image.size()) && fsync(temp) == 0;
+    if (temp >= 0) ::close(temp);
+    if (ok && keep_backup) {
+        // A second name for the old file, which the rename below then leaves as the only one
+        unlinkat(directory_handle, VAULT_INDEX_BACKUP_FILE.c_str(), 0);
+        ok = linkat(directory_handle, VAULT_INDEX_FILE.c_str(), directory_handle, VAULT_INDEX_BACKUP_FILE.c_str(), 0) == 0;
+    }
+    ok = ok && renameat(directory_handle, VAULT_INDEX_TEMP_FILE.c_str(), directory_handle, VAULT_INDEX_FILE.c_str()) == 0;
+    if (!ok) unlinkat(directory_handle, VAULT_INDEX_TEMP_FILE.c_str(), 0);
+    ::close(file_handle);
+    file_handle = -1;
+#endif
+    return ok;
+}
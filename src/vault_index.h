@@ -0,0 +1,194 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstddef> // For size_t
+
+#include "hash_service.h" // For Sha256Digest
+
+// --- Files ---
+// Both live inside PRIVATE_VAULT_DIR and are never reported as vault entries
+extern const std::string VAULT_INDEX_FILE; // .vault_index
+extern const std::string VAULT_LOCK_FILE;  // .vault_lock (flock/LockFileEx target; never replaced)
+extern const std::string VAULT_INDEX_BACKUP_FILE; // .vault_index.old (an index from before a format upgrade)
+
+// --- Structures ---
+
+// Metadata kept for one vault entry
+struct VaultEntry {
+    std::string name;               // Entry name inside the vault
+    unsigned long long size = 0;
+    long long modified_ms = 0;      // Modification time of the original when it was stored
+    long long stored_ms = 0;
+    long long retrieved_ms = 0;     // Last retrieval; 0 if never retrieved
+    int pegs = 0;                   // 0 when unknown
+    bool has_digest = false;
+    Sha256Digest digest;            // SHA-256 of the original's content
+    std::string original_path;      // Where the original was before it was stored
+    std::string encrypted_path;     // Its enc_ counterpart; empty when unknown
+    bool content_addressed = false; // Content lives in the object store under 'digest'
+    unsigned int pack_id = 0;       // Packfile holding the content; 0 when it is a file of its own
+    unsigned long long pack_offset = 0; // Offset of the entry's record in that packfile
+};
+
+// On-disk layout: a header, a power-of-two table of bucket heads, then an append-only heap of
+// variable-length records. Each bucket is a chain (newest first) of record offsets; replaced
+// or removed records are unlinked and counted as dead until the next rewrite. All offsets are
+// absolute file offsets; 0 ends a chain.
+//
+// Besides one record per entry name, content-addressed storage adds one object record per
+// distinct digest (keyed by its hex form, VAULT_RECORD_OBJECT set) holding a reference count.
+struct VaultIndexHeader {
+    char magic[8];
+    unsigned long long used_bytes;   // End of the last record
+    unsigned long long bucket_count;
+    unsigned long long live_count;
+    unsigned long long dead_bytes;   // Unlinked records, reclaimed by the next rewrite
+    unsigned long long replaced;     // Set (under the lock) when a rewrite renamed a new file over this one
+    unsigned long long object_count; // Live object records (included in live_count)
+    unsigned long long options;      // VAULT_OPTION_* bits shared by every process using the vault
+};
+
+struct VaultIndexRecord {
+    unsigned long long next;
+    unsigned long long name_hash;
+    unsigned long long size;
+    long long modified_ms;
+    long long stored_ms;
+    long long retrieved_ms;
+    unsigned long long refcount;     // Object records: entry names bound to the object
+    unsigned long long pack_offset;
+    int pegs;
+    unsigned int flags;              // VAULT_RECORD_* bits
+    unsigned int pack_id;
+    unsigned int pack_reserved;
+    unsigned char digest[32];
+    unsigned short name_length;
+    unsigned short original_length;
+    unsigned short encrypted_length;
+    unsigned short reserved;
+    // Followed by the name, original path and encrypted path bytes, padded to 8 bytes
+};
+
+inline constexpr char VAULT_INDEX_MAGIC[8] = {'C', 'G', 'V', 'I', 'D', 'X', '3', '\0'};
+inline constexpr unsigned int VAULT_RECORD_HAS_DIGEST = 1;
+inline constexpr unsigned int VAULT_RECORD_DEAD = 2;
+inline constexpr unsigned int VAULT_RECORD_OBJECT = 4;  // Object record, not an entry name
+inline constexpr unsigned int VAULT_RECORD_CONTENT = 8; // Entry stored content-addressed
+inline constexpr unsigned long long VAULT_OPTION_CONTENT_ADDRESSED = 1; // New entries go to the object store
+inline constexpr unsigned long long VAULT_OPTION_SHARDED = 2;            // Flat-layout files have all been migrated
+
+// --- Index ---
+
+// Memory-mapped index of the vault, keyed by entry name. Lookups hash the name and walk one
+// short chain; listing walks the record heap, so neither touches the vault directory. The
+// file is shared between processes: readers take a shared lock on VAULT_LOCK_FILE, writers an
+// exclusive one, and every operation first picks up growth or a rewrite by another process.
+// A single record is published by one 8-byte store of its offset into its bucket, after the
+// record itself has been written, so an interrupted update never exposes a partial record.
+class VaultIndex {
+public:
+    VaultIndex() noexcept = default;
+    ~VaultIndex() noexcept;
+
+    // Opens or creates the index in 'vault_dir'. On POSIX the files are opened relative to
+    // 'dir_handle' (an open descriptor of 'vault_dir'). 'out_created' is true if the index was
+    // missing or unreadable and had to be started empty. An index in an earlier format is
+    // converted in place (the old file is kept as VAULT_INDEX_BACKUP_FILE); one that cannot be
+    // converted is left untouched and the open fails.
+    bool open(const std::string& vault_dir, int dir_handle, bool& out_created);
+    void close() noexcept;
+    bool is_open() const noexcept { return opened; }
+
+    // Called (with the exclusive lock held) for an object whose last reference went away
+    using ReleaseObject = std::function<void(const Sha256Digest& digest)>;
+
+    // Inserts 'entry', replacing any entry with the same name
+    bool put(const VaultEntry& entry);
+
+    // Inserts 'entry' only if its name is free, after 'place_data' has stored the data (and
+    // recorded where in the entry it is given), all under the exclusive lock. 'out_name_taken'
+    // is set when the name was already indexed; 'place_data' may set it too.
+    bool put_new(const VaultEntry& entry, const std::function<bool(VaultEntry& placed)>& place_data, bool& out_name_taken);
+
+    // Binds 'entry.name' to the object 'entry.digest' and takes a reference on it, all under the
+    // exclusive lock. 'place_object' runs first, told whether the object is already indexed, and
+    // must make the object's data exist (returning false aborts without changes). A previous
+    // binding of the name to another object drops that reference.
+    bool bind_content(const VaultEntry& entry, const std::function<bool(bool object_indexed)>& place_object,
+                      const ReleaseObject& release_object);
+
+    // Removes an entry name, dropping its object reference if it was content-addressed
+    bool remove(const std::string& name, const ReleaseObject& release_object = nullptr);
+    // Removes an entry name after 'take_data' has dealt with its data, all under the exclusive
+    // lock. 'sole_owner' tells whether no other name shares the data (always true for entries
+    // stored by name); only then may 'take_data' move or delete it. Returning false keeps the
+    // entry. The object record of a content-addressed entry loses one reference either way.
+    bool take(const std::string& name, const std::function<bool(const VaultEntry& entry, bool sole_owner)>& take_data);
+    bool find(const std::string& name, VaultEntry& out_entry);
+    // Hands every live entry whose data is in pack 'pack_id' to 'move_entries' under the exclusive
+    // lock. It copies their data elsewhere and updates pack_id/pack_offset in the entries; on
+    // success the index points them at the new location before the lock is released.
+    bool repack(unsigned int pack_id, const std::function<bool(std::vector<VaultEntry>& entries)>& move_entries);
+    // Entry names currently bound to the object (0 if it is not indexed)
+    unsigned long long object_references(const Sha256Digest& digest);
+    // Sets the retrieval time in place. Returns false if 'name' is not indexed.
+    bool mark_retrieved(const std::string& name, long long retrieved_ms);
+    // Every live entry, in insertion order
+    std::vector<VaultEntry> list();
+    size_t entry_count();
+
+    unsigned long long options();
+    bool set_options(unsigned long long new_options);
+
+    // Disable copy and move operations to ensure single ownership of the mapping
+    VaultIndex(const VaultIndex&) = delete;
+    VaultIndex& operator=(const VaultIndex&) = delete;
+    VaultIndex(VaultIndex&&) = delete;
+    VaultIndex& operator=(VaultIndex&&) = delete;
+
+private:
+    class Lock;
+
+    bool open_index_file(bool& out_created);
+    bool map(unsigned long long length);
+    void unmap() noexcept;
+    bool refresh();
+    bool reserve(unsigned long long extra_bytes);
+    bool rewrite(unsigned long long bucket_count);
+    bool upgrade(char version);
+    bool replace_file(const std::vector<unsigned char>& image, bool keep_backup);
+    bool prepare_insert(unsigned long long record_count);
+    bool insert_record(const VaultEntry& entry, unsigned int flags, unsigned long long refcount);
+    void unlink_record(unsigned long long offset, unsigned long long* link);
+    void drop_reference(const Sha256Digest& digest, const ReleaseObject& release_object);
+    unsigned long long find_offset(const std::string& key, bool object, unsigned long long** out_link);
+
+    VaultIndexHeader* header_view() const noexcept { return static_cast<VaultIndexHeader*>(data); }
+    unsigned long long* buckets() const noexcept {
+        return reinterpret_cast<unsigned long long*>(static_cast<unsigned char*>(data) + sizeof(VaultIndexHeader));
+    }
+    VaultIndexRecord* record_at(unsigned long long offset) const noexcept {
+        return reinterpret_cast<VaultIndexRecord*>(static_cast<unsigned char*>(data) + offset);
+    }
+
+    std::mutex mutex; // Serializes this process's threads; the file lock only separates processes
+    std::string directory;
+    int directory_handle = -1;
+    bool opened = false;
+    void* data = nullptr;
+    unsigned long long mapped_length = 0;
+#if defined(_WIN32) || defined(_WIN64)
+    void* file_handle = nullptr;    // HANDLE of VAULT_INDEX_FILE
+    void* mapping_handle = nullptr; // HANDLE of its file mapping
+    void* lock_handle = nullptr;    // HANDLE of VAULT_LOCK_FILE
+#else
+    int file_handle = -1;
+    int lock_handle = -1;
+#endif
+
+    inline static constexpr unsigned long long INITIAL_BUCKETS = 1024;
+    inline static constexpr unsigned long long GROWTH_STEP = 1024 * 1024; // Minimum file growth
+};
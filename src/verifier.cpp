@@ -0,0 +1,637 @@
+#include "verifier.h"
+#include "cipher_utils.h"  // For BUFFER_SIZE, log_event
+#include "byte_kernels.h"
+#include "file_view.h"
+#include "op_metrics.h"
+#include "vault.h"
+
+#include <fstream>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <sstream>
+#include <cmath> // For std::log
+#include <thread>
+#include <unordered_map>
+
+// --- Anonymous Namespace for INTERNAL (File-Local) Helper Functions ---
+namespace {
+
+    constexpr size_t VERIFY_BLOCK_SIZE = 256 * BUFFER_SIZE; // 1 MiB per file buffer
+
+    // Opens at the end so the size comes for free, then rewinds
+    bool open_sized(std::ifstream& stream, const std::string& path, unsigned long long& size_out) {
+        stream.open(path, std::ios::binary | std::ios::ate);
+        if (!stream) return false;
+        std::streamoff end = stream.tellg();
+        if (end < 0) return false;
+        size_out = static_cast<unsigned long long>(end);
+        stream.seekg(0, std::ios::beg);
+        return static_cast<bool>(stream);
+    }
+
+    // Adds a range to the report, joining it to the previous one when they are within 'merge_gap'
+    void add_range(DiffReport& report, unsigned long long offset, unsigned long long length,
+                   size_t max_ranges, size_t merge_gap) {
+        if (!report.ranges.empty()) {
+            MismatchRange& last = report.ranges.back();
+            const unsigned long long last_end = last.offset + last.length;
+            if (offset <= last_end + merge_gap) {
+                last.length = std::max(last_end, offset + length) - last.offset;
+                return;
+            }
+        }
+        if (report.ranges.size() < max_ranges) {
+            report.ranges.push_back({offset, length});
+        } else {
+            report.truncated = true;
+        }
+    }
+
+    std::vector<std::string_view> split_lines(std::string_view text) {
+        std::vector<std::string_view> lines;
+        size_t start = 0;
+        while (start < text.size()) {
+            size_t newline = text.find('\n', start);
+            if (newline == std::string_view::npos) {
+                lines.push_back(text.substr(start));
+                break;
+            }
+            lines.push_back(text.substr(start, newline - start));
+            start = newline + 1;
+        }
+        return lines;
+    }
+
+    // Moves 'begin' back to the start of its line and 'end' forward past its line terminator,
+    // looking at most 'limit' bytes in each direction. 'newline' is the (possibly encrypted) '\n'.
+    void expand_to_lines(std::string_view data, size_t& begin, size_t& end, unsigned char newline, size_t limit) {
+        const size_t floor = begin > limit ? begin - limit : 0;
+        while (begin > floor && static_cast<unsigned char>(data[begin - 1]) != newline) --begin;
+        const size_t ceiling = std::min(data.size(), end + limit);
+        while (end < ceiling && static_cast<unsigned char>(data[end - 1]) != newline) ++end;
+    }
+
+    constexpr size_t MAX_LINE_DIFF_REGION = 64 * 1024; // Bytes per side handed to the line diff
+    constexpr size_t PEG_SAMPLE_CHUNKS = 64;            // Evenly spaced reads when sampling
+
+    using ByteHistogram = std::array<unsigned long long, 256>;
+
+    // Histogram of a whole file, or of PEG_SAMPLE_CHUNKS evenly spaced chunks when it is larger
+    // than 'sample_bytes'. Byte order does not matter to a histogram, so sampling is unbiased for
+    // uniformly encrypted content.
+    bool build_file_histogram(const std::string& path, size_t sample_bytes, ByteHistogram& histogram,
+                              unsigned long long& bytes_examined, bool& sampled) {
+        std::ifstream stream;
+        unsigned long long size = 0;
+        if (!open_sized(stream, path, size)) return false;
+        histogram.fill(0);
+        bytes_examined = 0;
+        sampled = (sample_bytes > 0 && size > sample_bytes);
+
+        const size_t chunk_size = sampled ? std::max<size_t>(sample_bytes / PEG_SAMPLE_CHUNKS, 1) : VERIFY_BLOCK_SIZE;
+        std::vector<unsigned char> buffer(std::min<size_t>(chunk_size, VERIFY_BLOCK_SIZE));
+        const unsigned long long chunk_count = sampled ? PEG_SAMPLE_CHUNKS : (size + buffer.size() - 1) / buffer.size();
+        const unsigned long long stride = sampled ? size / PEG_SAMPLE_CHUNKS : buffer.size();
+
+        for (unsigned long long c = 0; c < chunk_count; ++c) {
+            const unsigned long long offset = c * stride;
+            if (offset >= size) break;
+            const size_t want = static_cast<size_t>(std::min<unsigned long long>(buffer.size(), size - offset));
+            if (sampled) stream.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+            stream.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(want));
+            const size_t got = static_cast<size_t>(stream.gcount());
+            accumulate_byte_histogram(buffer.data(), got, histogram.data());
+            bytes_examined += got;
+            if (got != want) return !stream.bad();
+        }
+        return true;
+    }
+
+    // Approximate byte distribution of English prose/text files, as log-probabilities
+    std::array<double, 256> text_log_distribution() {
+        std::array<double, 256> weight;
+        weight.fill(0.0005); // Floor so unusual bytes are unlikely but never impossible
+        const char* letters = "etaoinshrdlcumwfgypbvkjxqz";
+        const double letter_freq[] = {12.7, 9.1, 8.2, 7.5, 7.0, 6.7, 6.3, 6.1, 6.0, 4.3, 4.0, 2.8, 2.8,
+                                      2.4, 2.4, 2.2, 2.0, 2.0, 1.9, 1.5, 1.0, 0.8, 0.15, 0.15, 0.1, 0.07};
+        for (int i = 0; letters[i] != '\0'; ++i) {
+            const unsigned char lower = static_cast<unsigned char>(letters[i]);
+            weight[lower] += letter_freq[i];
+            weight[lower - 'a' + 'A'] += letter_freq[i] * 0.08;
+        }
+        weight[' '] += 18.0;
+        weight['\n'] += 2.0;
+        weight['\r'] += 0.5;
+        weight['\t'] += 0.3;
+        for (unsigned char c : std::string(".,;:'\"!?-()")) weight[c] += 0.6;
+        for (unsigned char c = '0'; c <= '9'; ++c) weight[c] += 0.4;
+        for (unsigned char c = 0x21; c < 0x7F; ++c) weight[c] += 0.02; // Remaining printable ASCII
+
+        double total = 0.0;
+        for (double w : weight) total += w;
+        std::array<double, 256> log_probability;
+        for (size_t b = 0; b < 256; ++b) log_probability[b] = std::log(weight[b] / total);
+        return log_probability;
+    }
+
+} // End anonymous namespace
+
+// --- Public Function Implementations ---
+
+// --- RateLimiter ---
+
+RateLimiter::RateLimiter(unsigned long long bytes_per_second) noexcept
+    : rate(static_cast<double>(bytes_per_second)),
+      available(static_cast<double>(bytes_per_second)),
+      last_refill(std::chrono::steady_clock::now())
+{}
+
+void RateLimiter::acquire(unsigned long long bytes) {
+    if (rate <= 0.0) return;
+    double deficit = 0.0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - last_refill).count();
+        last_refill = now;
+        // At most one second of burst is banked
+        available = std::min(rate, available + elapsed * rate);
+        available -= static_cast<double>(bytes);
+        deficit = -available;
+    }
+    if (deficit > 0.0) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(deficit / rate));
+    }
+}
+
+// --- Streaming Verification ---
+
+StreamVerifyResult verify_encrypted_file_stream(const std::string& plain_path, const std::string& cipher_path,
+                                                int pegs, VerifyProgress* progress, RateLimiter* limiter) {
+    const OperationTimer timer;
+    StreamVerifyResult result;
+
+    std::ifstream plain_stream;
+    std::ifstream cipher_stream;
+    if (!open_sized(plain_stream, plain_path, result.plain_size)) {
+        result.error_message = "Could not open vault file: " + plain_path;
+        return result;
+    }
+    if (!open_sized(cipher_stream, cipher_path, result.cipher_size)) {
+        result.error_message = "Could not open encrypted file: " + cipher_path;
+        return result;
+    }
+    result.files_readable = true;
+
+    const unsigned long long common_size = std::min(result.plain_size, result.cipher_size);
+    const unsigned long long max_size = std::max(result.plain_size, result.cipher_size);
+    if (progress) {
+        progress->bytes_total = common_size;
+        progress->bytes_done = 0;
+    }
+
+    std::vector<unsigned char> plain_block(VERIFY_BLOCK_SIZE);
+    std::vector<unsigned char> cipher_block(VERIFY_BLOCK_SIZE);
+    unsigned long long matching = 0;
+    unsigned long long offset = 0;
+
+    while (offset < common_size) {
+        if (progress && progress->cancelled()) {
+            result.cancelled = true;
+            result.error_message = "Verification cancelled.";
+            return result;
+        }
+        const size_t block = static_cast<size_t>(std::min<unsigned long long>(VERIFY_BLOCK_SIZE, common_size - offset));
+        if (limiter) limiter->acquire(2ull * block); // Both files are read
+        plain_stream.read(reinterpret_cast<char*>(plain_block.data()), static_cast<std::streamsize>(block));
+        cipher_stream.read(reinterpret_cast<char*>(cipher_block.data()), static_cast<std::streamsize>(block));
+        if (static_cast<size_t>(plain_stream.gcount()) != block || static_cast<size_t>(cipher_stream.gcount()) != block) {
+            result.files_readable = false;
+            result.error_message = "Read error while verifying at offset " + std::to_string(offset) + ".";
+            return result;
+        }
+
+        long long block_first_diff = -1;
+        matching += count_matching_shifted(plain_block.data(), cipher_block.data(), block, pegs, block_first_diff);
+        if (result.first_diff_offset == -1 && block_first_diff != -1) {
+            result.first_diff_offset = static_cast<long long>(offset) + block_first_diff;
+        }
+
+        offset += block;
+        if (progress) progress->bytes_done = offset;
+    }
+
+    if (result.plain_size != result.cipher_size && result.first_diff_offset == -1) {
+        result.first_diff_offset = static_cast<long long>(common_size);
+    }
+    result.mismatch_count = max_size - matching;
+    if (max_size > 0) {
+        result.match_percentage = (static_cast<float>(matching) / static_cast<float>(max_size)) * 100.0f;
+    } else { // Both are empty
+        result.match_percentage = 100.0f;
+    }
+
+    std::ostringstream details;
+    details << "Verified " << cipher_path << " against " << plain_path << " (pegs: " << pegs << "). "
+            << result.mismatch_count << " of " << max_size << " bytes differ.";
+    HistoryRecord record;
+    record.op = "VERIFY_STREAM";
+    record.input_path = plain_path;
+    record.output_path = cipher_path;
+    record.pegs = pegs;
+    record.details = details.str();
+    timer.stamp(record, 2 * common_size, IO_BACKEND_STREAM);
+    log_event(std::move(record));
+    return result;
+}
+
+DiffReport diff_files_stream(const std::string& path1, const std::string& path2, int pegs,
+                             VerifyProgress* progress, size_t max_ranges, size_t merge_gap) {
+    const OperationTimer timer;
+    DiffReport report;
+
+    std::ifstream stream1;
+    std::ifstream stream2;
+    if (!open_sized(stream1, path1, report.size1)) {
+        report.error_message = "Could not open file: " + path1;
+        return report;
+    }
+    if (!open_sized(stream2, path2, report.size2)) {
+        report.error_message = "Could not open file: " + path2;
+        return report;
+    }
+    report.files_readable = true;
+
+    const unsigned long long common_size = std::min(report.size1, report.size2);
+    const unsigned long long max_size = std::max(report.size1, report.size2);
+    if (progress) {
+        progress->bytes_total = common_size;
+        progress->bytes_done = 0;
+    }
+
+    std::vector<unsigned char> block1(VERIFY_BLOCK_SIZE);
+    std::vector<unsigned char> block2(VERIFY_BLOCK_SIZE);
+    std::vector<ByteSpan> spans;
+    unsigned long long offset = 0;
+
+    while (offset < common_size) {
+        if (progress && progress->cancelled()) {
+            report.cancelled = true;
+            report.error_message = "Diff cancelled.";
+            return report;
+        }
+        const size_t block = static_cast<size_t>(std::min<unsigned long long>(VERIFY_BLOCK_SIZE, common_size - offset));
+        stream1.read(reinterpret_cast<char*>(block1.data()), static_cast<std::streamsize>(block));
+        stream2.read(reinterpret_cast<char*>(block2.data()), static_cast<std::streamsize>(block));
+        if (static_cast<size_t>(stream1.gcount()) != block || static_cast<size_t>(stream2.gcount()) != block) {
+            report.files_readable = false;
+            report.error_message = "Read error while diffing at offset " + std::to_string(offset) + ".";
+            return report;
+        }
+
+        spans.clear();
+        const size_t block_mismatches = find_mismatch_spans(block1.data(), block2.data(), block, pegs, spans, max_ranges);
+        report.mismatch_count += block_mismatches;
+        size_t covered = 0;
+        for (const ByteSpan& span : spans) {
+            covered += span.end - span.begin;
+            add_range(report, offset + span.begin, span.end - span.begin, max_ranges, merge_gap);
+        }
+        if (covered < block_mismatches) {
+            report.truncated = true; // The kernel ran out of span slots inside this block
+        }
+
+        offset += block;
+        if (progress) progress->bytes_done = offset;
+    }
+
+    if (max_size > common_size) {
+        // Bytes past the end of the shorter file all count as different
+        report.mismatch_count += max_size - common_size;
+        add_range(report, common_size, max_size - common_size, max_ranges, merge_gap);
+    }
+
+    std::ostringstream details;
+    details << "Diffed " << path1 << " with " << path2 << " (pegs: " << pegs << "). "
+            << report.mismatch_count << " bytes differ in " << report.ranges.size()
+            << (report.truncated ? "+" : "") << " ranges.";
+    HistoryRecord record;
+    record.op = "DIFF_STREAM";
+    record.input_path = path1;
+    record.output_path = path2;
+    record.pegs = pegs;
+    record.details = details.str();
+    timer.stamp(record, 2 * common_size, IO_BACKEND_STREAM);
+    log_event(std::move(record));
+    return report;
+}
+
+std::vector<LineDiffLine> myers_line_diff(std::string_view text1, std::string_view text2, size_t max_edits) {
+    const std::vector<std::string_view> a = split_lines(text1);
+    const std::vector<std::string_view> b = split_lines(text2);
+    const long n = static_cast<long>(a.size());
+    const long m = static_cast<long>(b.size());
+    const long max_d = static_cast<long>(std::min<size_t>(max_edits, a.size() + b.size()));
+
+    // v[k + offset] holds the furthest x reached on diagonal k. trace[d] keeps the slice
+    // k in [-(d + 1), d + 1] as it was before step d, which is all backtracking needs.
+    const long offset = max_d + 1;
+    std::vector<long> v(static_cast<size_t>(2 * max_d + 3), 0);
+    std::vector<std::vector<long>> trace;
+    long found_d = -1;
+
+    for (long d = 0; d <= max_d && found_d < 0; ++d) {
+        trace.emplace_back(v.begin() + (offset - d - 1), v.begin() + (offset + d + 2));
+        for (long k = -d; k <= d; k += 2) {
+            long x = (k == -d || (k != d && v[k - 1 + offset] < v[k + 1 + offset])) ? v[k + 1 + offset]
+                                                                                    : v[k - 1 + offset] + 1;
+            long y = x - k;
+            while (x < n && y < m && a[x] == b[y]) { ++x; ++y; }
+            v[k + offset] = x;
+            if (x >= n && y >= m) {
+                found_d = d;
+                break;
+            }
+        }
+    }
+
+    std::vector<LineDiffLine> result;
+    if (found_d < 0) {
+        // Too many edits to trace cheaply; show the regions side by side instead
+        for (const auto& line : a) result.push_back({'-', std::string(line)});
+        for (const auto& line : b) result.push_back({'+', std::string(line)});
+        return result;
+    }
+
+    long x = n;
+    long y = m;
+    for (long d = found_d; d >= 0; --d) {
+        const std::vector<long>& snapshot = trace[static_cast<size_t>(d)];
+        auto at = [&](long k) { return snapshot[static_cast<size_t>(k + d + 1)]; };
+        const long k = x - y;
+        const long prev_k = (k == -d || (k != d && at(k - 1) < at(k + 1))) ? k + 1 : k - 1;
+        const long prev_x = at(prev_k);
+        const long prev_y = prev_x - prev_k;
+        while (x > prev_x && y > prev_y) {
+            result.push_back({' ', std::string(a[static_cast<size_t>(x - 1)])});
+            --x;
+            --y;
+        }
+        if (d > 0) {
+            if (x == prev_x) {
+                result.push_back({'+', std::string(b[static_cast<size_t>(y - 1)])});
+            } else {
+                result.push_back({'-', std::string(a[static_cast<size_t>(x - 1)])});
+            }
+        }
+        x = prev_x;
+        y = prev_y;
+    }
+    std::reverse(result.begin(), result.end());
+    return result;
+}
+
+std::vector<LineDiffLine> line_diff_for_range(const std::string& path1, const std::string& path2, int pegs,
+                                              const MismatchRange& range, size_t context_bytes) {
+    FileView view1;
+    FileView view2;
+    if (!view1.open(path1) || !view2.open(path2)) {
+        return {{'!', "Could not map the files for a line diff."}};
+    }
+
+    // Both sides start from the same byte window; only the line expansion differs
+    const unsigned long long window_begin = range.offset - std::min<unsigned long long>(range.offset, context_bytes);
+    const unsigned long long window_end = range.offset + std::min<unsigned long long>(range.length, MAX_LINE_DIFF_REGION) + context_bytes;
+
+    auto region = [&](const FileView& view, unsigned char newline) -> std::string_view {
+        size_t begin = static_cast<size_t>(std::min<unsigned long long>(window_begin, view.size()));
+        size_t end = static_cast<size_t>(std::min<unsigned long long>(window_end, view.size()));
+        if (begin < end) expand_to_lines(view.view(), begin, end, newline, context_bytes);
+        return view.view().substr(begin, end - begin);
+    };
+
+    const unsigned char encrypted_newline = static_cast<unsigned char>(('\n' + pegs) % 256);
+    std::string_view text1 = region(view1, '\n');
+    std::string text2 = process_content_caesar(region(view2, encrypted_newline), pegs, false);
+    return myers_line_diff(text1, text2);
+}
+
+TextCompareExcerpt diff_excerpt_at(const std::string& path1, const std::string& path2, int pegs,
+                                   unsigned long long offset, size_t max_chars) {
+    FileView view1;
+    FileView view2;
+    if (!view1.open(path1) || !view2.open(path2)) return {};
+    TextCompareExcerpt excerpt = materialize_compare_excerpt(view1.view(), view2.view(), static_cast<long long>(offset), max_chars);
+    excerpt.content2 = process_content_caesar(excerpt.content2, pegs, false);
+    return excerpt;
+}
+
+PegRecoveryResult recover_pegs(const std::string& cipher_path, const std::string& plain_path,
+                               size_t sample_bytes, size_t max_candidates) {
+    PegRecoveryResult result;
+
+    ByteHistogram cipher_histogram;
+    if (!build_file_histogram(cipher_path, sample_bytes, cipher_histogram, result.bytes_examined, result.sampled)) {
+        result.error_message = "Could not read encrypted file: " + cipher_path;
+        return result;
+    }
+    if (result.bytes_examined == 0) {
+        result.error_message = "Encrypted file is empty; nothing to analyse.";
+        return result;
+    }
+
+    std::vector<PegCandidate> scored;
+    scored.reserve(MAX_PEG - MIN_PEG + 1);
+    if (!plain_path.empty()) {
+        ByteHistogram plain_histogram;
+        unsigned long long plain_bytes = 0;
+        bool plain_sampled = false;
+        if (!build_file_histogram(plain_path, sample_bytes, plain_histogram, plain_bytes, plain_sampled) || plain_bytes == 0) {
+            result.error_message = "Could not read vault plaintext: " + plain_path;
+            return result;
+        }
+        result.used_plaintext = true;
+        result.sampled = result.sampled || plain_sampled;
+
+        // Total variation distance between shift(plain) and cipher frequency distributions
+        for (int pegs = MIN_PEG; pegs <= MAX_PEG; ++pegs) {
+            double distance = 0.0;
+            for (int b = 0; b < 256; ++b) {
+                const double expected = static_cast<double>(plain_histogram[b]) / static_cast<double>(plain_bytes);
+                const double observed = static_cast<double>(cipher_histogram[(b + pegs) % 256]) / static_cast<double>(result.bytes_examined);
+                distance += std::abs(expected - observed);
+            }
+            scored.push_back({pegs, distance / 2.0});
+        }
+    } else {
+        // Average negative log-likelihood of the ciphertext decrypted with each candidate
+        static const std::array<double, 256> log_distribution = text_log_distribution();
+        for (int pegs = MIN_PEG; pegs <= MAX_PEG; ++pegs) {
+            double nll = 0.0;
+            for (int b = 0; b < 256; ++b) {
+                nll -= static_cast<double>(cipher_histogram[(b + pegs) % 256]) * log_distribution[b];
+            }
+            scored.push_back({pegs, nll / static_cast<double>(result.bytes_examined)});
+        }
+    }
+
+    std::sort(scored.begin(), scored.end(), [](const PegCandidate& a, const PegCandidate& b) { return a.score < b.score; });
+    scored.resize(std::min(scored.size(), max_candidates));
+    result.candidates = std::move(scored);
+    result.success = true;
+
+    std::ostringstream details;
+    details << "Recovered pegs for " << cipher_path << ": best " << result.candidates.front().pegs
+            << " (" << result.bytes_examined << " bytes examined" << (result.sampled ? ", sampled" : "") << ").";
+    log_event("PEG_RECOVERY", details.str());
+    return result;
+}
+
+VaultSweepReport sweep_vault(const VaultSweepOptions& options, SweepProgress* progress) {
+    const auto start_time = std::chrono::steady_clock::now();
+    VaultSweepReport report;
+
+    // The vault index knows the counterpart of everything stored since it existed; only older
+    // entries need the history log (latest ENCRYPT record per original filename)
+    std::vector<VaultEntry> vault_entries = Vault::instance().list();
+    std::unordered_map<std::string, EncryptionRecord> records_by_name;
+    const bool needs_history = std::any_of(vault_entries.begin(), vault_entries.end(), [](const VaultEntry& vault_entry) {
+        return vault_entry.encrypted_path.empty() || vault_entry.pegs == 0;
+    });
+    if (needs_history) {
+        for (EncryptionRecord& record : load_encryption_records()) {
+            std::string name = path_get_filename(record.input_file);
+            records_by_name[name] = std::move(record);
+        }
+    }
+
+    for (VaultEntry& vault_entry : vault_entries) {
+        VaultSweepEntry entry;
+        entry.vault_name = std::move(vault_entry.name);
+        auto it = records_by_name.find(entry.vault_name);
+        if (!vault_entry.encrypted_path.empty() && vault_entry.pegs != 0) {
+            entry.encrypted_path = std::move(vault_entry.encrypted_path);
+            entry.pegs = vault_entry.pegs;
+        } else if (it != records_by_name.end()) {
+            entry.encrypted_path = it->second.output_file;
+            entry.pegs = it->second.pegs;
+        } else {
+            entry.status = SweepStatus::NoRecord;
+        }
+        report.entries.push_back(std::move(entry));
+    }
+    std::sort(report.entries.begin(), report.entries.end(),
+              [](const VaultSweepEntry& a, const VaultSweepEntry& b) { return a.vault_name < b.vault_name; });
+
+    if (progress) {
+        progress->entries_total = report.entries.size();
+        progress->entries_done = 0;
+    }
+
+    RateLimiter limiter(options.max_bytes_per_second);
+    std::atomic<size_t> next_entry{0};
+    auto worker = [&]() {
+        // Lets Cancel stop the file in flight instead of waiting for it to finish
+        VerifyProgress file_progress;
+        file_progress.cancel_source = progress ? &progress->cancel_requested : nullptr;
+        for (;;) {
+            if (progress && progress->cancel_requested) return;
+            const size_t index = next_entry++;
+            if (index >= report.entries.size()) return;
+            VaultSweepEntry& entry = report.entries[index];
+            if (entry.status != SweepStatus::NoRecord) {
+                VaultEntryFile vault_file; // Held until the entry is verified
+                if (!is_regular_file(entry.encrypted_path)) {
+                    entry.status = SweepStatus::MissingEncrypted;
+                } else if (!Vault::instance().entry_file(entry.vault_name, vault_file)) {
+                    entry.status = SweepStatus::Error;
+                    entry.result.error_message = "Could not read vault entry: " + entry.vault_name;
+                } else {
+                    entry.result = verify_encrypted_file_stream(vault_file.path(), entry.encrypted_path, entry.pegs,
+                                                                &file_progress, &limiter);
+                    if (entry.result.cancelled) {
+                        entry.status = SweepStatus::Skipped;
+                    } else if (!entry.result.files_readable) {
+                        entry.status = SweepStatus::Error;
+                    } else {
+                        entry.status = (entry.result.mismatch_count == 0) ? SweepStatus::Match : SweepStatus::Mismatch;
+                    }
+                }
+            }
+            if (progress) progress->entries_done++;
+        }
+    };
+
+    unsigned thread_count = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    thread_count = static_cast<unsigned>(std::min<size_t>(thread_count, std::max<size_t>(report.entries.size(), 1)));
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < thread_count; ++t) pool.emplace_back(worker);
+    worker(); // The calling thread works too
+    for (std::thread& thread : pool) thread.join();
+
+    report.cancelled = progress && progress->cancel_requested;
+    for (const VaultSweepEntry& entry : report.entries) {
+        switch (entry.status) {
+            case SweepStatus::Match:            report.matched++; break;
+            case SweepStatus::Mismatch:         report.mismatched++; break;
+            case SweepStatus::MissingEncrypted: report.missing++; break;
+            case SweepStatus::NoRecord:         report.unknown++; break;
+            case SweepStatus::Error:            report.errors++; break;
+            case SweepStatus::Skipped:          report.skipped++; break;
+        }
+    }
+    report.elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    unsigned long long bytes_verified = 0;
+    for (const VaultSweepEntry& entry : report.entries) {
+        bytes_verified += std::min(entry.result.plain_size, entry.result.cipher_size) * 2;
+    }
+
+    std::ostringstream details;
+    details << "Vault sweep: " << report.matched << " matched, " << report.mismatched << " mismatched, "
+            << report.missing << " missing, " << report.unknown << " without record, " << report.errors
+            << " errors, " << report.skipped << " skipped in " << report.elapsed_seconds << "s"
+            << (report.cancelled ? " (cancelled)." : ".");
+    // Work is spread over several threads, so only wall time is recorded here; each
+    // file's VERIFY_STREAM record carries its own CPU time
+    HistoryRecord record;
+    record.op = "VAULT_SWEEP";
+    record.details = details.str();
+    record.bytes = bytes_verified;
+    record.duration_us = static_cast<unsigned long long>(report.elapsed_seconds * 1e6);
+    record.throughput_mb_s = throughput_mb_s(record.bytes, record.duration_us);
+    record.io_backend = IO_BACKEND_STREAM;
+    log_event(std::move(record));
+    return report;
+}
+
+std::string format_sweep_report(const VaultSweepReport& report) {
+    std::ostringstream out;
+    out << "Vault verification sweep" << (report.cancelled ? " (CANCELLED)" : "") << '\n';
+    for (const VaultSweepEntry& entry : report.entries) {
+        switch (entry.status) {
+            case SweepStatus::Match:
+                break;
+            case SweepStatus::Mismatch:
+                out << "MISMATCH  " << entry.vault_name << " vs " << entry.encrypted_path << ": "
+                    << entry.result.mismatch_count << " bytes differ, first at offset " << entry.result.first_diff_offset << '\n';
+                break;
+            case SweepStatus::MissingEncrypted:
+                out << "MISSING   " << entry.vault_name << ": encrypted file not found at " << entry.encrypted_path << '\n';
+                break;
+            case SweepStatus::NoRecord:
+                out << "NORECORD  " << entry.vault_name << ": no ENCRYPT entry in the history log" << '\n';
+                break;
+            case SweepStatus::Error:
+                out << "ERROR     " << entry.vault_name << ": " << entry.result.error_message << '\n';
+                break;
+            case SweepStatus::Skipped:
+                break;
+        }
+    }
+    out << "Totals: " << report.entries.size() << " vault files, " << report.matched << " matched, "
+        << report.mismatched << " mismatched, " << report.missing << " missing, " << report.unknown
+        << " without record, " << report.errors << " errors, " << report.skipped
+        << " skipped. Elapsed: " << report.elapsed_seconds << "s\n";
+    return out.str();
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef> // For size_t
+
+#include "cipher_utils.h" // For TextCompareExcerpt
+
+// --- Structures ---
+
+// Shared between a verification worker and the thread that launched it
+struct VerifyProgress {
+    std::atomic<unsigned long long> bytes_done{0};
+    std::atomic<unsigned long long> bytes_total{0};
+    std::atomic<bool> cancel_requested{false};
+    const std::atomic<bool>* cancel_source = nullptr; // Also stops when this is set, e.g. by a sweep
+
+    bool cancelled() const noexcept { return cancel_requested || (cancel_source && *cancel_source); }
+};
+
+// Counts vault entries for sweep_vault; cancelling also stops the files being verified
+struct SweepProgress {
+    std::atomic<size_t> entries_done{0};
+    std::atomic<size_t> entries_total{0};
+    std::atomic<bool> cancel_requested{false};
+};
+
+// Token bucket shared by concurrent readers to cap aggregate disk throughput
+class RateLimiter {
+public:
+    // 0 disables limiting
+    explicit RateLimiter(unsigned long long bytes_per_second) noexcept;
+
+    // Blocks the calling thread until 'bytes' may be read
+    void acquire(unsigned long long bytes);
+
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+private:
+    std::mutex mutex;
+    double rate;
+    double available;
+    std::chrono::steady_clock::time_point last_refill;
+};
+
+struct StreamVerifyResult {
+    bool files_readable = false;
+    bool cancelled = false;
+    unsigned long long plain_size = 0;    // Size of the vaulted original
+    unsigned long long cipher_size = 0;   // Size of the external encrypted file
+    unsigned long long mismatch_count = 0; // Differing bytes, plus any length difference
+    long long first_diff_offset = -1;
+    float match_percentage = 0.0f;        // Same semantics as compare_string_contents
+    std::string error_message;
+};
+
+struct MismatchRange {
+    unsigned long long offset = 0;
+    unsigned long long length = 0;
+};
+
+struct DiffReport {
+    bool files_readable = false;
+    bool cancelled = false;
+    bool truncated = false;               // More ranges existed than the report keeps
+    unsigned long long size1 = 0;
+    unsigned long long size2 = 0;
+    unsigned long long mismatch_count = 0; // Always exact, even when 'ranges' is truncated
+    std::vector<MismatchRange> ranges;
+    std::string error_message;
+};
+
+// One line of a line-level diff: op is ' ' (unchanged), '-' (only in file 1) or '+' (only in file 2)
+struct LineDiffLine {
+    char op = ' ';
+    std::string text;
+};
+
+struct PegCandidate {
+    int pegs = 0;
+    double score = 0.0; // Lower is better; 0 means a perfect histogram match against a plaintext
+};
+
+struct PegRecoveryResult {
+    bool success = false;
+    bool sampled = false;                   // Only part of the ciphertext was read
+    bool used_plaintext = false;            // Scored against a vault plaintext, not a language model
+    unsigned long long bytes_examined = 0;
+    std::vector<PegCandidate> candidates;   // Best first
+    std::string error_message;
+};
+
+enum class SweepStatus { Match, Mismatch, MissingEncrypted, NoRecord, Error, Skipped };
+
+struct VaultSweepEntry {
+    std::string vault_name;
+    std::string encrypted_path;  // Empty when no ENCRYPT record names this original
+    int pegs = 0;
+    SweepStatus status = SweepStatus::Skipped; // Until a worker reaches the entry
+    StreamVerifyResult result;
+};
+
+struct VaultSweepOptions {
+    unsigned threads = 0;                        // 0 picks std::thread::hardware_concurrency()
+    unsigned long long max_bytes_per_second = 0; // Aggregate read budget; 0 is unlimited
+};
+
+struct VaultSweepReport {
+    bool cancelled = false;
+    std::vector<VaultSweepEntry> entries;
+    size_t matched = 0;
+    size_t mismatched = 0;
+    size_t missing = 0;  // Encrypted counterpart recorded but not on disk
+    size_t unknown = 0;  // No ENCRYPT record for the vault file
+    size_t errors = 0;
+    size_t skipped = 0;  // Not verified because the sweep was cancelled
+    double elapsed_seconds = 0.0;
+};
+
+// --- Public Function Declarations ---
+
+// Streams both files end to end in constant memory, comparing shift(plaintext, pegs) against
+// the ciphertext block by block with the fused kernel (no encrypted copy is built). Safe to call from a worker thread;
+// 'progress' may be null.
+StreamVerifyResult verify_encrypted_file_stream(const std::string& plain_path, const std::string& cipher_path,
+                                                int pegs, VerifyProgress* progress = nullptr, RateLimiter* limiter = nullptr);
+
+// Streams both files in blocks and lists the byte ranges where shift(file1, pegs) differs from
+// file2 (pegs 0 compares the files directly). Ranges closer than 'merge_gap' bytes are joined and
+// at most 'max_ranges' are kept, so memory stays bounded for multi-GB inputs.
+DiffReport diff_files_stream(const std::string& path1, const std::string& path2, int pegs,
+                             VerifyProgress* progress = nullptr, size_t max_ranges = 100000, size_t merge_gap = 0);
+
+// Myers line diff of the text around one mismatch range. File 2 is decrypted with 'pegs' first so
+// both sides are shown as plaintext. Only the differing region (plus 'context_bytes') is read.
+std::vector<LineDiffLine> line_diff_for_range(const std::string& path1, const std::string& path2, int pegs,
+                                              const MismatchRange& range, size_t context_bytes = 1024);
+
+// The bytes around 'offset' in both files, file 2 decrypted with 'pegs'. Only the excerpt is
+// copied out of the mapped files.
+TextCompareExcerpt diff_excerpt_at(const std::string& path1, const std::string& path2, int pegs,
+                                   unsigned long long offset, size_t max_chars = 96);
+
+// Line-level Myers diff of two texts. Falls back to a full remove/add listing when the edit
+// distance exceeds 'max_edits'.
+std::vector<LineDiffLine> myers_line_diff(std::string_view text1, std::string_view text2, size_t max_edits = 1000);
+
+// Recovers the pegs used to encrypt 'cipher_path' from a single byte histogram. Every shift in
+// MIN_PEG..MAX_PEG is scored against the histogram of 'plain_path' when given, otherwise against
+// a typical text distribution. Files larger than 'sample_bytes' are sampled at evenly spaced
+// offsets; pass 0 to always read everything.
+PegRecoveryResult recover_pegs(const std::string& cipher_path, const std::string& plain_path = "",
+                               size_t sample_bytes = 8 * 1024 * 1024, size_t max_candidates = 5);
+
+// Verifies every original in PRIVATE_VAULT_DIR against its enc_ counterpart found through the
+// history log, running the streaming verifier on a pool of worker threads.
+VaultSweepReport sweep_vault(const VaultSweepOptions& options, SweepProgress* progress = nullptr);
+
+// Plain-text report listing every mismatch, missing file and error, followed by totals
+std::string format_sweep_report(const VaultSweepReport& report);